@@ -118,6 +118,7 @@ void AllocViewCtrl::setObj(const Udb::Obj & o)
     if( o.isNull() )
         return;
 
+    Epk::Index::ensure( o.getTxn(), Epk::Index::Func );
     Udb::Idx idx( o.getTxn(), Epk::Index::Func );
     if( idx.seek( Stream::DataCell().setOid( o.getOid() ) ) ) do
     {
@@ -0,0 +1,223 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkArchive.h"
+#include "EpkStream.h"
+#include <Stream/DataReader.h>
+#include <QtEndian>
+#include <string.h>
+using namespace Epk;
+using namespace Stream;
+
+static const int s_trailerSize = 16;
+
+EpkArchive::EpkArchive():d_tocOffset(0),d_compressed(false),d_archive(false),d_mapped(false)
+{
+}
+
+EpkArchive::~EpkArchive()
+{
+    close();
+}
+
+void EpkArchive::close()
+{
+    d_dev.close();
+    d_dev.setData( QByteArray() );
+    if( d_mapped )
+        d_file.unmap( reinterpret_cast<uchar*>( const_cast<char*>( d_data.constData() ) ) );
+    d_mapped = false;
+    d_data = QByteArray();
+    d_file.close();
+    d_entries.clear();
+    d_version.clear();
+    d_tocOffset = 0;
+    d_compressed = false;
+    d_archive = false;
+}
+
+bool EpkArchive::open(const QString &path)
+{
+    close();
+    d_error.clear();
+    d_file.setFileName( path );
+    if( !d_file.open( QIODevice::ReadOnly ) )
+    {
+        d_error = QLatin1String( "cannot open file for reading" );
+        return false;
+    }
+    uchar* p = d_file.map( 0, d_file.size() );
+    if( p != 0 )
+    {
+        d_mapped = true;
+        d_data = QByteArray::fromRawData( reinterpret_cast<const char*>( p ), d_file.size() );
+    }else
+        d_data = d_file.readAll(); // z.B. bei Dateisystemen ohne mmap
+    d_dev.setData( d_data );
+    d_dev.open( QIODevice::ReadOnly );
+    if( !readHeader() )
+        return false;
+    if( d_version == "0.2" && !readToc() )
+        return false;
+    return true;
+}
+
+bool EpkArchive::readHeader()
+{
+    d_dev.seek( 0 );
+    DataReader in( &d_dev );
+    if( in.nextToken() != DataReader::Slot || in.getValue().getArr() != "FlowLineStream" )
+    {
+        d_error = QLatin1String( "invalid data stream" );
+        return false;
+    }
+    if( in.nextToken() != DataReader::Slot )
+    {
+        d_error = QLatin1String( "invalid stream version" );
+        return false;
+    }
+    d_version = in.getValue().getArr();
+    if( in.nextToken() != DataReader::Slot || !in.getValue().isDateTime() )
+    {
+        d_error = QLatin1String( "invalid protocol" );
+        return false;
+    }
+    if( d_version == "0.2" )
+    {
+        if( in.nextToken() != DataReader::Slot )
+        {
+            d_error = QLatin1String( "invalid protocol" );
+            return false;
+        }
+        const quint8 flags = in.getValue().getUInt8();
+        d_compressed = flags & 0x1;
+        d_archive = flags & 0x2;
+    }else if( d_version == "0.1" )
+    {
+        // Kein Verzeichnis; nur die Slots am Anfang des Top-Level-Frames lesen
+        if( in.nextToken() != DataReader::BeginFrame || !in.getName().getTag().equals( "proc" ) )
+        {
+            d_error = QLatin1String( "invalid protocol" );
+            return false;
+        }
+        Entry e;
+        e.d_oid = 0;
+        e.d_offset = 0;
+        e.d_size = d_data.size();
+        while( in.nextToken() == DataReader::Slot )
+        {
+            const NameTag n = in.getName().getTag();
+            if( n.equals( "oid" ) )
+                e.d_oid = in.getValue().getOid();
+            else if( n.equals( "id" ) && e.d_id.isEmpty() )
+                e.d_id = in.getValue().toString();
+            else if( n.equals( "text" ) )
+                e.d_text = in.getValue().toString();
+        }
+        d_entries.append( e );
+    }else
+    {
+        d_error = QLatin1String( "invalid stream version" );
+        return false;
+    }
+    return true;
+}
+
+bool EpkArchive::readToc()
+{
+    if( d_data.size() < s_trailerSize ||
+            ::memcmp( d_data.constData() + d_data.size() - s_trailerSize, EpkStream::s_tocMagic, 8 ) != 0 )
+    {
+        d_error = QLatin1String( "missing table of contents" );
+        return false;
+    }
+    const qint64 off = qFromBigEndian<quint64>( reinterpret_cast<const uchar*>(
+                                                    d_data.constData() + d_data.size() - 8 ) );
+    if( off <= 0 || off >= d_data.size() - s_trailerSize )
+    {
+        d_error = QLatin1String( "invalid table of contents" );
+        return false;
+    }
+    d_dev.seek( off );
+    DataReader in( &d_dev );
+    if( in.nextToken() != DataReader::BeginFrame || !in.getName().getTag().equals( "toc" ) )
+    {
+        d_error = QLatin1String( "invalid table of contents" );
+        return false;
+    }
+    DataReader::Token t = in.nextToken();
+    while( t == DataReader::BeginFrame )
+    {
+        Entry e;
+        e.d_oid = 0;
+        e.d_offset = 0;
+        e.d_size = 0;
+        t = in.nextToken();
+        while( t == DataReader::Slot )
+        {
+            const NameTag n = in.getName().getTag();
+            if( n.equals( "oid" ) )
+                e.d_oid = in.getValue().getOid();
+            else if( n.equals( "id" ) )
+                e.d_id = in.getValue().toString();
+            else if( n.equals( "text" ) )
+                e.d_text = in.getValue().toString();
+            else if( n.equals( "off" ) )
+                e.d_offset = in.getValue().getUInt64();
+            else if( n.equals( "path" ) )
+                e.d_path = in.getValue().toString();
+            t = in.nextToken();
+        }
+        if( t != DataReader::EndFrame || e.d_offset <= 0 || e.d_offset >= off )
+        {
+            d_error = QLatin1String( "invalid table of contents" );
+            return false;
+        }
+        if( !d_entries.isEmpty() )
+            d_entries.last().d_size = e.d_offset - d_entries.last().d_offset;
+        d_entries.append( e );
+        t = in.nextToken();
+    }
+    if( t != DataReader::EndFrame || d_entries.isEmpty() )
+    {
+        d_error = QLatin1String( "invalid table of contents" );
+        return false;
+    }
+    d_entries.last().d_size = off - d_entries.last().d_offset;
+    d_tocOffset = off;
+    return true;
+}
+
+Udb::Obj EpkArchive::importEntry(int i, Udb::Obj &parent, EpkStream & stream)
+{
+    if( i < 0 || i >= d_entries.size() )
+        return Udb::Obj();
+    if( i == 0 && !d_archive )
+    {
+        d_dev.seek( 0 );
+        DataReader in( &d_dev );
+        return stream.importProcStaged( in, parent );
+    }else
+    {
+        // Nur den Block lesen; der Rest der Datei wird nicht angefasst
+        d_dev.seek( d_entries[i].d_offset );
+        DataReader in( &d_dev );
+        return stream.importBlock( in, d_compressed, parent );
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef EPKARCHIVE_H
+#define EPKARCHIVE_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QFile>
+#include <QBuffer>
+#include <QList>
+#include <Udb/Obj.h>
+
+namespace Epk
+{
+    class EpkStream;
+
+    class EpkArchive
+    {
+        // Random Access auf .flnx Dateien. Die Datei wird mit QFile::map eingeblendet; bei Version 0.2
+        // wird das Inhaltsverzeichnis ueber den Trailer am Dateiende gefunden, ohne die Bloecke zu lesen.
+        // Dateien der Version 0.1 haben kein Verzeichnis; es wird nur der Top-Level-Prozess aufgefuehrt.
+    public:
+        struct Entry
+        {
+            quint64 d_oid;      // OID in der exportierenden Datenbank
+            QString d_id;
+            QString d_text;
+            QString d_path;     // nur Archiv: FuncDomains oberhalb des Prozesses
+            qint64 d_offset;    // Position des 'blk' Frames; 0 bei Version 0.1
+            qint64 d_size;      // Bytes bis zum naechsten Block
+        };
+        EpkArchive();
+        ~EpkArchive();
+        bool open( const QString& path );
+        void close();
+        const QString& getError() const { return d_error; }
+        const QByteArray& getVersion() const { return d_version; }
+        bool isIndexed() const { return d_tocOffset > 0; }
+        bool isCompressed() const { return d_compressed; }
+        bool isArchive() const { return d_archive; } // siehe EpkStream::exportArchive
+        // Eintrag 0 ist der ganze Prozess; bei einem Archiv sind alle Eintraege gleichwertige Prozesse
+        const QList<Entry>& getEntries() const { return d_entries; }
+        QIODevice* getDevice() { return &d_dev; } // fuer Fortschrittsanzeige, pos() relativ zur Datei
+        qint64 getSize() const { return d_data.size(); }
+        // Eintrag 0 importiert den ganzen Prozess mit EpkStream::importProcStaged (mit Commit),
+        // die uebrigen nur den Block des Sub-Prozesses mit EpkStream::importBlock (ohne Commit).
+        // Bei einem Archiv wird jeder Eintrag mit importBlock gelesen (ohne Commit).
+        Udb::Obj importEntry( int i, Udb::Obj& parent, EpkStream& );
+    private:
+        bool readHeader();
+        bool readToc();
+        QFile d_file;
+        QByteArray d_data; // zeigt ohne Kopie auf die eingeblendete Datei
+        QBuffer d_dev;
+        QList<Entry> d_entries;
+        QByteArray d_version;
+        QString d_error;
+        qint64 d_tocOffset;
+        bool d_compressed;
+        bool d_archive;
+        bool d_mapped;
+    };
+}
+
+#endif // EPKARCHIVE_H
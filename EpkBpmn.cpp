@@ -0,0 +1,454 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkBpmn.h"
+#include "EpkObjects.h"
+#include "EpkProcs.h"
+#include <Udb/Transaction.h>
+#include <QXmlStreamWriter>
+#include <QXmlStreamReader>
+#include <QStringList>
+#include <QtDebug>
+#include <string.h>
+using namespace Epk;
+using namespace Stream;
+
+static const char* s_model = "http://www.omg.org/spec/BPMN/20100524/MODEL";
+static const char* s_bpmndi = "http://www.omg.org/spec/BPMN/20100524/DI";
+static const char* s_dc = "http://www.omg.org/spec/DD/20100524/DC";
+static const char* s_di = "http://www.omg.org/spec/DD/20100524/DI";
+
+BpmnStream::BpmnStream():d_txn(0),d_count(0),d_batchSize(0)
+{
+}
+
+static QString _id( const Udb::Obj& o )
+{
+    // OIDs sind eindeutig und gueltige NCNames mit Praefix
+    return QString( "_%1" ).arg( o.getOid() );
+}
+
+static const char* _elementName( const Udb::Obj& o )
+{
+    const quint32 type = o.getType();
+    if( type == Function::TID )
+        return ( o.getValue( Function::AttrElemCount ).getUInt32() > 0 ) ? "subProcess" : "task";
+    if( type == Event::TID )
+    {
+        const Udb::Obj proc = o.getParent();
+        if( proc.getValueAsObj( Function::AttrStart ).equals( o ) )
+            return "startEvent";
+        if( proc.getValueAsObj( Function::AttrFinish ).equals( o ) )
+            return "endEvent";
+        return "intermediateThrowEvent";
+    }
+    if( type == Connector::TID )
+    {
+        switch( o.getValue( Connector::AttrConnType ).getUInt8() )
+        {
+        case Connector::And:
+            return "parallelGateway";
+        case Connector::Or:
+            return "inclusiveGateway";
+        case Connector::Xor:
+            return "exclusiveGateway";
+        case Connector::Start:
+            return "startEvent";
+        case Connector::Finish:
+            return "endEvent";
+        default:
+            return "complexGateway";
+        }
+    }
+    return 0;
+}
+
+static void _writeScope( QXmlStreamWriter& w, const Udb::Obj& scope )
+{
+    // Zuerst die Knoten, dann die Flows zwischen Knoten desselben Scope
+    Udb::Obj sub = scope.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        const char* name = _elementName( sub );
+        if( name == 0 )
+            continue;
+        w.writeStartElement( s_model, name );
+        w.writeAttribute( "id", _id( sub ) );
+        const QString text = sub.getString( Root::AttrText );
+        if( !text.isEmpty() )
+            w.writeAttribute( "name", text );
+        if( ::strcmp( name, "subProcess" ) == 0 )
+            _writeScope( w, sub );
+        w.writeEndElement();
+    }while( sub.next() );
+    sub = scope.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( !Procs::isDiagNode( sub.getType() ) )
+            continue;
+        Udb::Obj flow = sub.getFirstObj();
+        if( !flow.isNull() ) do
+        {
+            if( flow.getType() != ConFlow::TID )
+                continue;
+            const Udb::Obj succ = flow.getValueAsObj( ConFlow::AttrSucc );
+            if( succ.isNull() || !succ.getParent().equals( scope ) )
+                continue; // BPMN kennt keine Flows ueber Scope-Grenzen
+            w.writeStartElement( s_model, "sequenceFlow" );
+            w.writeAttribute( "id", _id( flow ) );
+            w.writeAttribute( "sourceRef", _id( sub ) );
+            w.writeAttribute( "targetRef", _id( succ ) );
+            w.writeEndElement();
+        }while( flow.next() );
+    }while( sub.next() );
+}
+
+static void _writeBounds( QXmlStreamWriter& w, const QRectF& r )
+{
+    w.writeStartElement( s_dc, "Bounds" );
+    w.writeAttribute( "x", QString::number( r.x() ) );
+    w.writeAttribute( "y", QString::number( r.y() ) );
+    w.writeAttribute( "width", QString::number( r.width() ) );
+    w.writeAttribute( "height", QString::number( r.height() ) );
+    w.writeEndElement();
+}
+
+static void _writeWaypoint( QXmlStreamWriter& w, const QPointF& p )
+{
+    w.writeStartElement( s_di, "waypoint" );
+    w.writeAttribute( "x", QString::number( p.x() ) );
+    w.writeAttribute( "y", QString::number( p.y() ) );
+    w.writeEndElement();
+}
+
+static void _writeDiagram( QXmlStreamWriter& w, const Udb::Obj& scope )
+{
+    w.writeStartElement( s_bpmndi, "BPMNDiagram" );
+    w.writeAttribute( "id", QString( "D%1" ).arg( _id( scope ) ) );
+    w.writeStartElement( s_bpmndi, "BPMNPlane" );
+    w.writeAttribute( "id", QString( "P%1" ).arg( _id( scope ) ) );
+    w.writeAttribute( "bpmnElement", _id( scope ) );
+    QList<Udb::Obj> subs;
+    QHash<Udb::OID,QPointF> centers; // nur fuer dieses Diagramm
+    Udb::Obj sub = scope.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() != DiagItem::TID )
+            continue;
+        DiagItem di = sub;
+        const Udb::Obj orig = di.getOrigObject();
+        if( Procs::isDiagNode( orig.getType() ) && orig.getParent().equals( scope ) )
+        {
+            w.writeStartElement( s_bpmndi, "BPMNShape" );
+            w.writeAttribute( "id", _id( di ) );
+            w.writeAttribute( "bpmnElement", _id( orig ) );
+            // DiagItem::getPos ist die Mitte, Bounds in BPMN DI die linke obere Ecke
+            QSizeF s = di.getSize();
+            if( orig.getType() == Connector::TID )
+                s = QSizeF( DiagItem::s_circleDiameter, DiagItem::s_circleDiameter );
+            else if( s.isEmpty() )
+                s = QSizeF( DiagItem::s_boxWidth, DiagItem::s_boxHeight );
+            const QRectF r( di.getPos() - QPointF( s.width() / 2.0, s.height() / 2.0 ), s );
+            _writeBounds( w, r );
+            w.writeEndElement();
+            centers[ orig.getOid() ] = r.center();
+            if( ::strcmp( _elementName( orig ), "subProcess" ) == 0 )
+                subs.append( orig );
+        }
+    }while( sub.next() );
+    sub = scope.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() != DiagItem::TID )
+            continue;
+        DiagItem di = sub;
+        const Udb::Obj orig = di.getOrigObject();
+        if( orig.getType() == ConFlow::TID &&
+                orig.getValueAsObj( ConFlow::AttrSucc ).getParent().equals( scope ) )
+        {
+            w.writeStartElement( s_bpmndi, "BPMNEdge" );
+            w.writeAttribute( "id", _id( di ) );
+            w.writeAttribute( "bpmnElement", _id( orig ) );
+            // Die Waypoints enthalten in BPMN auch die Endpunkte
+            _writeWaypoint( w, centers.value( orig.getValue( ConFlow::AttrPred ).getOid() ) );
+            foreach( const QPointF& p, di.getNodeList() )
+                _writeWaypoint( w, p );
+            _writeWaypoint( w, centers.value( orig.getValue( ConFlow::AttrSucc ).getOid() ) );
+            w.writeEndElement();
+        }
+    }while( sub.next() );
+    w.writeEndElement(); // BPMNPlane
+    w.writeEndElement(); // BPMNDiagram
+    foreach( const Udb::Obj& s, subs )
+        _writeDiagram( w, s );
+}
+
+bool BpmnStream::exportProc(QIODevice * dev, const Udb::Obj &proc)
+{
+    if( dev == 0 || proc.isNull() || proc.getType() != Function::TID )
+        return false;
+    QXmlStreamWriter w( dev );
+    w.setAutoFormatting( true );
+    w.writeStartDocument();
+    w.writeNamespace( s_model, "bpmn" );
+    w.writeNamespace( s_bpmndi, "bpmndi" );
+    w.writeNamespace( s_dc, "dc" );
+    w.writeNamespace( s_di, "di" );
+    w.writeStartElement( s_model, "definitions" );
+    w.writeAttribute( "id", QString( "Def%1" ).arg( _id( proc ) ) );
+    w.writeAttribute( "targetNamespace", "http://www.flowline.info/bpmn" );
+    w.writeAttribute( "exporter", "FlowLine2" );
+    w.writeStartElement( s_model, "process" );
+    w.writeAttribute( "id", _id( proc ) );
+    w.writeAttribute( "name", proc.getString( Root::AttrText ) );
+    _writeScope( w, proc );
+    w.writeEndElement(); // process
+    _writeDiagram( w, proc );
+    w.writeEndElement(); // definitions
+    w.writeEndDocument();
+    return !w.hasError();
+}
+
+bool BpmnStream::created()
+{
+    static const int s_progressStep = 100;
+    d_count++;
+    if( d_batchSize > 0 && d_count % d_batchSize == 0 )
+        d_txn->commit(); // haelt die Transaktion klein
+    if( d_count % s_progressStep == 0 && !progress( d_count ) )
+    {
+        d_error = QLatin1String( "import canceled" );
+        return false;
+    }
+    return true;
+}
+
+Udb::Obj BpmnStream::createNode(quint32 type, const QXmlStreamReader & r, Udb::Obj parent)
+{
+    Udb::Obj o = Procs::createObject( type, parent );
+    const QStringRef name = r.attributes().value( "name" );
+    if( !name.isEmpty() )
+        o.setString( Root::AttrText, name.toString() );
+    const QString id = r.attributes().value( "id" ).toString();
+    if( !id.isEmpty() )
+    {
+        o.setString( Root::AttrAltIdent, id );
+        d_ids[ id ] = o.getOid();
+    }
+    return o;
+}
+
+Udb::Obj BpmnStream::createFlow(const QString &id, const QString &from, const QString &to)
+{
+    Udb::Obj pred = d_txn->getObject( d_ids.value( from ) );
+    const Udb::Obj succ = d_txn->getObject( d_ids.value( to ) );
+    Udb::Obj link = Procs::createObject( ConFlow::TID, pred );
+    link.setValue( ConFlow::AttrPred, pred );
+    link.setValue( ConFlow::AttrSucc, succ );
+    if( !id.isEmpty() )
+        d_ids[ id ] = link.getOid();
+    return link;
+}
+
+void BpmnStream::createShape(const QString &elem, const QXmlStreamReader &bounds)
+{
+    const Udb::Obj orig = d_txn->getObject( d_ids.value( elem ) );
+    if( orig.isNull() || !Procs::isDiagNode( orig.getType() ) )
+        return;
+    const QRectF r( bounds.attributes().value( "x" ).toString().toDouble(),
+                    bounds.attributes().value( "y" ).toString().toDouble(),
+                    bounds.attributes().value( "width" ).toString().toDouble(),
+                    bounds.attributes().value( "height" ).toString().toDouble() );
+    DiagItem::create( orig.getParent(), orig, r.center() ); // Position eines DiagItem ist die Mitte
+    d_withShapes.insert( orig.getParent().getOid() );
+}
+
+void BpmnStream::createEdge(const QString &elem, const QPolygonF &waypoints)
+{
+    const Udb::Obj flow = d_txn->getObject( d_ids.value( elem ) );
+    if( flow.isNull() || flow.getType() != ConFlow::TID )
+        return;
+    DiagItem di = DiagItem::create( flow.getParent().getParent(), flow );
+    if( waypoints.size() > 2 )
+        di.setNodeList( QPolygonF( waypoints.mid( 1, waypoints.size() - 2 ) ) ); // ohne die Endpunkte
+}
+
+bool BpmnStream::readDefinitions(QXmlStreamReader & r, Udb::Obj &staging)
+{
+    static QStringList s_tasks = QStringList() << "task" << "userTask" << "serviceTask" << "manualTask" <<
+        "scriptTask" << "sendTask" << "receiveTask" << "businessRuleTask" << "callActivity";
+    static QStringList s_scopes = QStringList() << "subProcess" << "transaction" << "adHocSubProcess";
+    static QStringList s_events = QStringList() << "intermediateThrowEvent" << "intermediateCatchEvent" <<
+        "boundaryEvent";
+
+    QList<Udb::Obj> scopes; // Stapel aus process und subProcess
+    QString edge;
+    QPolygonF waypoints;
+    QString shape;
+    while( !r.atEnd() )
+    {
+        const QXmlStreamReader::TokenType t = r.readNext();
+        if( t == QXmlStreamReader::EndElement )
+        {
+            if( r.name() == "process" || s_scopes.contains( r.name().toString() ) )
+            {
+                if( !scopes.isEmpty() )
+                    scopes.removeLast();
+                if( r.name() == "process" )
+                    resolvePending(); // vor dem DI-Teil, sonst fehlen die BPMNEdges dieser Flows
+            }else if( r.name() == "BPMNEdge" )
+            {
+                createEdge( edge, waypoints );
+                edge.clear();
+                waypoints.clear();
+            }else if( r.name() == "BPMNShape" )
+                shape.clear();
+            continue;
+        }
+        if( t != QXmlStreamReader::StartElement )
+            continue;
+        const QString n = r.name().toString();
+        Udb::Obj o;
+        if( n == "process" )
+        {
+            o = createNode( Function::TID, r, staging );
+            d_diagrams.append( o.getOid() );
+            scopes.append( o );
+        }else if( scopes.isEmpty() )
+        {
+            // DI oder sonstiges ausserhalb von process
+            if( n == "BPMNShape" )
+                shape = r.attributes().value( "bpmnElement" ).toString();
+            else if( n == "Bounds" && !shape.isEmpty() )
+                createShape( shape, r );
+            else if( n == "BPMNEdge" )
+                edge = r.attributes().value( "bpmnElement" ).toString();
+            else if( n == "waypoint" && !edge.isEmpty() )
+                waypoints.append( QPointF( r.attributes().value( "x" ).toString().toDouble(),
+                                           r.attributes().value( "y" ).toString().toDouble() ) );
+            continue;
+        }else if( s_scopes.contains( n ) )
+        {
+            o = createNode( Function::TID, r, scopes.last() );
+            d_diagrams.append( o.getOid() );
+            scopes.append( o );
+        }else if( s_tasks.contains( n ) )
+            o = createNode( Function::TID, r, scopes.last() );
+        else if( n == "startEvent" )
+        {
+            o = createNode( Event::TID, r, scopes.last() );
+            scopes.last().setValueAsObj( Function::AttrStart, o );
+        }else if( n == "endEvent" )
+        {
+            o = createNode( Event::TID, r, scopes.last() );
+            scopes.last().setValueAsObj( Function::AttrFinish, o );
+        }else if( s_events.contains( n ) )
+            o = createNode( Event::TID, r, scopes.last() );
+        else if( n.endsWith( "Gateway" ) )
+        {
+            Connector c = createNode( Connector::TID, r, scopes.last() );
+            if( n == "exclusiveGateway" )
+                c.setConnType( Connector::Xor );
+            else if( n == "inclusiveGateway" )
+                c.setConnType( Connector::Or );
+            else if( n == "parallelGateway" )
+                c.setConnType( Connector::And );
+            o = c;
+        }else if( n == "sequenceFlow" )
+        {
+            PendingFlow f;
+            f.d_id = r.attributes().value( "id" ).toString();
+            f.d_from = r.attributes().value( "sourceRef" ).toString();
+            f.d_to = r.attributes().value( "targetRef" ).toString();
+            if( d_ids.contains( f.d_from ) && d_ids.contains( f.d_to ) )
+                o = createFlow( f.d_id, f.d_from, f.d_to );
+            else
+                d_pending.append( f ); // Ziel steht weiter hinten in der Datei
+        }
+        if( !o.isNull() && !created() )
+            return false;
+    }
+    if( r.hasError() )
+    {
+        d_error = QString( "XML error in line %1: %2" ).arg( r.lineNumber() ).arg( r.errorString() );
+        return false;
+    }
+    return true;
+}
+
+void BpmnStream::resolvePending()
+{
+    // Die Vorwaertsreferenzen innerhalb eines process; ein sequenceFlow darf process nicht verlassen
+    foreach( const PendingFlow& f, d_pending )
+    {
+        if( d_ids.contains( f.d_from ) && d_ids.contains( f.d_to ) )
+            createFlow( f.d_id, f.d_from, f.d_to );
+        else
+            qWarning() << "BpmnStream: sequence flow with unknown end ignored" << f.d_id;
+    }
+    d_pending.clear();
+}
+
+void BpmnStream::completeDiagrams()
+{
+    // Processes ohne DI bekommen ein einfaches Raster, Flows ohne BPMNEdge eine gerade Linie
+    foreach( Udb::OID oid, d_diagrams )
+    {
+        Udb::Obj diagram = d_txn->getObject( oid );
+        if( !d_withShapes.contains( oid ) )
+        {
+            QList<Udb::Obj> nodes;
+            Udb::Obj sub = diagram.getFirstObj();
+            if( !sub.isNull() ) do
+            {
+                if( Procs::isDiagNode( sub.getType() ) )
+                    nodes.append( sub );
+            }while( sub.next() );
+            Procs::addItemsToDiagram( diagram, nodes, QPointF( DiagItem::s_rasterX, DiagItem::s_rasterY ) );
+        }
+        Procs::addItemLinksToDiagram( diagram, QList<Udb::Obj>() );
+    }
+}
+
+Udb::Obj BpmnStream::importProcs(QIODevice * dev, Udb::Obj &parent)
+{
+    Q_ASSERT( !parent.isNull() );
+    d_txn = parent.getTxn();
+    d_error.clear();
+    d_count = 0;
+    d_ids.clear();
+    d_pending.clear();
+    d_diagrams.clear();
+    d_withShapes.clear();
+    // Wie EpkStream::importProcStaged
+    Udb::Obj staging = Procs::createStaging( d_txn );
+    d_txn->commit();
+    QXmlStreamReader r( dev );
+    const bool ok = readDefinitions( r, staging );
+    d_ids.clear();
+    if( !ok || d_diagrams.isEmpty() )
+    {
+        if( ok )
+            d_error = QLatin1String( "no process found" );
+        Procs::discardStaging( staging );
+        return Udb::Obj();
+    }
+    completeDiagrams();
+    return Procs::finishStaging( staging, parent );
+}
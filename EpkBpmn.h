@@ -0,0 +1,82 @@
+#ifndef EPKBPMN_H
+#define EPKBPMN_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QHash>
+#include <QSet>
+#include <QPolygonF>
+#include <Udb/Obj.h>
+
+class QIODevice;
+class QXmlStreamWriter;
+class QXmlStreamReader;
+
+namespace Epk
+{
+    class BpmnStream
+    {
+        // Import und Export von BPMN 2.0 XML mit QXmlStreamReader/-Writer, d.h. ohne DOM.
+        // Abbildung: Tasks und Call Activities -> Function, Sub-Processes -> Function mit Inhalt,
+        // Events -> Event (Start/End zusaetzlich als Function::AttrStart/AttrFinish), Gateways ->
+        // Connector (exclusive=Xor, inclusive=Or, parallel=And), Sequence Flows -> ConFlow.
+        // BPMNShape und BPMNEdge werden zu DiagItems; die Mitte der Bounds ist die Position des DiagItems.
+        // Beim Import werden nur die Zuordnung BPMN-Id -> OID und die noch offenen Flows gehalten;
+        // committed wird portionenweise wie bei EpkStream.
+    public:
+        BpmnStream();
+        virtual ~BpmnStream() {}
+        void setBatchSize( int n ) { d_batchSize = n; }
+        int getCount() const { return d_count; }
+        const QString& getError() const { return d_error; }
+
+        static bool exportProc( QIODevice*, const Udb::Obj& proc );
+        // Importiert alle Processes der Datei unter parent; gibt den ersten zurueck.
+        // Commit erfolgt selber, im Fehlerfall wird alles Importierte wieder entfernt.
+        Udb::Obj importProcs( QIODevice*, Udb::Obj& parent );
+    protected:
+        virtual bool progress( int count ) { Q_UNUSED(count); return true; } // false..Abbruch
+    private:
+        struct PendingFlow
+        {
+            QString d_id;
+            QString d_from;
+            QString d_to;
+        };
+        bool readDefinitions( QXmlStreamReader&, Udb::Obj& staging );
+        Udb::Obj createNode( quint32 type, const QXmlStreamReader&, Udb::Obj parent );
+        Udb::Obj createFlow( const QString& id, const QString& from, const QString& to );
+        void resolvePending();
+        void createShape( const QString& elem, const QXmlStreamReader& bounds );
+        void createEdge( const QString& elem, const QPolygonF& waypoints );
+        bool created();
+        void completeDiagrams();
+        Udb::Transaction* d_txn;
+        QHash<QString,Udb::OID> d_ids; // BPMN-Id -> OID
+        QList<PendingFlow> d_pending;
+        QList<Udb::OID> d_diagrams; // alle erzeugten Processes und Sub-Processes
+        QSet<Udb::OID> d_withShapes;
+        QString d_error;
+        int d_count;
+        int d_batchSize;
+    };
+}
+
+#endif // EPKBPMN_H
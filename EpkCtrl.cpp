@@ -35,6 +35,7 @@
 #include <QtGui/QTextEdit>
 #include <QtGui/QKeyEvent>
 #include <QtCore/QSet>
+#include <QtCore/QSettings>
 #include <QtGui/QVBoxLayout>
 #include <QtGui/QLabel>
 #include <QtGui/QListWidget>
@@ -48,12 +49,13 @@
 #include <Udb/Idx.h>
 #include <QtGui/QApplication>
 #include <QtGui/QClipboard>
+#include <QtGui/QScrollBar>
 #include <QtDebug>
 #include "EpkLayouter.h"
 //#include "FlowLine2App.h"
 using namespace Epk;
 
-const char* EpkCtrl::s_mimeEpkItems = "application/flowline2/epk-items";
+const char* EpkCtrl::s_mimeEpkItems = "application/flowline2/epk-items2"; // 2..mit OID-Tabelle
 
 static EpkLayouter s_layouter;
 
@@ -96,8 +98,9 @@ public:
 };
 
 EpkCtrl::EpkCtrl( EpkView* view, EpkItemMdl * mdl ):
-    QObject( view ),d_mdl(mdl)
+    QObject( view ),d_mdl(mdl),d_selLock(false),d_erased(false)
 {
+    d_lastActive.start();
     Q_ASSERT( view != 0 );
     Q_ASSERT( mdl != 0 );
 }
@@ -192,6 +195,7 @@ void EpkCtrl::addCommands(Gui2::AutoMenu *pop)
     pop->addMenu( sub );
     sub->addCommand( tr( "To File..." ), this, SLOT( onExportToFile() ) );
     sub->addCommand( tr( "To Clipboard" ), this, SLOT( onExportToClipboard() ) );
+    sub->addCommand( tr( "To Tile Pyramid..." ), this, SLOT( onExportTiles() ) );
 
     pop->addSeparator();
 
@@ -203,6 +207,7 @@ void EpkCtrl::addCommands(Gui2::AutoMenu *pop)
 
     pop->addCommand( tr("Show Ident."), this, SLOT(onShowId()) )->setCheckable(true);
     pop->addCommand( tr("Mark Alias"), this, SLOT(onMarkAlias()) )->setCheckable(true);
+    pop->addCommand( tr("Memory Usage..."), this, SLOT(onMemoryUsage()) );
 }
 
 Udb::Obj EpkCtrl::getSingleSelection() const
@@ -280,53 +285,51 @@ void EpkCtrl::onAddFrame()
 void EpkCtrl::onSelectAll()
 {
     ENABLED_IF( true );
-    QPainterPath selectionArea;
-    selectionArea.addRect( d_mdl->sceneRect() );
-    d_mdl->setSelectionArea( selectionArea );
+    d_selLock = true;
+    d_mdl->selectAllItems();
+    d_selLock = false;
+    emit signalSelectionChanged();
+}
+
+void EpkCtrl::selectInRect( const QRectF& r )
+{
+    // Alle Selektionsaenderungen als ein Batch; signalSelectionChanged nur einmal am Schluss
+    d_selLock = true;
+    d_mdl->selectItemsIn( r );
+    d_selLock = false;
+    emit signalSelectionChanged();
 }
 
 void EpkCtrl::onSelectRightward()
 {
     ENABLED_IF( true );
     QRectF r = d_mdl->sceneRect();
-    QPointF p = d_mdl->getStart();
-    r.setLeft( p.x() );
-    QPainterPath pp;
-    pp.addRect( r );
-    d_mdl->setSelectionArea( pp, Qt::ContainsItemShape );
+    r.setLeft( d_mdl->getStart().x() );
+    selectInRect( r );
 }
 
 void EpkCtrl::onSelectUpward()
 {
     ENABLED_IF( true );
     QRectF r = d_mdl->sceneRect();
-    QPointF p = d_mdl->getStart();
-    r.setBottom( p.y() );
-    QPainterPath pp;
-    pp.addRect( r );
-    d_mdl->setSelectionArea( pp, Qt::ContainsItemShape );
+    r.setBottom( d_mdl->getStart().y() );
+    selectInRect( r );
 }
 
 void EpkCtrl::onSelectLeftward()
 {
     ENABLED_IF( true );
     QRectF r = d_mdl->sceneRect();
-    QPointF p = d_mdl->getStart();
-    r.setRight( p.x() );
-    QPainterPath pp;
-    pp.addRect( r );
-    d_mdl->setSelectionArea( pp, Qt::ContainsItemShape );
+    r.setRight( d_mdl->getStart().x() );
+    selectInRect( r );
 }
 
 void EpkCtrl::onSelectDownward()
 {
     ENABLED_IF( true );
     QRectF r = d_mdl->sceneRect();
-    QPointF p = d_mdl->getStart();
-    r.setTop( p.y() );
-    QPainterPath pp;
-    pp.addRect( r );
-    d_mdl->setSelectionArea( pp, Qt::ContainsItemShape );
+    r.setTop( d_mdl->getStart().y() );
+    selectInRect( r );
 }
 
 void EpkCtrl::onRemoveItems()
@@ -351,12 +354,37 @@ void EpkCtrl::onInsertHandle()
     d_mdl->insertHandle();
 }
 
+void EpkCtrl::onMemoryUsage()
+{
+    ENABLED_IF( true );
+    int nodes = 0, segments = 0;
+    const qint64 bytes = d_mdl->estimateMemoryUsage( &nodes, &segments );
+    QMessageBox::information( getView(), tr("Diagram Memory Usage - FlowLine"),
+        tr("Nodes: %1\nFlow segments: %2\nEstimated memory: %3 KB").
+        arg( nodes ).arg( segments ).arg( ( bytes + 1023 ) / 1024 ) );
+}
+
 void EpkCtrl::onExportToClipboard()
 {
     ENABLED_IF( true );
     d_mdl->exportPng( QString() );
 }
 
+void EpkCtrl::onExportTiles()
+{
+    ENABLED_IF( true );
+    const QString dir = QFileDialog::getExistingDirectory( getView(), tr( "Export Tile Pyramid - FlowLine" ),
+        QString(), QFileDialog::DontUseNativeDialog );
+    if( dir.isEmpty() )
+        return;
+    QApplication::setOverrideCursor( Qt::WaitCursor );
+    const int levels = d_mdl->exportTiles( dir );
+    QApplication::restoreOverrideCursor();
+    if( levels < 0 )
+        QMessageBox::critical( getView(), tr("Export Tile Pyramid - FlowLine"),
+            tr("Cannot write tiles to %1!").arg( dir ) );
+}
+
 void EpkCtrl::onExportToFile()
 {
     ENABLED_IF( true );
@@ -371,12 +399,25 @@ void EpkCtrl::onExportToFile()
     {
         if( !path.endsWith( ".png" ) )
             path += ".png";
-        d_mdl->exportPng( path );
+        QApplication::setOverrideCursor( Qt::WaitCursor );
+        const bool ok = d_mdl->exportPng( path );
+        QApplication::restoreOverrideCursor();
+        if( !ok )
+            QMessageBox::critical( getView(), tr("Export Diagram - FlowLine"),
+                tr("Cannot write PNG file!") );
     }else if( filter == "*.pdf" )
     {
         if( !path.endsWith( ".pdf" ) )
             path += ".pdf";
-        d_mdl->exportPdf( path );
+        const bool details = QMessageBox::question( getView(), tr("Export Diagram - FlowLine"),
+            tr("Do you want to append the outlines of functions and events?"),
+            QMessageBox::Yes | QMessageBox::No, QMessageBox::No ) == QMessageBox::Yes;
+        QApplication::setOverrideCursor( Qt::WaitCursor );
+        const bool ok = d_mdl->exportPdf( path, details );
+        QApplication::restoreOverrideCursor();
+        if( !ok )
+            QMessageBox::critical( getView(), tr("Export Diagram - FlowLine"),
+                tr("Cannot write PDF file!") );
     }else if( filter == "*.html" )
     {
         if( !path.endsWith( ".html" ) )
@@ -386,7 +427,9 @@ void EpkCtrl::onExportToFile()
     {
         if( !path.endsWith( ".svg" ) )
             path += ".svg";
-        d_mdl->exportSvg( path );
+        if( !d_mdl->exportSvg( path ) )
+            QMessageBox::critical( getView(), tr("Export Diagram - FlowLine"),
+                tr("Cannot write SVG file!") );
     }else if( filter == "*.flnx" )
     {
         if( !path.endsWith( ".flnx" ) )
@@ -398,8 +441,8 @@ void EpkCtrl::onExportToFile()
                 tr("Cannot open file for writing!") );
             return;
         }
-        Stream::DataWriter out( &f );
-        Epk::EpkStream::exportProc( out, d_mdl->getDiagram() );
+        QSettings set;
+        Epk::EpkStream::exportProc( &f, d_mdl->getDiagram(), set.value( "Export/Compress", true ).toBool() );
         d_mdl->getDiagram().getTxn()->commit();  // Wegen UUID
     }
 }
@@ -446,8 +489,7 @@ void EpkCtrl::onPaste()
 
     if( QApplication::clipboard()->mimeData()->hasFormat( s_mimeEpkItems ) )
     {
-        QList<Udb::Obj> objs = readItems( QApplication::clipboard()->mimeData() );
-        adjustTo( objs, d_mdl->getStart( true ) );
+        readItems( QApplication::clipboard()->mimeData(), true, d_mdl->getStart( true ) );
         d_mdl->getDiagram().getTxn()->commit();
     }else if( QApplication::clipboard()->mimeData()->hasFormat( Udb::Obj::s_mimeObjectRefs ) )
     {
@@ -517,6 +559,7 @@ void EpkCtrl::doLayout()
     // Es ist besser, wenn whrend dem Layout das Diagramm nicht dargestellt wird.
     // Aus irgendwelchen Grnden werden die neuen Positionen ansonsten nicht angezeigt.
     Function diagram = d_mdl->getDiagram();
+    Procs::flushCommits( diagram.getTxn() ); // rollback darf nur das Layout verwerfen
     d_mdl->setDiagram( Udb::Obj() );
     if( !s_layouter.layoutDiagram( diagram, false, diagram.getDirection() == Function::TopToBottom ) )
     {
@@ -889,7 +932,7 @@ void EpkCtrl::onDblClick(const QPoint & pos)
 {
     if( !d_mdl->isReadOnly() )
     {
-        EpkNode* i = dynamic_cast<EpkNode*>( d_mdl->itemAt( getView()->mapToScene( pos ) ) );
+        EpkNode* i = dynamic_cast<EpkNode*>( d_mdl->hitItem( getView()->mapToScene( pos ) ) );
         if( i && i->hasItemText() ) // Auch Aliasse nderbar
         {
             _FlowChartViewTextEdit* edit = new _FlowChartViewTextEdit( 0, i );
@@ -958,7 +1001,8 @@ void EpkCtrl::onCreateSuccLink(const Udb::Obj &pred, int type, const QPointF &po
 
 void EpkCtrl::onSelectionChanged()
 {
-    emit signalSelectionChanged();
+    if( !d_selLock )
+        emit signalSelectionChanged();
 }
 
 void EpkCtrl::onDrop(QByteArray data, QPointF where)
@@ -969,35 +1013,6 @@ void EpkCtrl::onDrop(QByteArray data, QPointF where)
     pasteItemRefs( &mime, where );
 }
 
-void EpkCtrl::adjustTo( const QList<Udb::Obj>& pdmItems, const QPointF& to )
-{
-    QPainterPath bound;
-    int i;
-    for( i = 0; i < pdmItems.size(); i++ )
-    {
-        DiagItem pdmItem = pdmItems[i];
-        if( !pdmItem.hasNodeList() )
-            bound.addRect( pdmItem.getBoundingRect() );
-    }
-    QPointF off = to - bound.boundingRect().topLeft();
-    for( i = 0; i < pdmItems.size(); i++ )
-    {
-        DiagItem pdmItem = pdmItems[i];
-        if( pdmItem.hasNodeList() )
-        {
-            // Das ist ein Link
-            QPolygonF p = pdmItem.getNodeList();
-            for( int j = 0; j < p.size(); j++ )
-                p[j] = EpkItemMdl::rastered( p[j] + off );
-            pdmItem.setNodeList( p );
-        }else
-        {
-            // Das ist ein Task/Milestone
-            pdmItem.setPos( EpkItemMdl::rastered( pdmItem.getPos() + off ) );
-        }
-    }
-}
-
 void EpkCtrl::writeItems(QMimeData *data, const QList<Udb::Obj> & items)
 {
     if( items.isEmpty() )
@@ -1010,21 +1025,113 @@ void EpkCtrl::writeItems(QMimeData *data, const QList<Udb::Obj> & items)
 	Udb::Obj::writeObjectUrls( data, origs, Udb::ContentObject::AttrIdent, Udb::ContentObject::AttrText );
 }
 
-QList<Udb::Obj> EpkCtrl::readItems(const QMimeData *data )
+QList<Udb::Obj> EpkCtrl::readItems(const QMimeData *data, bool moveTo, const QPointF& to )
 {
     if( !data->hasFormat( QLatin1String( s_mimeEpkItems ) ) )
         return QList<Udb::Obj>();
     Stream::DataReader r( data->data(QLatin1String( s_mimeEpkItems )) );
-    return DiagItem::readItems( d_mdl->getDiagram(), r );
+    return DiagItem::readItems( d_mdl->getDiagram(), r, moveTo, to );
 }
 
 const Udb::Obj &EpkCtrl::getDiagram() const
 {
+    if( isHibernated() )
+        return d_sleepingDoc;
     return d_mdl->getDiagram();
 }
 
+void EpkCtrl::hibernate()
+{
+    if( isHibernated() || d_mdl->getDiagram().isNull() )
+        return;
+    if( !getView()->isIdle() || !d_mdl->isIdle() )
+        return; // nicht mitten in einer Benutzeraktion
+    EpkView* v = getView();
+    d_sleepingDoc = d_mdl->getDiagram();
+    d_sleepingSel.clear();
+    foreach( Udb::Obj o, d_mdl->getMultiSelection() )
+        d_sleepingSel.append( o.getOid() );
+    d_sleepingTransform = v->transform();
+    d_sleepingScroll = QPoint( v->horizontalScrollBar()->value(), v->verticalScrollBar()->value() );
+    d_selLock = true;
+    d_mdl->setDiagram( Udb::Obj() ); // gibt alle Items frei und meldet den Observer ab
+    d_selLock = false;
+    // Solange der Tab schlaeft, wird nur noch auf das Loeschen des Diagramms geachtet
+    d_sleepingDoc.getDb()->addObserver( this, SLOT( onSleepingDbUpdate( Udb::UpdateInfo ) ) );
+}
+
+void EpkCtrl::onSleepingDbUpdate( Udb::UpdateInfo info )
+{
+    if( info.d_kind == Udb::UpdateInfo::ObjectErased && isHibernated() && info.d_id == d_sleepingDoc.getOid() &&
+            !d_erased )
+    {
+        d_erased = true;
+        emit signalDiagramErased();
+    }
+}
+
+void EpkCtrl::wakeUp()
+{
+    touch();
+    if( !isHibernated() )
+        return;
+    const Udb::Obj doc = d_sleepingDoc;
+    doc.getDb()->removeObserver( this, SLOT( onSleepingDbUpdate( Udb::UpdateInfo ) ) );
+    d_sleepingDoc = Udb::Obj();
+    if( doc.isNull( true, true ) )
+    {
+        // Diagramm wurde inzwischen geloescht; der Tab wird geschlossen
+        if( !d_erased )
+        {
+            d_erased = true;
+            emit signalDiagramErased();
+        }
+        return;
+    }
+    EpkView* v = getView();
+    d_selLock = true;
+    d_mdl->setDiagram( doc );
+    foreach( Udb::OID oid, d_sleepingSel )
+    {
+        const Udb::Obj o = doc.getObject( oid );
+        if( !o.isNull() )
+            d_mdl->selectObject( o, false );
+    }
+    d_selLock = false;
+    d_sleepingSel.clear();
+    v->setTransform( d_sleepingTransform );
+    v->horizontalScrollBar()->setValue( d_sleepingScroll.x() );
+    v->verticalScrollBar()->setValue( d_sleepingScroll.y() );
+}
+
+bool EpkCtrl::isOnDiagram(const Udb::Obj & o) const
+{
+    if( o.isNull() )
+        return false;
+    if( !isHibernated() )
+        return d_mdl->contains( o.getOid() );
+    // Wie EpkItemMdl::contains: sowohl DiagItems als auch deren OrigObjects
+    if( o.getType() == DiagItem::TID )
+        return o.getParent().equals( d_sleepingDoc );
+    Index::ensure( o.getTxn(), Index::OrigObject );
+    Udb::Idx idx( o.getTxn(), Index::OrigObject );
+    if( idx.seek( o ) ) do
+    {
+        if( o.getObject( idx.getOid() ).getParent().equals( d_sleepingDoc ) )
+            return true;
+    }while( idx.nextKey() );
+    return false;
+}
+
 bool EpkCtrl::focusOn(const Udb::Obj & o)
 {
+    if( isHibernated() && !o.isNull() )
+    {
+        // Nur aufwecken, wenn der Tab danach auch angezeigt wird, d.h. das Objekt hier vorkommt
+        if( !isOnDiagram( o ) )
+            return false;
+        wakeUp();
+    }
     if( o.isNull() || !getView()->isIdle() )
         return d_mdl->contains( o.getOid() );
     QGraphicsItem* i = d_mdl->selectObject( o );
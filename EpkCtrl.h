@@ -22,7 +22,10 @@
 
 #include <QDialog>
 #include <QtCore/QSet>
+#include <QtCore/QTime>
+#include <QtGui/QTransform>
 #include <Udb/Obj.h>
+#include <Udb/UpdateInfo.h>
 #include <Gui2/AutoMenu.h>
 
 namespace Epk
@@ -42,11 +45,19 @@ namespace Epk
         void addCommands( Gui2::AutoMenu * pop );
         Udb::Obj getSingleSelection() const; // Gibt Task/Milestone/Link zurck, nicht PdmItem
         static void writeItems(QMimeData *data, const QList<Udb::Obj>& );
-        QList<Udb::Obj> readItems(const QMimeData *data ); // gibt DiagItem zurck!
+        QList<Udb::Obj> readItems(const QMimeData *data, bool moveTo = false, const QPointF& to = QPointF() ); // gibt DiagItem zurck!
         const Udb::Obj& getDiagram() const;
         bool focusOn( const Udb::Obj& );
+        bool isOnDiagram( const Udb::Obj& ) const; // aus der DB, weckt einen schlafenden Tab nicht
+        // Hibernation von Tabs im Hintergrund; es bleibt nur der View-Zustand erhalten
+        void hibernate();
+        void wakeUp();
+        bool isHibernated() const { return !d_sleepingDoc.isNull(); }
+        void touch() { d_lastActive.start(); }
+        int idleSecs() const { return d_lastActive.elapsed() / 1000; }
     signals:
         void signalSelectionChanged();
+        void signalDiagramErased(); // das Diagramm eines schlafenden Tabs wurde geloescht
     public slots:
         void onAddFunction();
         void onAddEvent();
@@ -59,6 +70,7 @@ namespace Epk
         void onInsertHandle();
         void onExportToFile();
         void onExportToClipboard();
+        void onExportTiles();
         void onSelectRightward();
         void onSelectUpward();
         void onSelectLeftward();
@@ -81,19 +93,28 @@ namespace Epk
         void onEditAttrs();
 		void onPinItems();
 		void onUnpinItems();
+        void onMemoryUsage();
 	protected slots:
         void onDblClick( const QPoint& );
         void onCreateLink( const Udb::Obj& pred, const Udb::Obj& succ, const QPolygonF& path );
         void onCreateSuccLink( const Udb::Obj& pred, int type, const QPointF& pos, const QPolygonF& path );
         void onSelectionChanged();
         void onDrop( QByteArray, QPointF );
+        void onSleepingDbUpdate( Udb::UpdateInfo );
     protected:
         void onAddItem( quint32 type, int kind = 0 );
         void pasteItemRefs(const QMimeData *data, const QPointF &where );
         void doLayout();
-        static void adjustTo( const QList<Udb::Obj>&, const QPointF& to ); // erwartet PdmItems
+        void selectInRect( const QRectF& );
     private:
         EpkItemMdl* d_mdl;
+        Udb::Obj d_sleepingDoc;
+        QList<Udb::OID> d_sleepingSel; // DiagItems
+        QTransform d_sleepingTransform;
+        QPoint d_sleepingScroll;
+        QTime d_lastActive;
+        bool d_selLock;
+        bool d_erased; // signalDiagramErased nur einmal
     };
 
     class ObjAttrDlg : public QDialog
@@ -0,0 +1,305 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkDelta.h"
+#include "EpkObjects.h"
+#include "EpkProcs.h"
+#include <Stream/DataReader.h>
+#include <Stream/DataWriter.h>
+#include <Udb/Transaction.h>
+#include <Udb/Idx.h>
+#include <QSet>
+#include <QtDebug>
+using namespace Epk;
+using namespace Stream;
+
+static QList<quint32> _attrs()
+{
+    static QList<quint32> res;
+    if( res.isEmpty() )
+    {
+        res << Udb::ContentObject::AttrText << Udb::ContentObject::AttrIdent <<
+               Udb::ContentObject::AttrAltIdent << Udb::ContentObject::AttrCreatedOn <<
+               Udb::ContentObject::AttrModifiedOn << Oln::OutlineItem::AttrAlias;
+        for( quint32 a = MinAttr; a <= MaxAttr; a++ )
+            if( a != Tombstone::AttrErasedObj )
+                res << a;
+    }
+    return res;
+}
+
+bool EpkDelta::isSupportedType(quint32 type)
+{
+    return type == DiagItem::TID || type == Function::TID || type == Event::TID ||
+        type == Connector::TID || type == ConFlow::TID || type == FuncDomain::TID ||
+        type == Diagram::TID || type == Allocation::TID;
+}
+
+int EpkDelta::exportDelta(QIODevice * dev, Udb::Transaction * txn, const QDateTime &since)
+{
+    Q_ASSERT( txn != 0 );
+    if( dev == 0 )
+        return -1;
+    DataWriter out( dev );
+    out.writeSlot( DataCell().setAscii( "FlowLineDelta" ) );
+    out.writeSlot( DataCell().setAscii( "0.1" ) );
+    out.writeSlot( DataCell().setDateTime( since ) );
+    out.writeSlot( DataCell().setDateTime( QDateTime::currentDateTime() ) );
+
+    const QList<quint32> attrs = _attrs();
+    int count = 0;
+    QSet<Udb::OID> done; // ein Objekt kann mehrmals im Index stehen, solange er nicht bereinigt ist
+    Index::ensure( txn, Index::ModifiedOn );
+    Udb::Idx idx( txn, Index::ModifiedOn );
+    if( idx.lowerBound( DataCell().setDateTime( since ) ) ) do
+    {
+        const Udb::Obj o = txn->getObject( idx.getOid() );
+        if( o.isNull() || done.contains( o.getOid() ) )
+            continue;
+        done.insert( o.getOid() );
+        const quint32 type = o.getType();
+        if( type == Tombstone::TID )
+        {
+            out.startFrame( NameTag( "del" ) );
+            out.writeSlot( o.getValue( Tombstone::AttrErasedObj ), NameTag( "uuid" ) );
+            out.endFrame();
+            count++;
+        }else if( isSupportedType( type ) )
+        {
+            out.startFrame( NameTag( "obj" ) );
+            out.writeSlot( DataCell().setUuid( o.getUuid() ), NameTag( "uuid" ) );
+            out.writeSlot( DataCell().setUInt32( type ), NameTag( "type" ) );
+            const Udb::Obj parent = o.getParent();
+            if( !parent.isNull() )
+                out.writeSlot( DataCell().setUuid( parent.getUuid() ), NameTag( "prnt" ) );
+            foreach( quint32 a, attrs )
+            {
+                const DataCell v = o.getValue( a );
+                if( !v.hasValue() )
+                    continue;
+                out.writeSlot( DataCell().setUInt32( a ), NameTag( "attr" ) );
+                if( v.isOid() )
+                {
+                    const Udb::Obj ref = txn->getObject( v.getOid() );
+                    if( ref.isNull() )
+                        out.writeSlot( DataCell().setNull(), NameTag( "val" ) );
+                    else
+                        out.writeSlot( DataCell().setUuid( ref.getUuid() ), NameTag( "ref" ) );
+                }else
+                    out.writeSlot( v, NameTag( "val" ) );
+            }
+            out.endFrame();
+            count++;
+        }
+    }while( idx.next() );
+    return count;
+}
+
+bool EpkDelta::readObj(DataReader & in, EpkDelta::Record & r)
+{
+    r.d_type = 0;
+    quint32 attr = 0;
+    DataReader::Token t = in.nextToken();
+    while( t == DataReader::Slot )
+    {
+        const NameTag n = in.getName().getTag();
+        if( n.equals( "uuid" ) )
+            r.d_uuid = in.getValue().getUuid();
+        else if( n.equals( "type" ) )
+            r.d_type = in.getValue().getUInt32();
+        else if( n.equals( "prnt" ) )
+            r.d_parent = in.getValue().getUuid();
+        else if( n.equals( "attr" ) )
+            attr = in.getValue().getUInt32();
+        else if( ( n.equals( "val" ) || n.equals( "ref" ) ) && attr != 0 )
+        {
+            r.d_attrs.append( attr );
+            r.d_vals.append( in.getValue() );
+            r.d_isRef.append( n.equals( "ref" ) );
+            attr = 0;
+        }
+        t = in.nextToken();
+    }
+    if( t != DataReader::EndFrame || r.d_uuid.isNull() )
+    {
+        d_error = QLatin1String( "invalid object record" );
+        return false;
+    }
+    return true;
+}
+
+int EpkDelta::importDelta(QIODevice * dev, Udb::Transaction * txn)
+{
+    Q_ASSERT( txn != 0 );
+    d_error.clear();
+    DataReader in( dev );
+    if( in.nextToken() != DataReader::Slot || in.getValue().getArr() != "FlowLineDelta" )
+    {
+        d_error = QLatin1String( "invalid delta stream" );
+        return -1;
+    }
+    if( in.nextToken() != DataReader::Slot || in.getValue().getArr() != "0.1" )
+    {
+        d_error = QLatin1String( "invalid delta version" );
+        return -1;
+    }
+    if( in.nextToken() != DataReader::Slot || !in.getValue().isDateTime() ||
+            in.nextToken() != DataReader::Slot || !in.getValue().isDateTime() )
+    {
+        d_error = QLatin1String( "invalid protocol" );
+        return -1;
+    }
+    d_exportedOn = in.getValue().getDateTime();
+
+    // Zuerst alles lesen; Eltern und Referenzen koennen im Stream nach dem Objekt stehen
+    QList<Record> objs;
+    QList<QUuid> dels;
+    DataReader::Token t = in.nextToken();
+    while( t == DataReader::BeginFrame )
+    {
+        const NameTag n = in.getName().getTag();
+        if( n.equals( "obj" ) )
+        {
+            Record r;
+            if( !readObj( in, r ) )
+                return -1;
+            if( isSupportedType( r.d_type ) )
+                objs.append( r );
+        }else if( n.equals( "del" ) )
+        {
+            Record r;
+            if( !readObj( in, r ) )
+                return -1;
+            dels.append( r.d_uuid );
+        }else
+            in.skipToEndFrame();
+        t = in.nextToken();
+    }
+    if( t == DataReader::EndFrame || t == DataReader::Slot )
+    {
+        d_error = QLatin1String( "protocol error" );
+        return -1;
+    }
+
+    // Vor dem ersten Schreiben pruefen, ob alle Eltern und Referenzen im Stream oder in der Datenbank
+    // vorhanden sind; sonst entstuenden Objekte ohne Eltern bzw. stillschweigend fehlende Referenzen
+    QSet<QUuid> inStream;
+    foreach( const Record& r, objs )
+        inStream.insert( r.d_uuid );
+    QList<QUuid> unresolved;
+    foreach( const Record& r, objs )
+    {
+        if( !r.d_parent.isNull() && !inStream.contains( r.d_parent ) &&
+                txn->getObject( DataCell().setUuid( r.d_parent ) ).isNull() )
+            unresolved.append( r.d_parent );
+        for( int i = 0; i < r.d_attrs.size(); i++ )
+        {
+            if( r.d_isRef[i] && !inStream.contains( r.d_vals[i].getUuid() ) &&
+                    txn->getObject( r.d_vals[i] ).isNull() )
+                unresolved.append( r.d_vals[i].getUuid() );
+        }
+    }
+    if( !unresolved.isEmpty() )
+    {
+        d_error = QString( "%1 unresolved parents or references, e.g. %2" ).
+                arg( unresolved.size() ).arg( unresolved.first().toString() );
+        return -1;
+    }
+
+    foreach( const Record& r, objs )
+        txn->getOrCreateObject( r.d_uuid, r.d_type );
+    foreach( const Record& r, objs )
+    {
+        Udb::Obj o = txn->getObject( DataCell().setUuid( r.d_uuid ) );
+        if( !r.d_parent.isNull() )
+        {
+            Udb::Obj p = txn->getObject( DataCell().setUuid( r.d_parent ) );
+            if( !p.isNull() && !o.getParent().equals( p ) )
+            {
+                if( o.getParent().isNull() )
+                    o.aggregateTo( p );
+                else
+                    Procs::moveTo( o, p, Udb::Obj() );
+            }
+        }
+        for( int i = 0; i < r.d_attrs.size(); i++ )
+        {
+            if( r.d_isRef[i] )
+            {
+                o.setValueAsObj( r.d_attrs[i], txn->getObject( r.d_vals[i] ) ); // oben geprueft
+            }else if( r.d_vals[i].isNull() )
+                o.clearValue( r.d_attrs[i] );
+            else
+                o.setValue( r.d_attrs[i], r.d_vals[i] );
+        }
+    }
+    foreach( const QUuid& u, dels )
+    {
+        Udb::Obj o = txn->getObject( DataCell().setUuid( u ) );
+        if( !o.isNull() )
+            Procs::erase( o );
+    }
+    return objs.size() + dels.size();
+}
+
+static void _assignUuids( const Udb::Obj& o, int& count )
+{
+    if( EpkDelta::isSupportedType( o.getType() ) && o.getUuid( false ).isNull() )
+    {
+        o.getUuid();
+        count++;
+    }
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        _assignUuids( sub, count );
+    }while( sub.next() );
+}
+
+int EpkDelta::assignUuids(Udb::Transaction * txn)
+{
+    Q_ASSERT( txn != 0 );
+    int count = 0;
+    // Udb kann nicht ueber alle Objekte iterieren; alle Wurzeln, unter denen FlowLine Objekte anlegt
+    _assignUuids( FuncDomain::getOrCreateRoot( txn ), count );
+    _assignUuids( SystemElement::getOrCreateRoot( txn ), count );
+    _assignUuids( Udb::RootFolder::getOrCreate( txn ), count );
+    return count;
+}
+
+int EpkDelta::purgeTombstones(Udb::Transaction * txn, const QDateTime &before)
+{
+    Q_ASSERT( txn != 0 );
+    // Zuerst sammeln; Loeschen veraendert den Index, ueber den wir laufen
+    QList<Udb::OID> dead;
+    Index::ensure( txn, Index::ModifiedOn );
+    Udb::Idx idx( txn, Index::ModifiedOn );
+    if( idx.first() ) do
+    {
+        const Udb::Obj o = txn->getObject( idx.getOid() );
+        if( o.getType() != Tombstone::TID )
+            continue;
+        if( o.getValue( Udb::ContentObject::AttrModifiedOn ).getDateTime() >= before )
+            break; // Index ist nach Zeit sortiert
+        dead.append( o.getOid() );
+    }while( idx.next() );
+    foreach( Udb::OID oid, dead )
+        txn->getObject( oid ).erase(); // nicht Procs::erase, das wieder einen Tombstone anlegt
+    return dead.size();
+}
@@ -0,0 +1,90 @@
+#ifndef EPKDELTA_H
+#define EPKDELTA_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QDateTime>
+#include <QList>
+#include <Udb/Obj.h>
+
+class QIODevice;
+
+namespace Stream
+{
+    class DataReader;
+}
+
+namespace Epk
+{
+    class EpkDelta
+    {
+        // Aenderungen seit einem Zeitpunkt uebertragen. Der Export laeuft ueber Index::ModifiedOn
+        // und schreibt nur Objekte, die seit 'since' geaendert wurden, sowie die Tombstones der seither
+        // geloeschten Objekte. Die Objekte werden in beiden Datenbanken ueber ihre Uuid identifiziert.
+        // Nur Epk-Objekte (Functions, Events, Connectors, Flows, Domains, DiagItems, Allocations);
+        // Outlines werden nicht erfasst.
+        /* Format:
+            Slot <ascii> = "FlowLineDelta"
+            Slot <ascii> = "0.1"
+            Slot <DateTime> = since
+            Slot <DateTime> = Zeitpunkt des Exports
+            Frame 'obj'
+                Slot 'uuid' = <uuid>
+                Slot 'type' = <uint32>
+                [ Slot 'prnt' = <uuid> ]
+                { Slot 'attr' = <uint32> ( Slot 'val' = <any> | Slot 'ref' = <uuid> ) }
+            End
+            Frame 'del'
+                Slot 'uuid' = <uuid>
+            End
+        */
+    public:
+        // Gibt die Anzahl Objekte zurueck oder -1. Kann Uuids vergeben; der Aufrufer committed.
+        static int exportDelta( QIODevice*, Udb::Transaction*, const QDateTime& since );
+        // Wendet ein Delta an, ohne Commit. Gibt die Anzahl Aenderungen zurueck oder -1; -1 auch, wenn
+        // ein Eltern- oder Referenzobjekt weder im Stream noch in der Datenbank steht.
+        int importDelta( QIODevice*, Udb::Transaction* );
+        const QString& getError() const { return d_error; }
+        const QDateTime& getExportedOn() const { return d_exportedOn; }
+        static bool isSupportedType( quint32 );
+        // Einmalige Migration: vergibt allen Epk-Objekten ohne Uuid eine; neue Objekte erhalten sie
+        // bereits in Procs::createObject bzw. DiagItem::create. Ohne Commit.
+        static int assignUuids( Udb::Transaction* );
+        // Entfernt Tombstones, die vor 'before' entstanden. Nie als Folge eines Exports aufrufen, da andere
+        // Kopien ab einem frueheren Datum abgleichen koennen; nur nach Ablauf einer Aufbewahrungsfrist.
+        // Ohne Commit.
+        static int purgeTombstones( Udb::Transaction*, const QDateTime& before );
+    private:
+        struct Record
+        {
+            QUuid d_uuid;
+            QUuid d_parent;
+            quint32 d_type;
+            QList<quint32> d_attrs;
+            QList<Stream::DataCell> d_vals; // Uuid-Zellen bei Referenzen
+            QList<bool> d_isRef;
+        };
+        bool readObj( Stream::DataReader&, Record& );
+        QString d_error;
+        QDateTime d_exportedOn;
+    };
+}
+
+#endif // EPKDELTA_H
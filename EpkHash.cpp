@@ -0,0 +1,324 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkHash.h"
+#include "EpkObjects.h"
+#include <Udb/Transaction.h>
+#include <Udb/Database.h>
+#include <Udb/Idx.h>
+#include <QCryptographicHash>
+#include <QStringList>
+using namespace Epk;
+using namespace Stream;
+
+ContentHash::ContentHash(Udb::Transaction * txn, QObject *parent):
+    QObject(parent),d_txn(txn),d_withLayout(false)
+{
+    Q_ASSERT( txn != 0 );
+    d_txn->getDb()->addObserver( this, SLOT( onDbUpdate( Udb::UpdateInfo ) ) );
+}
+
+ContentHash::~ContentHash()
+{
+    d_txn->getDb()->removeObserver( this, SLOT( onDbUpdate( Udb::UpdateInfo ) ) );
+}
+
+void ContentHash::setWithLayout(bool on)
+{
+    if( d_withLayout == on )
+        return;
+    d_withLayout = on;
+    d_cache.clear();
+}
+
+static inline bool _isTree( quint32 type )
+{
+    return type == Function::TID || type == FuncDomain::TID;
+}
+
+static void _addCell( QCryptographicHash& h, const DataCell& v )
+{
+    // Typ und Wert; unterschiedliche Reihenfolgen gleicher Werte duerfen nicht kollidieren
+    const QByteArray str = v.toString().toUtf8();
+    const quint32 len = str.size();
+    h.addData( reinterpret_cast<const char*>( &len ), sizeof(len) );
+    h.addData( str );
+}
+
+static void _addHead( QCryptographicHash& h, const Udb::Obj& o )
+{
+    // Nur der Schluessel, ueber den compare die Objekte zuordnet, und der Inhalt. AttrIdent wird pro
+    // Repository vergeben und wuerde sonst identische Inhalte verschieden machen.
+    const quint32 type = o.getType();
+    h.addData( reinterpret_cast<const char*>( &type ), sizeof(type) );
+    _addCell( h, DataCell().setString( ContentHash::keyOf( o ) ) );
+    _addCell( h, o.getValue( Root::AttrText ) );
+}
+
+QString ContentHash::keyOf(const Udb::Obj & o)
+{
+    QString res = o.getString( Root::AttrAltIdent );
+    if( res.isEmpty() )
+        res = o.getString( Root::AttrIdent );
+    if( res.isEmpty() )
+        res = o.getString( Root::AttrText );
+    return res;
+}
+
+Udb::Obj ContentHash::findByKey(Udb::Transaction * txn, const QString & key)
+{
+    Index::ensure( txn, Index::AltIdent );
+    Udb::Idx alt( txn, Index::AltIdent );
+    if( alt.seek( DataCell().setString( key ) ) )
+        return txn->getObject( alt.getOid() );
+    Index::ensure( txn, Index::Ident );
+    Udb::Idx id( txn, Index::Ident );
+    if( id.seek( DataCell().setString( key ) ) )
+        return txn->getObject( id.getOid() );
+    return Udb::Obj();
+}
+
+QByteArray ContentHash::leafHash(const Udb::Obj & o)
+{
+    QCryptographicHash h( QCryptographicHash::Sha1 );
+    _addHead( h, o );
+    const quint32 type = o.getType();
+    if( type == DiagItem::TID )
+    {
+        h.addData( keyOf( o.getValueAsObj( DiagItem::AttrOrigObject ) ).toUtf8() );
+        _addCell( h, o.getValue( DiagItem::AttrPosX ) );
+        _addCell( h, o.getValue( DiagItem::AttrPosY ) );
+        _addCell( h, o.getValue( DiagItem::AttrWidth ) );
+        _addCell( h, o.getValue( DiagItem::AttrHeight ) );
+        const QPolygonF nodes = DiagItem( o ).getNodeList();
+        h.addData( reinterpret_cast<const char*>( nodes.constData() ), nodes.size() * sizeof(QPointF) );
+        return h.result();
+    }
+    _addCell( h, o.getValue( Connector::AttrConnType ) );
+    QStringList succs;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() == ConFlow::TID )
+            succs.append( keyOf( sub.getValueAsObj( ConFlow::AttrSucc ) ) );
+    }while( sub.next() );
+    succs.sort();
+    foreach( const QString& s, succs )
+        _addCell( h, DataCell().setString( s ) );
+    return h.result();
+}
+
+QByteArray ContentHash::getHash(const Udb::Obj & o)
+{
+    if( o.isNull() )
+        return QByteArray();
+    const quint32 type = o.getType();
+    if( !_isTree( type ) )
+        return leafHash( o );
+    QMap<Udb::OID,Entry>::const_iterator i = d_cache.find( o.getOid() );
+    if( i != d_cache.end() )
+        return i.value().d_hash;
+
+    QCryptographicHash h( QCryptographicHash::Sha1 );
+    _addHead( h, o );
+    // Reihenfolge der Aggregation ist nicht Teil des Inhalts
+    QList<QByteArray> subs;
+    QStringList succs;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        const quint32 t = sub.getType();
+        if( _isTree( t ) || t == Event::TID || t == Connector::TID || ( d_withLayout && t == DiagItem::TID ) )
+            subs.append( getHash( sub ) );
+        else if( t == ConFlow::TID )
+            succs.append( keyOf( sub.getValueAsObj( ConFlow::AttrSucc ) ) );
+    }while( sub.next() );
+    qSort( subs );
+    foreach( const QByteArray& s, subs )
+        h.addData( s );
+    succs.sort();
+    foreach( const QString& s, succs )
+        _addCell( h, DataCell().setString( s ) );
+    Entry e;
+    e.d_hash = h.result();
+    e.d_parent = o.getParent().getOid();
+    d_cache[ o.getOid() ] = e;
+    return e.d_hash;
+}
+
+void ContentHash::invalidate(Udb::OID oid)
+{
+    // Vom geaenderten Objekt bis zur Wurzel alle Eintraege verwerfen
+    Udb::Obj o = d_txn->getObject( oid );
+    if( o.isNull() )
+    {
+        QMap<Udb::OID,Entry>::iterator i = d_cache.find( oid );
+        if( i == d_cache.end() )
+        {
+            d_cache.clear(); // Eltern unbekannt
+            return;
+        }
+        oid = i.value().d_parent;
+        d_cache.erase( i );
+        o = d_txn->getObject( oid );
+    }
+    while( !o.isNull() )
+    {
+        d_cache.remove( o.getOid() );
+        o = o.getParent();
+    }
+}
+
+void ContentHash::invalidateReferrers(Udb::OID oid)
+{
+    // Der Schluessel eines Objekts steckt auch im Hash der Flows, die auf es zeigen (AttrSucc), und
+    // der DiagItems, die es darstellen. Flows mit AttrPred == oid sind Kinder und schon erfasst.
+    Index::ensure( d_txn, Index::Succ );
+    Udb::Idx succ( d_txn, Index::Succ );
+    if( succ.seek( DataCell().setOid( oid ) ) ) do
+    {
+        invalidate( succ.getOid() );
+    }while( succ.nextKey() );
+    if( !d_withLayout )
+        return;
+    Index::ensure( d_txn, Index::OrigObject );
+    Udb::Idx items( d_txn, Index::OrigObject );
+    if( items.seek( DataCell().setOid( oid ) ) ) do
+    {
+        invalidate( items.getOid() );
+    }while( items.nextKey() );
+}
+
+void ContentHash::onDbUpdate(Udb::UpdateInfo info)
+{
+    if( d_cache.isEmpty() )
+        return;
+    switch( info.d_kind )
+    {
+    case Udb::UpdateInfo::ValueChanged:
+        invalidate( info.d_id );
+        if( info.d_name == Root::AttrText || info.d_name == Root::AttrIdent ||
+                info.d_name == Root::AttrAltIdent )
+            invalidateReferrers( info.d_id ); // keyOf hat sich geaendert
+        break;
+    case Udb::UpdateInfo::ObjectErased:
+        invalidate( info.d_id );
+        invalidateReferrers( info.d_id );
+        break;
+    case Udb::UpdateInfo::TypeChanged:
+        invalidate( info.d_id );
+        break;
+    case Udb::UpdateInfo::Aggregated:
+    case Udb::UpdateInfo::Deaggregated:
+        invalidate( info.d_id );
+        invalidate( info.d_parent );
+        break;
+    default:
+        break;
+    }
+}
+
+static QString _matchKey( const Udb::Obj& o )
+{
+    // Connectors haben meist weder Ident noch Text; sie werden dann ueber Typ, Connector-Typ und die
+    // Schluessel ihrer Vorgaenger und Nachfolger zugeordnet, statt alle unter demselben leeren Schluessel
+    const QString key = ContentHash::keyOf( o );
+    if( !key.isEmpty() )
+        return key;
+    QStringList ends;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() == ConFlow::TID )
+            ends.append( QLatin1Char( '>' ) + ContentHash::keyOf( sub.getValueAsObj( ConFlow::AttrSucc ) ) );
+    }while( sub.next() );
+    Index::ensure( o.getTxn(), Index::Succ );
+    Udb::Idx succ( o.getTxn(), Index::Succ );
+    if( succ.seek( o ) ) do
+    {
+        const Udb::Obj flow = o.getObject( succ.getOid() );
+        ends.append( QLatin1Char( '<' ) + ContentHash::keyOf( flow.getValueAsObj( ConFlow::AttrPred ) ) );
+    }while( succ.nextKey() );
+    ends.sort();
+    return QString( "#%1/%2/%3" ).arg( o.getType() ).
+            arg( o.getValue( Connector::AttrConnType ).getUInt8() ).arg( ends.join( QLatin1String( "," ) ) );
+}
+
+static QMap<QString,Udb::Obj> _children( const Udb::Obj& o )
+{
+    QMap<QString,Udb::Obj> res;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        const quint32 t = sub.getType();
+        if( _isTree( t ) || t == Event::TID || t == Connector::TID )
+            res.insertMulti( _matchKey( sub ), sub );
+    }while( sub.next() );
+    return res;
+}
+
+QList<ContentHash::Diff> ContentHash::compare(ContentHash & l, const Udb::Obj & left,
+                                                ContentHash & r, const Udb::Obj & right)
+{
+    QList<Diff> res;
+    if( l.getHash( left ) == r.getHash( right ) )
+        return res;
+    Diff d;
+    d.d_left = left;
+    d.d_right = right;
+    if( !_isTree( left.getType() ) || !_isTree( right.getType() ) )
+    {
+        res.append( d );
+        return res;
+    }
+    const QMap<QString,Udb::Obj> ls = _children( left );
+    QMap<QString,Udb::Obj> rs = _children( right );
+    bool found = false;
+    QMap<QString,Udb::Obj>::const_iterator i;
+    for( i = ls.begin(); i != ls.end(); ++i )
+    {
+        QMap<QString,Udb::Obj>::iterator j = rs.find( i.key() );
+        if( j == rs.end() )
+        {
+            Diff dl;
+            dl.d_left = i.value();
+            res.append( dl );
+            found = true;
+        }else
+        {
+            const QList<Diff> sub = compare( l, i.value(), r, j.value() );
+            if( !sub.isEmpty() )
+            {
+                res += sub;
+                found = true;
+            }
+            rs.erase( j );
+        }
+    }
+    for( i = rs.begin(); i != rs.end(); ++i )
+    {
+        Diff dr;
+        dr.d_right = i.value();
+        res.append( dr );
+        found = true;
+    }
+    if( !found )
+        res.append( d ); // Unterschied im Knoten selber, z.B. Text oder Flows
+    return res;
+}
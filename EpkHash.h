@@ -0,0 +1,76 @@
+#ifndef EPKHASH_H
+#define EPKHASH_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QMap>
+#include <Udb/Obj.h>
+#include <Udb/UpdateInfo.h>
+
+namespace Epk
+{
+    class ContentHash : public QObject
+    {
+        // Merkle-Hash (SHA1) ueber Function- und FuncDomain-Hierarchien. Ein Knoten hasht Typ, keyOf und
+        // Text sowie die sortierten Hashes seiner Kinder; Events und Connectors zusaetzlich
+        // den Connector-Typ und die von ihnen ausgehenden Flows (identifiziert ueber den Schluessel des
+        // Nachfolgers). Optional fliesst das Layout der DiagItems ein. Die Hashes der Functions und
+        // Domains werden gecacht und bei jeder Aenderung eines Nachfahren entlang der Eltern verworfen,
+        // bei einer Aenderung des Schluessels auch bei den Flows und DiagItems, die darauf zeigen.
+        Q_OBJECT
+    public:
+        struct Diff
+        {
+            Udb::Obj d_left;   // null, falls nur rechts vorhanden
+            Udb::Obj d_right;  // null, falls nur links vorhanden
+        };
+        ContentHash( Udb::Transaction*, QObject* parent );
+        ~ContentHash();
+        void setWithLayout( bool on );
+        bool isWithLayout() const { return d_withLayout; }
+        QByteArray getHash( const Udb::Obj& );
+        void clear() { d_cache.clear(); }
+        int getCacheSize() const { return d_cache.size(); }
+
+        // Steigt nur in Teilbaeume ab, deren Hash sich unterscheidet. Die Kinder werden ueber keyOf
+        // einander zugeordnet, ohne keyOf ueber Typ und die Schluessel ihrer Flows. Gibt die kleinsten
+        // unterschiedlichen Objekte zurueck.
+        static QList<Diff> compare( ContentHash& l, const Udb::Obj& left, ContentHash& r, const Udb::Obj& right );
+        static QString keyOf( const Udb::Obj& ); // AltIdent, sonst Ident, sonst Text
+        static Udb::Obj findByKey( Udb::Transaction*, const QString& );
+    protected slots:
+        void onDbUpdate( Udb::UpdateInfo );
+    private:
+        struct Entry
+        {
+            QByteArray d_hash;
+            Udb::OID d_parent;
+        };
+        QByteArray leafHash( const Udb::Obj& );
+        void invalidate( Udb::OID );
+        void invalidateReferrers( Udb::OID );
+        Udb::Transaction* d_txn;
+        QMap<Udb::OID,Entry> d_cache;
+        bool d_withLayout;
+    };
+}
+
+#endif // EPKHASH_H
@@ -0,0 +1,465 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkHtmlSite.h"
+#include "EpkItemMdl.h"
+#include "EpkObjects.h"
+#include "EpkProcs.h"
+#include <Oln2/OutlineItem.h>
+#include <Oln2/OutlineToHtml.h>
+#include <QTextDocument>
+#include <QTextStream>
+#include <QFile>
+#include <QStringList>
+#include <QCryptographicHash>
+using namespace Epk;
+
+static const char* s_manifest = "site.manifest";
+static const char* s_outlines = "outlines";
+static const char* s_stampFormat = "yyyy-MM-ddThh:mm:ss.zzz";
+
+static inline void _latest( QDateTime& res, const QDateTime& t )
+{
+    if( t.isValid() && ( !res.isValid() || t > res ) )
+        res = t;
+}
+
+static inline QDateTime _modified( const Udb::Obj& o )
+{
+    return o.getValue( Root::AttrModifiedOn ).getDateTime();
+}
+
+static inline Udb::Obj _resolved( const Udb::Obj& o )
+{
+    const Udb::Obj ali = o.getValueAsObj( Oln::OutlineItem::AttrAlias );
+    if( ali.isNull() )
+        return o;
+    else
+        return ali;
+}
+
+static inline QString _pageName( Udb::OID oid )
+{
+    return QString( "%1.html" ).arg( oid );
+}
+
+HtmlSite::HtmlSite():d_skipped(0)
+{
+    d_mdl = new EpkItemMdl( 0 );
+    d_mdl->setReadOnly( true );
+}
+
+HtmlSite::~HtmlSite()
+{
+    delete d_mdl;
+}
+
+void HtmlSite::collect(const Udb::Obj & o)
+{
+    bool diagram = false;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        const quint32 type = sub.getType();
+        if( type == Function::TID || type == FuncDomain::TID )
+            collect( sub );
+        else if( type == DiagItem::TID )
+            diagram = true;
+    }while( sub.next() );
+    if( diagram && o.getType() == Function::TID )
+    {
+        d_diagrams.append( o );
+        d_withPage.insert( o.getOid() );
+    }
+}
+
+bool HtmlSite::hasOutline(const Udb::Obj & o)
+{
+    Udb::Obj s = o.getFirstObj();
+    if( !s.isNull() ) do
+    {
+        if( s.getType() == Oln::OutlineItem::TID )
+            return true;
+    }while( s.next() );
+    return false;
+}
+
+QDateTime HtmlSite::outlineStamp(const Udb::Obj & o)
+{
+    QMap<Udb::OID,QDateTime>::const_iterator i = d_outlineStamps.find( o.getOid() );
+    if( i != d_outlineStamps.end() )
+        return i.value();
+    QDateTime res = _modified( o );
+    Udb::Obj s = o.getFirstObj();
+    if( !s.isNull() ) do
+    {
+        if( s.getType() == Oln::OutlineItem::TID )
+            _latest( res, outlineStamp( s ) );
+    }while( s.next() );
+    d_outlineStamps[ o.getOid() ] = res;
+    return res;
+}
+
+QByteArray HtmlSite::outlineHash(const Udb::Obj & o)
+{
+    // Reihenfolge und Bestand der OutlineItems; Loeschen und Umordnen aendern keinen Zeitstempel
+    QMap<Udb::OID,QByteArray>::const_iterator i = d_outlineHashes.find( o.getOid() );
+    if( i != d_outlineHashes.end() )
+        return i.value();
+    QCryptographicHash h( QCryptographicHash::Sha1 );
+    Udb::Obj s = o.getFirstObj();
+    if( !s.isNull() ) do
+    {
+        if( s.getType() == Oln::OutlineItem::TID )
+        {
+            const Udb::OID oid = s.getOid();
+            h.addData( reinterpret_cast<const char*>( &oid ), sizeof(oid) );
+            h.addData( outlineHash( s ) );
+        }
+    }while( s.next() );
+    const QByteArray res = h.result();
+    d_outlineHashes[ o.getOid() ] = res;
+    return res;
+}
+
+QString HtmlSite::pageStamp(const Udb::Obj & diagram)
+{
+    // Juengster AttrModifiedOn plus ein Hash ueber das, was sich ohne neuen Zeitstempel aendern kann:
+    // die Liste der Kinder (Loeschen aendert keinen uebrigen Stempel) und ob ein Ziel eine eigene
+    // Seite hat (bestimmt die Links der Image-Map)
+    QDateTime res = outlineStamp( diagram );
+    QCryptographicHash h( QCryptographicHash::Sha1 );
+    h.addData( outlineHash( diagram ) );
+    Udb::Obj sub = diagram.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        const Udb::OID oid = sub.getOid();
+        h.addData( reinterpret_cast<const char*>( &oid ), sizeof(oid) );
+        _latest( res, _modified( sub ) );
+        if( sub.getType() == DiagItem::TID )
+        {
+            // Aliasse: Text und Outline stammen aus anderen Diagrammen
+            const Udb::Obj orig = sub.getValueAsObj( DiagItem::AttrOrigObject );
+            if( !orig.isNull() )
+            {
+                _latest( res, _modified( orig ) );
+                const quint32 type = orig.getType();
+                if( type == Function::TID || type == Event::TID )
+                {
+                    _latest( res, outlineStamp( _resolved( orig ) ) );
+                    h.addData( outlineHash( _resolved( orig ) ) );
+                }
+                h.addData( d_withPage.contains( _resolved( orig ).getOid() ) ? "1" : "0", 1 );
+            }
+        }
+    }while( sub.next() );
+    if( !res.isValid() )
+        return QString();
+    return res.toString( s_stampFormat ) + QLatin1Char( '/' ) + QString::fromLatin1( h.result().toHex() );
+}
+
+QString HtmlSite::outlineFragment(const Udb::Obj & o)
+{
+    const QString key = QString( "o%1" ).arg( o.getOid() );
+    const QDateTime t = outlineStamp( o );
+    const QString stamp = ( t.isValid() ) ? t.toString( s_stampFormat ) + QLatin1Char( '/' ) +
+                                            QString::fromLatin1( outlineHash( o ).toHex() ) : QString();
+    const QString path = d_dir.filePath( QString( "%1/%2" ).arg( s_outlines ).arg( _pageName( o.getOid() ) ) );
+    QFile f( path );
+    if( d_oldStamps.value( key ) == stamp && !stamp.isEmpty() && f.open( QIODevice::ReadOnly ) )
+    {
+        d_newStamps[key] = stamp;
+        return QString::fromUtf8( f.readAll() );
+    }
+    QString html;
+    QTextStream out( &html );
+    Oln::OutlineToHtml writer;
+    writer.writeTo( out, o, QString(), true );
+    out.flush();
+    if( f.open( QIODevice::WriteOnly ) )
+    {
+        f.write( html.toUtf8() );
+        d_newStamps[key] = stamp;
+    }
+    return html;
+}
+
+bool HtmlSite::writePage(const Udb::Obj & diagram)
+{
+    const Udb::OID oid = diagram.getOid();
+    d_mdl->setDiagram( diagram );
+    const QRectF bound = d_mdl->itemsBoundingRect().adjusted(
+                -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
+                DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 );
+    const QString png = QString( "%1.png" ).arg( oid );
+    if( !d_mdl->exportPng( d_dir.filePath( png ) ) )
+    {
+        d_mdl->setDiagram( Udb::Obj() );
+        d_error = QObject::tr("Cannot write %1").arg( png );
+        return false;
+    }
+    d_mdl->setDiagram( Udb::Obj() );
+
+    QFile f( d_dir.filePath( _pageName( oid ) ) );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        d_error = QObject::tr("Cannot write %1").arg( f.fileName() );
+        return false;
+    }
+    QTextStream out( &f );
+    out.setCodec( "UTF-8" );
+    const QString title = Qt::escape( Procs::formatObjectTitle( diagram ) );
+    out << "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0//EN\" \"http://www.w3.org/TR/REC-html40/strict.dtd\">\n";
+    out << "<html><META http-equiv=\"Content-Type\" content=\"text/html; charset=UTF-8\">\n";
+    out << "<head><title>" << title << "</title>";
+    Oln::OutlineToHtml::writeCss( out );
+    out << "</head><body>\n";
+    out << "<p><a href=\"index.html\">" << QObject::tr("Index") << "</a></p>\n";
+    out << "<h2>" << title << "</h2>\n";
+    out << "<img usemap=\"#map1\" src=\"" << png << "\" >\n";
+    out << "<map name=\"map1\">\n";
+
+    // Image-Map direkt aus den DiagItems; jedes Objekt wird nur einmal auf Outline geprueft
+    QMap<Udb::OID,Udb::Obj> outlines;
+    if( hasOutline( diagram ) )
+        outlines[oid] = diagram;
+    Udb::Obj sub = diagram.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() != DiagItem::TID )
+            continue;
+        const DiagItem item = sub;
+        const Udb::Obj orig = item.getOrigObject();
+        if( orig.isNull( true ) )
+            continue;
+        const quint32 type = orig.getType();
+        qreal w = DiagItem::s_boxWidth;
+        qreal h = DiagItem::s_boxHeight;
+        if( type == Connector::TID )
+            w = h = DiagItem::s_circleDiameter;
+        else if( type != Function::TID && type != Event::TID )
+            continue;
+        const Udb::Obj o = _resolved( orig );
+        QString href;
+        if( d_withPage.contains( o.getOid() ) && o.getOid() != oid )
+            href = _pageName( o.getOid() );
+        else if( type != Connector::TID && ( outlines.contains( o.getOid() ) || hasOutline( o ) ) )
+        {
+            outlines[o.getOid()] = o;
+            href = QString( "#%1" ).arg( o.getOid() );
+        }
+        const QPointF pos = item.getPos() - bound.topLeft();
+        const QRect r = QRectF( pos.x() - w * 0.5, pos.y() - h * 0.5, w, h ).toRect();
+        out << "<area ";
+        if( !href.isEmpty() )
+            out << "href=\"" << href << "\"";
+        out << " shape=\"rect\" coords=\"";
+        out << QString("%1,%2,%3,%4").arg( r.left() ).arg( r.top() ).arg( r.right() ).arg( r.bottom() );
+        out << "\" title=\"" << Qt::escape( o.getString( Root::AttrText ) ) << "\" />\n";
+    }while( sub.next() );
+    out << "</map>\n";
+
+    QStringList& uses = d_newUses[ QString( "p%1" ).arg( oid ) ];
+    uses.clear();
+    QMap<Udb::OID,Udb::Obj>::const_iterator i;
+    for( i = outlines.begin(); i != outlines.end(); ++i )
+    {
+        out << "<a name=\"" << i.key() << "\"><h3>" <<
+               Qt::escape( Procs::formatObjectTitle( i.value() ) ) << "</h3></a>\n";
+        out << outlineFragment( i.value() );
+        uses.append( QString( "o%1" ).arg( i.key() ) );
+    }
+    out << "</body></html>";
+    return f.error() == QFile::NoError;
+}
+
+void HtmlSite::writeTree(QTextStream & out, const Udb::Obj & o)
+{
+    out << "<li>";
+    const QString title = Qt::escape( Procs::formatObjectTitle( o ) );
+    if( d_withPage.contains( o.getOid() ) )
+        out << "<a href=\"" << _pageName( o.getOid() ) << "\">" << title << "</a>";
+    else
+        out << title;
+    bool open = false;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        const quint32 type = sub.getType();
+        if( type == Function::TID || type == FuncDomain::TID )
+        {
+            if( !open )
+                out << "\n<ul>\n";
+            open = true;
+            writeTree( out, sub );
+        }
+    }while( sub.next() );
+    if( open )
+        out << "</ul>\n";
+    out << "</li>\n";
+}
+
+bool HtmlSite::writeIndex(const Udb::Obj & root)
+{
+    QFile f( d_dir.filePath( "index.html" ) );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        d_error = QObject::tr("Cannot write %1").arg( f.fileName() );
+        return false;
+    }
+    QTextStream out( &f );
+    out.setCodec( "UTF-8" );
+    const QString title = Qt::escape( Procs::formatObjectTitle( root ) );
+    out << "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.0//EN\" \"http://www.w3.org/TR/REC-html40/strict.dtd\">\n";
+    out << "<html><META http-equiv=\"Content-Type\" content=\"text/html; charset=UTF-8\">\n";
+    out << "<head><title>" << title << "</title></head><body>\n";
+    out << "<ul>\n";
+    writeTree( out, root );
+    out << "</ul>\n</body></html>";
+    return f.error() == QFile::NoError;
+}
+
+void HtmlSite::loadManifest()
+{
+    d_oldStamps.clear();
+    d_oldUses.clear();
+    QFile f( d_dir.filePath( s_manifest ) );
+    if( !f.open( QIODevice::ReadOnly ) )
+        return;
+    QTextStream in( &f );
+    in.setCodec( "UTF-8" );
+    while( !in.atEnd() )
+    {
+        // <key> TAB <stamp> [ TAB <fragment>,... ]; Fragmente nur bei Seiten
+        const QStringList l = in.readLine().split( QLatin1Char( '\t' ) );
+        if( l.size() >= 2 )
+            d_oldStamps[ l[0] ] = l[1];
+        if( l.size() == 3 )
+            d_oldUses[ l[0] ] = l[2].split( QLatin1Char( ',' ), QString::SkipEmptyParts );
+    }
+}
+
+bool HtmlSite::saveManifest()
+{
+    QFile f( d_dir.filePath( s_manifest ) );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        d_error = QObject::tr("Cannot write %1").arg( f.fileName() );
+        return false;
+    }
+    QTextStream out( &f );
+    out.setCodec( "UTF-8" );
+    QMap<QString,QString>::const_iterator i;
+    for( i = d_newStamps.begin(); i != d_newStamps.end(); ++i )
+    {
+        out << i.key() << '\t' << i.value();
+        if( d_newUses.contains( i.key() ) )
+            out << '\t' << d_newUses.value( i.key() ).join( QLatin1String( "," ) );
+        out << '\n';
+    }
+    return true;
+}
+
+int HtmlSite::publish(const Udb::Obj & root, const QString & path)
+{
+    d_error.clear();
+    d_skipped = 0;
+    d_dir = QDir( path );
+    if( root.isNull() || !d_dir.mkpath( s_outlines ) )
+    {
+        d_error = QObject::tr("Cannot create directory %1").arg( path );
+        return -1;
+    }
+    d_diagrams.clear();
+    d_withPage.clear();
+    d_newStamps.clear();
+    d_newUses.clear();
+    d_outlineStamps.clear();
+    d_outlineHashes.clear();
+    loadManifest();
+    collect( root );
+
+    int written = 0;
+    bool canceled = false;
+    foreach( const Udb::Obj& diagram, d_diagrams )
+    {
+        if( !progress( diagram ) )
+        {
+            canceled = true;
+            break;
+        }
+        const QString key = QString( "p%1" ).arg( diagram.getOid() );
+        const QString stamp = pageStamp( diagram );
+        if( !stamp.isEmpty() && d_oldStamps.value( key ) == stamp &&
+                d_dir.exists( _pageName( diagram.getOid() ) ) )
+        {
+            d_newStamps[key] = stamp;
+            d_newUses[key] = d_oldUses.value( key );
+            d_skipped++;
+            continue;
+        }
+        if( !writePage( diagram ) )
+            return -1;
+        d_newStamps[key] = stamp;
+        written++;
+    }
+    QMap<QString,QString>::const_iterator i;
+    // Fragmente, die eine uebersprungene Seite laut Manifest verwendet, bleiben erhalten
+    QSet<QString> used;
+    QMap<QString,QStringList>::const_iterator u;
+    for( u = d_newUses.begin(); u != d_newUses.end(); ++u )
+        foreach( const QString& frag, u.value() )
+            used.insert( frag );
+    for( i = d_oldStamps.begin(); i != d_oldStamps.end(); ++i )
+        if( used.contains( i.key() ) && !d_newStamps.contains( i.key() ) )
+            d_newStamps[i.key()] = i.value();
+    if( canceled )
+    {
+        // Was nicht besucht wurde, bleibt wie es war
+        for( i = d_oldStamps.begin(); i != d_oldStamps.end(); ++i )
+        {
+            if( !d_newStamps.contains( i.key() ) )
+            {
+                d_newStamps[i.key()] = i.value();
+                if( d_oldUses.contains( i.key() ) )
+                    d_newUses[i.key()] = d_oldUses.value( i.key() );
+            }
+        }
+    }else
+    {
+        // Seiten und Fragmente, die nicht mehr vorkommen, entfernen
+        for( i = d_oldStamps.begin(); i != d_oldStamps.end(); ++i )
+        {
+            if( d_newStamps.contains( i.key() ) )
+                continue;
+            const Udb::OID oid = i.key().mid( 1 ).toULongLong();
+            if( i.key().startsWith( QLatin1Char( 'p' ) ) )
+            {
+                d_dir.remove( _pageName( oid ) );
+                d_dir.remove( QString( "%1.png" ).arg( oid ) );
+            }else
+                d_dir.remove( QString( "%1/%2" ).arg( s_outlines ).arg( _pageName( oid ) ) );
+        }
+    }
+    if( !writeIndex( root ) || !saveManifest() )
+        return -1;
+    d_outlineStamps.clear();
+    d_outlineHashes.clear();
+    return written;
+}
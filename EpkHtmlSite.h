@@ -0,0 +1,81 @@
+#ifndef EPKHTMLSITE_H
+#define EPKHTMLSITE_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QDateTime>
+#include <QDir>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <Udb/Obj.h>
+
+class QTextStream;
+
+namespace Epk
+{
+    class EpkItemMdl;
+
+    class HtmlSite
+    {
+        // Veroeffentlicht einen Teilbaum aus FuncDomains und Functions als statische HTML-Site:
+        // index.html mit dem Baum, pro Diagramm <oid>.html mit Image-Map und <oid>.png als eigene Datei.
+        // Die Outlines werden als Fragmente in outlines/<oid>.html gecacht. In site.manifest steht pro
+        // Seite und Fragment der juengste AttrModifiedOn aller Objekte, die darin vorkommen (bei Seiten
+        // ergaenzt um einen Hash der Kinder und Link-Ziele), und pro Seite die verwendeten Fragmente.
+        // Nur Seiten und Fragmente mit geaendertem Stempel werden neu erzeugt; Seiten geloeschter
+        // Diagramme und von keiner Seite mehr verwendete Fragmente werden entfernt.
+    public:
+        HtmlSite();
+        virtual ~HtmlSite();
+        // Gibt die Anzahl neu geschriebener Seiten zurueck oder -1
+        int publish( const Udb::Obj& root, const QString& dir );
+        int getSkipped() const { return d_skipped; }
+        const QString& getError() const { return d_error; }
+    protected:
+        virtual bool progress( const Udb::Obj& diagram ) { Q_UNUSED(diagram); return true; } // false..Abbruch
+    private:
+        void collect( const Udb::Obj& );
+        QDateTime outlineStamp( const Udb::Obj& );
+        QByteArray outlineHash( const Udb::Obj& );
+        QString pageStamp( const Udb::Obj& );
+        QString outlineFragment( const Udb::Obj& );
+        bool hasOutline( const Udb::Obj& );
+        bool writePage( const Udb::Obj& diagram );
+        bool writeIndex( const Udb::Obj& root );
+        void writeTree( QTextStream&, const Udb::Obj& );
+        void loadManifest();
+        bool saveManifest();
+        EpkItemMdl* d_mdl;
+        QDir d_dir;
+        QList<Udb::Obj> d_diagrams;
+        QSet<Udb::OID> d_withPage;
+        QMap<QString,QString> d_oldStamps; // "p<oid>" bzw. "o<oid>" aus dem Manifest
+        QMap<QString,QString> d_newStamps;
+        QMap<QString,QStringList> d_oldUses; // Seite -> verwendete Fragmente, aus dem Manifest
+        QMap<QString,QStringList> d_newUses;
+        QMap<Udb::OID,QDateTime> d_outlineStamps; // nur waehrend publish
+        QMap<Udb::OID,QByteArray> d_outlineHashes; // dito
+        QString d_error;
+        int d_skipped;
+    };
+}
+
+#endif // EPKHTMLSITE_H
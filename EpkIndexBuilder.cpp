@@ -0,0 +1,254 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkIndexBuilder.h"
+#include "EpkObjects.h"
+#include "EpkSnapshot.h"
+#include <Udb/Database.h>
+#include <Udb/DatabaseException.h>
+#include <Udb/Idx.h>
+#include <QtConcurrentRun>
+#include <QApplication>
+#include <QEvent>
+#include <QtDebug>
+using namespace Epk;
+
+const int IndexBuilder::s_idleMs = 5000;
+
+static bool _indexed( Udb::Idx& idx, const Udb::Obj& o, quint32 attr )
+{
+    // Steht o unter seinem aktuellen Wert im Index?
+    if( idx.seek( o.getValue( attr ) ) ) do
+    {
+        if( idx.getOid() == o.getOid() )
+            return true;
+    }while( idx.nextKey() );
+    return false;
+}
+
+static void _countMissing( Udb::Idx& idx, const Udb::Obj& o, quint32 attr, IndexBuilder::Check& res )
+{
+    if( o.getValue( attr ).hasValue() )
+    {
+        res.d_objects++;
+        if( !_indexed( idx, o, attr ) )
+            res.d_missing++;
+    }
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        _countMissing( idx, sub, attr, res );
+    }while( sub.next() );
+}
+
+static const int s_snapRetries = 3;
+
+static IndexBuilder::Check _verifyOnce( Udb::Database* db, const QByteArray& name, quint32 attr,
+                                        const QList<Udb::OID>& roots, bool& stale )
+{
+    // Laeuft im Worker auf einem eigenen Snapshot; es wird nur gelesen
+    IndexBuilder::Check res;
+    res.d_name = name;
+    stale = false;
+    try
+    {
+        Snapshot snap( db );
+        if( !snap.isOpen() )
+        {
+            qWarning() << "IndexBuilder::verify" << name << snap.getError();
+            res.d_stale = -1;
+            return res;
+        }
+        // Jeder Eintrag: Objekt vorhanden, Attribut gesetzt und unter seinem Wert eingetragen
+        Udb::Idx idx( snap.getTxn(), name );
+        Udb::Idx probe( snap.getTxn(), name );
+        if( idx.first() ) do
+        {
+            res.d_entries++;
+            const Udb::Obj o = snap.getObject( idx.getOid() );
+            if( o.isNull( true ) || !o.getValue( attr ).hasValue() )
+                res.d_stale++;
+            else if( !_indexed( probe, o, attr ) )
+                res.d_mismatch++;
+        }while( idx.next() );
+        // Umgekehrt: jedes Objekt mit Wert steht im Index. Udb kann nicht ueber alle Objekte iterieren;
+        // durchsucht werden die Baeume unter den Wurzeln, in denen FlowLine Objekte anlegt.
+        foreach( Udb::OID oid, roots )
+        {
+            const Udb::Obj root = snap.getObject( oid );
+            if( !root.isNull( true ) )
+                _countMissing( probe, root, attr, res );
+        }
+        stale = snap.isStale();
+    }catch( Udb::DatabaseException& e )
+    {
+        qWarning() << "IndexBuilder::verify" << name << e.getCodeString() << e.getMsg();
+        res.d_stale = -1;
+    }
+    return res;
+}
+
+static IndexBuilder::Check _verify( Udb::Database* db, QByteArray name, quint32 attr, QList<Udb::OID> roots )
+{
+    // Wurde waehrend der Pruefung committet, sind die Zahlen nicht aus einem Guss; dann wiederholen
+    IndexBuilder::Check res;
+    bool stale = true;
+    for( int i = 0; i < s_snapRetries && stale; i++ )
+        res = _verifyOnce( db, name, attr, roots, stale );
+    res.d_inconsistent = stale;
+    return res;
+}
+
+IndexBuilder::IndexBuilder(Udb::Database * db):QObject(db),d_db(db),d_done(0),d_total(0),d_running(false),
+    d_whenIdle(false)
+{
+    Q_ASSERT( db != 0 );
+    d_timer.setSingleShot( true );
+    connect( &d_timer, SIGNAL(timeout()), this, SLOT(onBuildNext()) );
+}
+
+IndexBuilder *IndexBuilder::find(Udb::Database * db)
+{
+    if( db == 0 )
+        return 0;
+    return db->findChild<IndexBuilder*>();
+}
+
+void IndexBuilder::start(bool whenIdle)
+{
+    if( d_running )
+    {
+        if( d_whenIdle && !whenIdle )
+        {
+            // Der Benutzer will nicht mehr warten
+            qApp->removeEventFilter( this );
+            d_whenIdle = false;
+            next();
+        }
+        return;
+    }
+    d_done = 0;
+    d_total = Index::getPending( d_db ).size();
+    if( d_total == 0 )
+    {
+        emit signalDone();
+        return;
+    }
+    d_running = true;
+    d_whenIdle = whenIdle;
+    if( d_whenIdle )
+    {
+        d_lastInput.start();
+        qApp->installEventFilter( this );
+    }
+    next();
+}
+
+void IndexBuilder::stop()
+{
+    d_timer.stop();
+    if( d_whenIdle )
+        qApp->removeEventFilter( this );
+    d_whenIdle = false;
+    d_running = false;
+}
+
+void IndexBuilder::next()
+{
+    const QList<QByteArray> pending = Index::getPending( d_db );
+    d_current = ( pending.isEmpty() ) ? QByteArray() : pending.first();
+    if( d_whenIdle )
+        // Erst bauen, wenn seit s_idleMs keine Eingabe mehr kam
+        d_timer.start( qMax( 0, s_idleMs - d_lastInput.elapsed() ) );
+    else
+    {
+        emit signalProgress( d_current, d_done, d_total );
+        // Ein Index pro Durchgang der Event-Loop, dazwischen bleibt die GUI bedienbar
+        d_timer.start( 0 );
+    }
+}
+
+bool IndexBuilder::eventFilter(QObject * o, QEvent * e)
+{
+    switch( e->type() )
+    {
+    case QEvent::KeyPress:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+        d_lastInput.restart();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter( o, e );
+}
+
+void IndexBuilder::onBuildNext()
+{
+    if( d_whenIdle )
+    {
+        if( d_lastInput.elapsed() < s_idleMs )
+        {
+            next(); // seither wieder Eingaben; weiter warten
+            return;
+        }
+        emit signalProgress( d_current, d_done, d_total );
+    }
+    // Im GUI-Thread, damit createIndex nie parallel zu einem Commit der GUI-Transaction laeuft
+    bool more = false;
+    try
+    {
+        more = Index::buildNext( d_db );
+    }catch( Udb::DatabaseException& e )
+    {
+        qWarning() << "IndexBuilder:" << e.getCodeString() << e.getMsg();
+    }
+    if( more )
+    {
+        d_done++;
+        next();
+        return;
+    }
+    stop();
+    // Bei einem Fehler bleiben die restlichen Indizes vorgemerkt; Index::ensure baut sie dann bei Bedarf
+    emit signalProgress( QString(), d_total, d_total );
+    emit signalDone();
+}
+
+QList<IndexBuilder::Check> IndexBuilder::verify(const QList<Udb::OID> & roots)
+{
+    const QList<QByteArray> pending = Index::getPending( d_db );
+    QList<QFuture<Check> > jobs;
+    QList<Check> res;
+    foreach( const Index::Def& d, Index::getDefs() )
+    {
+        if( pending.contains( d.first ) )
+        {
+            Check c;
+            c.d_name = d.first;
+            c.d_pending = true;
+            res.append( c );
+        }else
+            jobs.append( QtConcurrent::run( _verify, d_db, QByteArray( d.first ), d.second, roots ) );
+    }
+    for( int i = 0; i < jobs.size(); i++ )
+        res.append( jobs[i].result() );
+    return res;
+}
@@ -0,0 +1,91 @@
+#ifndef EPKINDEXBUILDER_H
+#define EPKINDEXBUILDER_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QTime>
+#include <QTimer>
+#include <Udb/Obj.h>
+
+namespace Udb
+{
+    class Database;
+}
+
+namespace Epk
+{
+    class IndexBuilder : public QObject
+    {
+        // Baut die bei Index::init( db, true ) vorgemerkten Indizes nacheinander im GUI-Thread, einen pro
+        // Durchgang der Event-Loop; Abfragen davor bauen ihren Index ueber Index::ensure selber.
+        // createIndex darf nicht parallel zu einem Commit der GUI-Transaction laufen und blockiert die GUI,
+        // solange ein Index gebaut wird. start( true ) baut deshalb erst, wenn der Benutzer seit s_idleMs
+        // nichts mehr eingegeben hat, und prueft das vor jedem weiteren Index erneut; start( false ) baut
+        // sofort alle (auf Verlangen des Benutzers).
+        // verify() prueft alle fertigen Indizes parallel gegen die Daten (je ein Snapshot pro Thread).
+        Q_OBJECT
+    public:
+        struct Check
+        {
+            QByteArray d_name;
+            int d_entries;
+            int d_stale; // Eintrag zeigt auf geloeschtes Objekt oder Attribut ohne Wert
+            int d_mismatch; // Eintrag steht nicht unter dem aktuellen Wert des Objekts
+            int d_objects; // Objekte mit Wert im Attribut
+            int d_missing; // davon nicht im Index
+            bool d_pending;
+            bool d_inconsistent; // auch nach Wiederholung wurde waehrend der Pruefung committet
+            Check():d_entries(0),d_stale(0),d_mismatch(0),d_objects(0),d_missing(0),
+                d_pending(false),d_inconsistent(false){}
+        };
+
+        static const int s_idleMs;
+
+        IndexBuilder( Udb::Database* ); // Child der Datenbank
+        void start( bool whenIdle );
+        bool isRunning() const { return d_running; }
+        bool isWaiting() const { return d_running && d_whenIdle; }
+        // roots: Wurzeln der Baeume, in denen nach nicht indizierten Objekten gesucht wird; fehlende werden
+        // uebersprungen. Blockiert, bis alle Pruefungen fertig sind.
+        QList<Check> verify( const QList<Udb::OID>& roots );
+        static IndexBuilder* find( Udb::Database* );
+    signals:
+        void signalProgress( const QString& index, int done, int total );
+        void signalDone();
+    protected slots:
+        void onBuildNext();
+    protected:
+        bool eventFilter( QObject*, QEvent* );
+    private:
+        void next();
+        void stop();
+        Udb::Database* d_db;
+        QByteArray d_current;
+        QTimer d_timer;
+        QTime d_lastInput;
+        int d_done;
+        int d_total;
+        bool d_running;
+        bool d_whenIdle;
+    };
+}
+
+#endif // EPKINDEXBUILDER_H
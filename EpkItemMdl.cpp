@@ -21,6 +21,8 @@
 #include "EpkProcs.h"
 #include "EpkObjects.h"
 #include "EpkItems.h"
+#include "EpkTiles.h"
+#include "EpkSvgWriter.h"
 #include <QGraphicsRectItem>
 #include <QGraphicsSceneMouseEvent>
 #include <QDesktopWidget>
@@ -29,11 +31,13 @@
 #include <QClipboard>
 #include <QPainter>
 #include <QPrinter>
-#include <QSvgGenerator>
 #include <QTextDocument>
+#include <QAbstractTextDocumentLayout>
 #include <QTextStream>
 #include <QFile>
 #include <QMenu>
+#include <QGraphicsSceneHelpEvent>
+#include <QToolTip>
 #include <QtDebug>
 #include <Udb/Database.h>
 #include <Udb/Idx.h>
@@ -48,11 +52,13 @@ const char* EpkItemMdl::s_mimeEvent = "application/flowline/event-ref";
 
 EpkItemMdl::EpkItemMdl( QObject* p ):
     QGraphicsScene(p),d_mode(Idle),d_tempLine(0),d_tempBox(0),d_lastHitItem(0),
-	d_readOnly(false),d_toEnlarge(false),d_strictSyntax(false),d_commitLock(false)
+	d_readOnly(false),d_toEnlarge(false),d_strictSyntax(false),d_commitLock(false),
+	d_index( s_cellWidth, s_cellHeight )
 {
     QDesktopWidget dw;
     setSceneRect( dw.screenGeometry() );
-	// setItemIndexMethod( QGraphicsScene::NoIndex ); // braucht es das?
+	// Hit-Testing und Selektion laufen ueber d_index; der BSP von Qt bleibt fuer das Zeichnen,
+	// da drawItems die sichtbaren Items ueber items(exposedRect) sucht.
 }
 
 void EpkItemMdl::fetchAttributes( EpkNode* i, const Udb::Obj& orig ) const
@@ -61,9 +67,9 @@ void EpkItemMdl::fetchAttributes( EpkNode* i, const Udb::Obj& orig ) const
         return;
     Q_ASSERT( orig.getType() != DiagItem::TID || orig.getValue(DiagItem::AttrKind).getUInt8() != 0 );
     // Hier wird das Original erwartet
-    i->setText( orig.getValue( Root::AttrText ).toString() );
-    i->setId( Procs::formatObjectId( orig ) );
-    i->setToolTip( Procs::formatObjectTitle( orig ) );
+    i->setText( intern( orig.getValue( Root::AttrText ).toString() ) );
+    i->setId( intern( Procs::formatObjectId( orig ) ) );
+    // Tooltip wird nicht mehr pro Item gespeichert, sondern in helpEvent aus der DB geholt
     switch( i->type() )
     {
     case EpkNode::_Function:
@@ -94,10 +100,7 @@ void EpkItemMdl::fetchItemFromDb( const Udb::Obj& obj, bool links, bool vertices
     Q_ASSERT( diagItem.getType() == DiagItem::TID );
     const Udb::Obj orig = diagItem.getValueAsObj( DiagItem::AttrOrigObject );
     if( orig.isNull( true ) )
-    {
-        d_orphans.append( obj );
-        return; // Orphan
-    }
+        return; // Orphan; wird von OrphanSweeper aufgeraeumt
     const quint32 type = orig.getType();
     const quint8 kind = diagItem.getKind();
     if( ( type == Function::TID || type == Event::TID || type == Connector::TID ||
@@ -128,6 +131,7 @@ void EpkItemMdl::fetchItemFromDb( const Udb::Obj& obj, bool links, bool vertices
         i->setPos( diagItem.getPos() );
         addItem( i ); // muss vor fetch stehen, da sonst scene nicht verfgbar
         fetchAttributes( i, orig );
+        d_index.update( i );
         d_cache[diagItem.getOid()] = i;
         d_cache[orig.getOid()] = i;
     }
@@ -151,14 +155,13 @@ void EpkItemMdl::fetchItemFromDb( const Udb::Obj& obj, bool links, bool vertices
                 EpkNode* n = new EpkNode(0,0,EpkNode::_Handle);
                 n->setPos( nl[j] );
                 addItem( n );
-                LineSegment* s = addSegment( start, n );
-                s->setToolTip( Procs::formatObjectTitle( orig ) );
+                d_index.update( n );
+                addSegment( start, n );
                 start = n;
             }
-            LineSegment* lastSegment = addSegment( start, end, diagItem );
-            lastSegment->setToolTip( Procs::formatObjectTitle( orig ) );
-        }else
-            d_orphans.append( obj ); // Der Link existiert zwar, aber nicht auf diesem Diagramm
+            addSegment( start, end, diagItem );
+        }
+        // else: Der Link existiert zwar, aber nicht auf diesem Diagramm; siehe OrphanSweeper
     }
     if( links )
 		installPin( diagItem );
@@ -169,7 +172,7 @@ void EpkItemMdl::setShowId( bool on )
     if( !d_doc.isNull() && !d_readOnly )
     {
         d_doc.setValue( Function::AttrShowIds, Stream::DataCell().setBool( on ) );
-        d_doc.commit();
+        Procs::deferCommit( d_doc.getTxn() );
     }
 }
 
@@ -200,7 +203,7 @@ void EpkItemMdl::setMarkAlias(bool on)
     if( !d_doc.isNull() && !d_readOnly )
     {
         d_doc.setValue( Function::AttrMarkAlias, Stream::DataCell().setBool( on ) );
-        d_doc.commit();
+        Procs::deferCommit( d_doc.getTxn() );
     }
 }
 
@@ -212,32 +215,28 @@ void EpkItemMdl::setDiagram( const Udb::Obj& doc )
         d_doc.getDb()->removeObserver( this, SLOT( onDbUpdate( Udb::UpdateInfo ) ) );
     clear();
     d_cache.clear();
+    d_index.clear();
+    d_strings.clear();
     d_doc = doc;
     if( !d_doc.isNull() )
     {
-        // Erzeuge zuerst die EpkItems ohne Handle und Segments
+        // Erzeuge zuerst die EpkItems ohne Handle und Segments. Die DiagItems werden dabei gemerkt, damit
+        // der zweite Durchgang (auch beim Aufwecken eines Tabs) nicht nochmals alle Subobjekte durchsucht.
+        QList<Udb::Obj> pdmItems;
         Udb::Obj pdmItem = d_doc.getFirstObj();
         if( !pdmItem.isNull() ) do
         {
             if( pdmItem.getType() == DiagItem::TID )
+            {
                 fetchItemFromDb( pdmItem, false, true );
+                pdmItems.append( pdmItem );
+            }
         }while( pdmItem.next() );
 
         // Erzeuge nun die Handle und Segments
-        pdmItem = d_doc.getFirstObj();
-        if( !pdmItem.isNull() ) do
-        {
-            if( pdmItem.getType() == DiagItem::TID )
-                fetchItemFromDb( pdmItem, true, false );
-        }while( pdmItem.next() );
+        foreach( const Udb::Obj& o, pdmItems )
+            fetchItemFromDb( o, true, false );
 
-        if( !d_orphans.isEmpty() )
-        {
-            foreach( Udb::Obj o, d_orphans )
-				Procs::erase( o );
-            d_orphans.clear();
-            d_doc.commit();
-        }
         d_doc.getDb()->addObserver( this, SLOT( onDbUpdate( Udb::UpdateInfo ) ), false ); // neu synchron
 
         fitSceneRect();
@@ -336,9 +335,8 @@ void EpkItemMdl::mousePressEvent(QGraphicsSceneMouseEvent * e)
         Q_ASSERT( d_tempLine != 0 );
         Q_ASSERT( d_lastHitItem != 0 );
         Q_ASSERT( d_startItem != 0 );
-        QList<QGraphicsItem *> endItems = items( d_tempLine->line().p2() );
-        if( endItems.count() && endItems.first() == d_tempLine )
-            endItems.removeFirst();
+        // d_tempLine ist nicht im Index
+        QList<QGraphicsItem *> endItems = d_index.items( d_tempLine->line().p2() );
 
         EpkNode* to = 0;
         if( !endItems.isEmpty() )
@@ -418,7 +416,7 @@ void EpkItemMdl::mousePressEvent(QGraphicsSceneMouseEvent * e)
     }else
     {
         Q_ASSERT( d_mode == Idle );
-        QGraphicsItem* i = itemAt( d_startPos );
+        QGraphicsItem* i = d_index.itemAt( d_startPos );
         if( i == 0 )
         {
             QGraphicsScene::mousePressEvent(e);
@@ -591,7 +589,7 @@ void EpkItemMdl::mouseReleaseEvent(QGraphicsSceneMouseEvent * e)
             }
         }
         if( !d_doc.isNull() )
-            d_doc.commit();
+            Procs::deferCommit( d_doc.getTxn() );
 		d_commitLock = false;
         enlargeSceneRect();
         d_mode = Idle;
@@ -603,7 +601,7 @@ void EpkItemMdl::mouseReleaseEvent(QGraphicsSceneMouseEvent * e)
             {
                 DiagItem o = d_doc.getObject( ni->getOrigOid() );
                 o.setSize( ni->getSize() );
-                o.commit();
+                Procs::deferCommit( o.getTxn() );
             }
         }
         d_lastHitItem = 0;
@@ -665,6 +663,7 @@ EpkNode* EpkItemMdl::addHandle()
     EpkNode* i = new EpkNode(0,0,EpkNode::_Handle);
     i->setPos( rastered( d_startPos ) );
     addItem( i );
+    d_index.update( i );
     return i;
 }
 
@@ -707,6 +706,103 @@ void EpkItemMdl::removeFromCache(QGraphicsItem * i)
 	}
 }
 
+QString EpkItemMdl::intern(const QString & str) const
+{
+    // Gleiche Texte und Ids (v.a. bei Aliassen und Standardtexten) teilen sich dieselben Daten.
+    // Der Pool wird bei setDiagram geleert und sonst kompaktiert, wenn Umbenennungen ihn wachsen lassen.
+    if( str.isEmpty() )
+        return QString();
+    QSet<QString>::const_iterator i = d_strings.find( str );
+    if( i != d_strings.end() )
+        return *i;
+    if( d_strings.size() > 2 * d_cache.size() + 256 )
+        compactStrings();
+    d_strings.insert( str );
+    return str;
+}
+
+void EpkItemMdl::compactStrings() const
+{
+    // Nur behalten, was noch ein Node benuetzt; d_cache enthaelt jeden Node mindestens einmal
+    QSet<QString> used;
+    foreach( QGraphicsItem* i, d_cache )
+    {
+        if( EpkNode* n = dynamic_cast<EpkNode*>( i ) )
+        {
+            if( !n->getText().isEmpty() )
+                used.insert( n->getText() );
+            if( !n->getId().isEmpty() )
+                used.insert( n->getId() );
+        }
+    }
+    d_strings = used;
+}
+
+qint64 EpkItemMdl::estimateMemoryUsage(int *nodes, int *segments) const
+{
+    // Grobe Schaetzung; der private Teil von QGraphicsItem ist nicht zugaenglich
+    static const int s_itemOverhead = 200; // RISK
+    static const int s_stringOverhead = 24;
+    static const int s_hashNode = 24;
+    qint64 res = 0;
+    int n = 0, s = 0;
+    QSet<const QChar*> strings;
+    foreach( QGraphicsItem* i, items() )
+    {
+        if( i->type() == EpkNode::_Flow )
+        {
+            s++;
+            res += sizeof(LineSegment) + s_itemOverhead + 3 * sizeof(QPointF);
+        }else if( EpkNode* node = dynamic_cast<EpkNode*>( i ) )
+        {
+            n++;
+            res += sizeof(EpkNode) + s_itemOverhead + node->getLinks().size() * sizeof(void*);
+            const QString text = node->getText();
+            const QString id = node->getId();
+            if( !text.isEmpty() && !strings.contains( text.constData() ) )
+            {
+                strings.insert( text.constData() );
+                res += s_stringOverhead + text.size() * sizeof(QChar);
+            }
+            if( !id.isEmpty() && !strings.contains( id.constData() ) )
+            {
+                strings.insert( id.constData() );
+                res += s_stringOverhead + id.size() * sizeof(QChar);
+            }
+        }
+    }
+    res += d_cache.size() * s_hashNode;
+    res += d_strings.size() * s_hashNode;
+    res += d_index.memoryUsage();
+    if( nodes )
+        *nodes = n;
+    if( segments )
+        *segments = s;
+    return res;
+}
+
+void EpkItemMdl::helpEvent(QGraphicsSceneHelpEvent *e)
+{
+    quint32 oid = 0;
+    QGraphicsItem* i = d_index.itemAt( e->scenePos() );
+    if( EpkNode* n = dynamic_cast<EpkNode*>( i ) )
+        oid = n->getOrigOid();
+    else if( LineSegment* ls = dynamic_cast<LineSegment*>( i ) )
+        oid = ls->getLastSegment()->getOrigOid(); // nur das letzte Segment kennt die Oid
+    QString tip;
+    if( oid != 0 && !d_doc.isNull() )
+        tip = Procs::formatObjectTitle( d_doc.getObject( oid ) );
+    if( tip.isEmpty() )
+    {
+        QToolTip::hideText();
+        e->ignore();
+    }else
+    {
+        QToolTip::showText( e->screenPos(), tip, e->widget() );
+        e->accept();
+    }
+}
+
 void EpkItemMdl::movePinned(const QList<EpkNode *> &l, const QPointF &diff)
 {
 	foreach( EpkNode* p, l )
@@ -742,7 +838,7 @@ void EpkItemMdl::movePinned(const QList<EpkNode *> &l, const QPointF &diff)
 		}
 	}
 	if( !d_commitLock )
-		d_doc.commit();
+		Procs::deferCommit( d_doc.getTxn() );
 }
 
 void EpkItemMdl::rasteredMoveBy( EpkNode* i, qreal dx, qreal dy )
@@ -994,11 +1090,7 @@ void EpkItemMdl::onDbUpdate( Udb::UpdateInfo info )
                 fetchAttributes( pi, o );
                 pi->update();
             }else if( ls && ls->getOrigOid() == info.d_id )
-            {
-                Udb::Obj o = d_doc.getObject( info.d_id );
-                ls->setToolTip( Procs::formatObjectTitle( o ) );
                 ls->update();
-            }
         }else if( info.d_name == Function::AttrElemCount )
         {
             EpkNode* pi = dynamic_cast<EpkNode*>( d_cache.value( info.d_id ) );
@@ -1192,6 +1284,67 @@ void EpkItemMdl::selectObjects(const QList<Udb::Obj> &obs, bool clearSel)
     }
 }
 
+static inline bool _isSelectable( const QGraphicsItem* i )
+{
+    return ( i->flags() & QGraphicsItem::ItemIsSelectable ) && i->isVisible();
+}
+
+void EpkItemMdl::selectItemsIn( const QRectF& r, bool clearSel )
+{
+    // Ersetzt setSelectionArea( path, Qt::ContainsItemShape ); dieses prueft die Shape jedes Items gegen
+    // einen QPainterPath. Hier zuerst nur Bounding-Box-Abfrage ueber den Index; wer vollstaendig in r liegt,
+    // ist ohne weitere Pruefung drin. Die Shape wird nur noch bei den Items am Rand betrachtet.
+    const QList<QGraphicsItem*> hits = d_index.items( r, Qt::IntersectsItemBoundingRect );
+    QPainterPath area;
+    area.addRect( r );
+    QSet<QGraphicsItem*> toSelect;
+    foreach( QGraphicsItem* i, hits )
+    {
+        if( !_isSelectable( i ) )
+            continue;
+        if( r.contains( i->sceneBoundingRect() ) )
+            toSelect.insert( i );
+        else if( area.contains( i->mapToScene( i->shape() ) ) )
+            toSelect.insert( i ); // Shape kann kleiner sein als BoundingRect
+    }
+    // QGraphicsScene meldet sonst selectionChanged fuer jedes einzelne Item
+    const bool old = blockSignals( true );
+    bool changed = false;
+    if( clearSel )
+    {
+        foreach( QGraphicsItem* i, selectedItems() )
+            if( !toSelect.contains( i ) )
+            {
+                i->setSelected( false );
+                changed = true;
+            }
+    }
+    foreach( QGraphicsItem* i, toSelect )
+        if( !i->isSelected() )
+        {
+            i->setSelected( true );
+            changed = true;
+        }
+    blockSignals( old );
+    if( changed )
+        emit selectionChanged();
+}
+
+void EpkItemMdl::selectAllItems()
+{
+    const bool old = blockSignals( true );
+    bool changed = false;
+    foreach( QGraphicsItem* i, items() )
+        if( _isSelectable( i ) && !i->isSelected() )
+        {
+            i->setSelected( true );
+            changed = true;
+        }
+    blockSignals( old );
+    if( changed )
+        emit selectionChanged();
+}
+
 void EpkItemMdl::removeSelectedItems()
 {
     // NOTE: Diese Methode ist eine Ausnahme, da ich keine Lust habe, Internas der PdmItems nach PdmCtrl
@@ -1259,7 +1412,7 @@ bool EpkItemMdl::canStartLink() const
         return false;
     if( d_mode == Idle )
     {
-        QGraphicsItem* i = itemAt( d_startPos );
+        QGraphicsItem* i = d_index.itemAt( d_startPos );
         if( i != 0 )
         {
             EpkNode* ei = dynamic_cast<EpkNode*>( i );
@@ -1276,7 +1429,7 @@ void EpkItemMdl::startLink()
         return;
     if( d_mode == Idle )
     {
-        QGraphicsItem* i = itemAt( d_startPos );
+        QGraphicsItem* i = d_index.itemAt( d_startPos );
         if( i != 0 )
         {
             if( !i->isSelected() )
@@ -1308,22 +1461,47 @@ QPointF EpkItemMdl::getStart(bool rastered) const
 }
 
 
-void EpkItemMdl::exportPng( const QString& path )
+bool EpkItemMdl::exportPng( const QString& path )
 {
     clearSelection();
     QBrush back = backgroundBrush();
     setBackgroundBrush( Qt::white );
     QRectF b = itemsBoundingRect().adjusted( -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
         DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 );
-    QImage img( b.size().toSize(), QImage::Format_RGB32 );
-    QPainter painter( &img );
-    painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing );
-    render( &painter, QRectF( QPointF(0.0,0.0), b.size() ), b );
+    bool res = true;
     if( !path.isEmpty() )
-        img.save( path, "PNG" );
-    else
+    {
+        // Datei wird bandweise geschrieben; kein Image in Diagrammgroesse
+        TiledRenderer r( this, b );
+        res = r.writePng( path );
+        if( !res )
+            qWarning() << "EpkItemMdl::exportPng:" << r.getError();
+    }else
+    {
+        QImage img( b.size().toSize(), QImage::Format_RGB32 );
+        QPainter painter( &img );
+        painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing );
+        render( &painter, QRectF( QPointF(0.0,0.0), b.size() ), b );
+        painter.end();
         QApplication::clipboard()->setImage( img );
+    }
+    setBackgroundBrush( back );
+    return res;
+}
+
+int EpkItemMdl::exportTiles( const QString& dir )
+{
+    clearSelection();
+    QBrush back = backgroundBrush();
+    setBackgroundBrush( Qt::white );
+    QRectF b = itemsBoundingRect().adjusted( -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
+        DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 );
+    TiledRenderer r( this, b );
+    const int res = r.writePyramid( dir );
+    if( res < 0 )
+        qWarning() << "EpkItemMdl::exportTiles:" << r.getError();
     setBackgroundBrush( back );
+    return res;
 }
 
 static inline bool _hasOutline( const Udb::Obj& o, bool followAlias = false )
@@ -1344,22 +1522,129 @@ static inline bool _hasOutline( const Udb::Obj& o, bool followAlias = false )
     return false;
 }
 
-void EpkItemMdl::exportPdf( const QString& path, bool withDetails )
+static inline int _pageCount( qreal len, qreal page, qreal overlap )
+{
+    if( len <= page )
+        return 1;
+    return int( ::ceil( ( len - overlap ) / ( page - overlap ) ) );
+}
+
+static void _drawMarks( QPainter& p, const QRectF& page, qreal ov, int x, int y, int nx, int ny )
+{
+    // Gestrichelte Linien markieren den Bereich, der auf der Nachbarseite wiederholt wird
+    p.save();
+    p.setPen( QPen( Qt::gray, 0, Qt::DashLine ) );
+    if( x > 0 )
+        p.drawLine( QPointF( ov, 0 ), QPointF( ov, page.height() ) );
+    if( x < nx - 1 )
+        p.drawLine( QPointF( page.width() - ov, 0 ), QPointF( page.width() - ov, page.height() ) );
+    if( y > 0 )
+        p.drawLine( QPointF( 0, ov ), QPointF( page.width(), ov ) );
+    if( y < ny - 1 )
+        p.drawLine( QPointF( 0, page.height() - ov ), QPointF( page.width(), page.height() - ov ) );
+    QFont f = p.font();
+    f.setPointSize( 7 );
+    p.setFont( f );
+    p.setPen( Qt::gray );
+    p.drawText( QRectF( QPointF( 0, 0 ), page.size() ), Qt::AlignRight | Qt::AlignBottom,
+                QString( "%1/%2" ).arg( QChar( 'A' + y % 26 ) ).arg( x + 1 ) );
+    p.restore();
+}
+
+bool EpkItemMdl::exportPdf( const QString& path, bool withDetails, qreal scale )
 {
     clearSelection();
-    QBrush back = backgroundBrush();
-    setBackgroundBrush( Qt::white );
     QRectF b = itemsBoundingRect().adjusted( -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
         DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 );
-    QPrinter prn(QPrinter::PrinterResolution);
+    QPrinter prn(QPrinter::HighResolution);
     prn.setPaperSize(QPrinter::A4);
-    if( b.width() > b.height() )
-        prn.setOrientation( QPrinter::Landscape );
     prn.setOutputFormat( QPrinter::PdfFormat );
     prn.setOutputFileName( path );
-    QPainter painter( &prn );
-    render( &painter, QRectF(), b );
+
+    const qreal f = prn.resolution() / 72.0 * scale; // Szene -> Device
+    const qreal ov = prn.resolution() / 25.4 * 10.0; // 10 mm Ueberlappung
+    // Orientierung mit weniger Seiten waehlen
+    prn.setOrientation( QPrinter::Portrait );
+    QRectF page = prn.pageRect();
+    const int portrait = _pageCount( b.width() * f, page.width(), ov ) *
+                         _pageCount( b.height() * f, page.height(), ov );
+    prn.setOrientation( QPrinter::Landscape );
+    page = prn.pageRect();
+    const int landscape = _pageCount( b.width() * f, page.width(), ov ) *
+                          _pageCount( b.height() * f, page.height(), ov );
+    if( portrait < landscape )
+    {
+        prn.setOrientation( QPrinter::Portrait );
+        page = prn.pageRect();
+    }
+    const int nx = _pageCount( b.width() * f, page.width(), ov );
+    const int ny = _pageCount( b.height() * f, page.height(), ov );
+    const qreal stepX = ( page.width() - ov ) / f;
+    const qreal stepY = ( page.height() - ov ) / f;
+
+    QPainter painter;
+    if( !painter.begin( &prn ) )
+        return false;
+    QBrush back = backgroundBrush();
+    setBackgroundBrush( Qt::white );
+    painter.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing );
+    // Die PDF-Engine schreibt jede Seite bei newPage weg; es wird nie mehr als eine Seite gehalten
+    for( int y = 0; y < ny; y++ )
+    {
+        for( int x = 0; x < nx; x++ )
+        {
+            if( x > 0 || y > 0 )
+                prn.newPage();
+            const QRectF source( b.left() + x * stepX, b.top() + y * stepY, page.width() / f, page.height() / f );
+            render( &painter, QRectF( QPointF( 0, 0 ), page.size() ), source, Qt::IgnoreAspectRatio );
+            if( nx * ny > 1 )
+                _drawMarks( painter, page, ov, x, y, nx, ny );
+        }
+    }
     setBackgroundBrush( back );
+
+    if( withDetails && !d_doc.isNull() )
+    {
+        QMap<quint64,Udb::Obj> order;
+        order.insert( d_doc.getOid(), d_doc );
+        Udb::Obj sub = d_doc.getFirstObj();
+        if( !sub.isNull() ) do
+        {
+            const quint32 type = sub.getType();
+            if( type == Event::TID || type == Function::TID )
+                order[sub.getOid()] = sub;
+        }while( sub.next() );
+        QMap<quint64,Udb::Obj>::const_iterator i;
+        for( i = order.begin(); i != order.end(); ++i )
+        {
+            if( !_hasOutline( i.value() ) )
+                continue;
+            // Pro Outline ein eigenes Dokument, damit nicht alle gleichzeitig im Speicher sind
+            QString html;
+            QTextStream out( &html );
+            out << "<html><head>";
+            Oln::OutlineToHtml::writeCss(out);
+            out << "</head><body>";
+            out << "<h3>" << Qt::escape( Procs::formatObjectTitle( i.value(), isShowId() ) ) << "</h3>\n";
+            Oln::OutlineToHtml writer;
+            writer.writeTo( out, i.value(), QString(), true );
+            out << "</body></html>";
+            out.flush();
+            QTextDocument doc;
+            doc.documentLayout()->setPaintDevice( &prn );
+            doc.setHtml( html );
+            doc.setPageSize( page.size() );
+            for( int p = 0; p < doc.pageCount(); p++ )
+            {
+                prn.newPage();
+                painter.save();
+                painter.translate( 0, -p * page.height() );
+                doc.drawContents( &painter, QRectF( 0, p * page.height(), page.width(), page.height() ) );
+                painter.restore();
+            }
+        }
+    }
+    return painter.end();
 }
 
 static QString _coded( QString str )
@@ -1384,6 +1669,10 @@ void EpkItemMdl::exportHtml( const QString& path, bool withPng )
         QHash<quint32,QGraphicsItem*>::const_iterator i;
         for( i = d_cache.begin(); i != d_cache.end(); ++i )
         {
+            // d_cache enthaelt jeden Node zweimal, unter DiagItem und unter OrigObject
+            EpkNode* n = dynamic_cast<EpkNode*>( i.value() );
+            if( n == 0 || n->getOrigOid() != i.key() )
+                continue;
             if( _hasOutline( d_doc.getObject( i.key() ), true ) )
             {
                 i.value()->setSelected( true );
@@ -1434,6 +1723,9 @@ void EpkItemMdl::exportHtml( const QString& path, bool withPng )
         QHash<quint32,QGraphicsItem*>::const_iterator i;
         for( i = d_cache.begin(); i != d_cache.end(); ++i )
         {
+            EpkNode* n = dynamic_cast<EpkNode*>( i.value() );
+            if( n == 0 || n->getOrigOid() != i.key() )
+                continue;
             if( i.value()->type() == EpkNode::_Function ||
                     i.value()->type() == EpkNode::_Event ||
                     i.value()->type() == EpkNode::_Connector )
@@ -1472,17 +1764,14 @@ void EpkItemMdl::exportHtml( const QString& path, bool withPng )
 	out << "</body></html>";
 }
 
-void EpkItemMdl::exportSvg(const QString &path )
+bool EpkItemMdl::exportSvg(const QString &path )
 {
-    clearSelection();
-    QBrush back = backgroundBrush();
-    setBackgroundBrush( Qt::white );
-    QRectF b = itemsBoundingRect().adjusted( -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
-        DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 );
-    QSvgGenerator prn;
-    prn.setFileName( path );
-    QPainter painter( &prn );
-    render( &painter, QRectF(), b );
-    setBackgroundBrush( back );
+    QFile f( path );
+    if( !f.open( QIODevice::WriteOnly ) )
+        return false;
+    EpkSvgWriter w( d_chartFont );
+    w.setShowId( isShowId() );
+    w.setMarkAlias( isMarkAlias() );
+    return w.write( &f, d_doc );
 }
 
@@ -22,7 +22,9 @@
 
 #include <QGraphicsScene>
 #include <QHash>
+#include <QSet>
 #include <Udb/Obj.h>
+#include "EpkSpatialIndex.h"
 
 namespace Epk
 {
@@ -49,6 +51,8 @@ namespace Epk
             bool link = true, bool handle = true) const; // Gibt alle selektiereten PdmItem (!) zurck
         QGraphicsItem* selectObject( const Udb::Obj&, bool clearSel = true ); // funktioniert mit PdmItem und OrigObject
         void selectObjects( const QList<Udb::Obj>& obs, bool clearSel = true ); // dito
+        void selectItemsIn( const QRectF&, bool clearSel = true ); // wie setSelectionArea mit ContainsItemShape
+        void selectAllItems();
         void removeSelectedItems(); // Wirkt nur auf PdmItems
         bool isShowId() const;
         void setShowId( bool on );
@@ -56,6 +60,7 @@ namespace Epk
         void setMarkAlias( bool on );
         void setReadOnly( bool on ) { d_readOnly = on; }
         bool isReadOnly() const { return d_doc.isNull() || d_readOnly; }
+        bool isIdle() const { return d_mode == Idle; }
         bool contains( quint32 oid ) const { return d_cache.contains( oid ); }
         void enlargeSceneRect();
         void fitSceneRect(bool forceFit = false);
@@ -70,13 +75,24 @@ namespace Epk
         void setChartFont( const QFont& f ) { d_chartFont = f; update(); }
         const QFont& getChartFont() const { return d_chartFont; }
 
-        void exportPng( const QString& path );
-        void exportPdf( const QString& path, bool withDetails = false );
+        bool exportPng( const QString& path ); // leerer Pfad..Clipboard
+        int exportTiles( const QString& dir ); // Kachel-Pyramide; Anzahl Zoom-Stufen oder -1
+        // Poster ueber mehrere A4-Seiten mit Ueberlappung; scale 1.0 entspricht 1 Punkt pro Einheit.
+        // withDetails haengt die Outlines der Functions und Events an.
+        bool exportPdf( const QString& path, bool withDetails = false, qreal scale = 1.0 );
         void exportHtml( const QString& path, bool withPng = true );
-        void exportSvg( const QString& path );
+        bool exportSvg( const QString& path );
 
         static QPointF rastered( const QPointF& );
         void removeFromCache( QGraphicsItem* ); // Implementationsdetail
+        void updateIndex( QGraphicsItem* i ) { d_index.update( i ); } // dito
+        void removeFromIndex( QGraphicsItem* i ) { d_index.remove( i ); } // dito
+        // Hit-Testing ueber eigenen Index statt BSP der QGraphicsScene
+        QGraphicsItem* hitItem( const QPointF& p ) const { return d_index.itemAt( p ); }
+        QList<QGraphicsItem*> hitItems( const QPointF& p ) const { return d_index.items( p ); }
+        int indexedCount() const { return d_index.count(); }
+        QString intern( const QString& ) const; // gemeinsame Instanz fuer gleiche Texte und Ids
+        qint64 estimateMemoryUsage( int* nodes = 0, int* segments = 0 ) const; // Bytes, grob
 		void movePinned( const QList<EpkNode*>&, const QPointF& diff );
     signals:
         void signalCreateSuccLink( const Udb::Obj& pred, int type, const QPointF& pos, const QPolygonF& path );
@@ -106,11 +122,13 @@ namespace Epk
         void dragEnterEvent ( QGraphicsSceneDragDropEvent * event );
         void dragLeaveEvent ( QGraphicsSceneDragDropEvent * event );
         void dragMoveEvent ( QGraphicsSceneDragDropEvent * event );
+        void helpEvent( QGraphicsSceneHelpEvent * event );
         void drawItems(QPainter *painter, int numItems, QGraphicsItem *items[],
                        const QStyleOptionGraphicsItem options[], QWidget *widget);
     protected slots:
         void onDbUpdate( Udb::UpdateInfo );
     private:
+        void compactStrings() const; // nur aus intern(); d_strings ist ein Cache, daher const
         QPointF d_startPos;
         QPointF d_lastPos;
         Mode d_mode;
@@ -120,7 +138,8 @@ namespace Epk
         QGraphicsPathItem* d_tempBox;
         Udb::Obj d_doc;
         QHash<quint32,QGraphicsItem*> d_cache; // oid->Item, sowohl PdmItem als auch OrigObject!
-        QList<Udb::Obj> d_orphans;
+        SpatialIndex d_index; // alle EpkNodes und LineSegments, ohne temporaere Items
+        mutable QSet<QString> d_strings; // siehe intern()
         QFont d_chartFont;
         bool d_readOnly;
         bool d_toEnlarge;
@@ -34,6 +34,12 @@ static inline EpkItemMdl* _mdl( const QGraphicsItem* i )
     return mdl;
 }
 
+static inline void _updateIndex( QGraphicsItem* i )
+{
+    if( EpkItemMdl* mdl = dynamic_cast<EpkItemMdl*>( i->scene() ) )
+        mdl->updateIndex( i );
+}
+
 static inline bool _showId( const QGraphicsItem* i )
 {
     EpkItemMdl* m = _mdl( i );
@@ -47,8 +53,8 @@ static inline bool _markAlias( const QGraphicsItem* i )
 }
 
 EpkNode::EpkNode(quint32 item, quint32 orig, int type):
-    d_itemOid(item),d_origOid(orig),d_alias(false),d_isProcess(false),d_type(type),
-	d_code(0),d_size( DiagItem::s_boxWidth, DiagItem::s_boxHeight ),d_pinnedTo(0)
+    d_itemOid(item),d_origOid(orig),d_kind(type - UserType),d_alias(false),d_isProcess(false),
+	d_code(0),d_width( DiagItem::s_boxWidth ),d_height( DiagItem::s_boxHeight ),d_pinnedTo(0)
 {
     setFlags(ItemIsSelectable );
     if( type == _Frame )
@@ -65,10 +71,11 @@ EpkNode::~EpkNode()
         if( s->d_end == this )
             s->d_end = 0;
     }
-    if( d_itemOid || d_origOid )
+    EpkItemMdl* mdl = dynamic_cast<EpkItemMdl*>( scene() );
+    if( mdl )
     {
-        EpkItemMdl* mdl = dynamic_cast<EpkItemMdl*>( scene() );
-        if( mdl )
+        mdl->removeFromIndex( this );
+        if( d_itemOid || d_origOid )
             mdl->removeFromCache( this );
     }
 }
@@ -76,7 +83,8 @@ EpkNode::~EpkNode()
 void EpkNode::setType(int type)
 {
     prepareGeometryChange();
-    d_type = type;
+    d_kind = type - UserType;
+    _updateIndex( this );
 }
 
 void EpkNode::setWidth(qreal w)
@@ -86,8 +94,9 @@ void EpkNode::setWidth(qreal w)
     const qreal minw = DiagItem::s_boxWidth * 0.25;
     if( w < minw )
         w = minw;
-    d_size.setWidth( w );
+    d_width = w;
     updateNoteHeight();
+    _updateIndex( this );
     update();
 }
 
@@ -95,25 +104,23 @@ void EpkNode::updateNoteHeight()
 {
     QFontMetricsF fm( _mdl(this)->getChartFont() );
     const QString text = (!d_text.isEmpty())?d_text:QString("Empty");
-    const QRectF textBound = fm.boundingRect( QRectF( 0, 0, d_size.width() - 2.0 * DiagItem::s_textMargin,
+    const QRectF textBound = fm.boundingRect( QRectF( 0, 0, d_width - 2.0 * DiagItem::s_textMargin,
            DiagItem::s_boxHeight ), Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, text );
     const qreal h = textBound.height() + 2 * DiagItem::s_textMargin;
-    if( d_size.height() != h )
+    if( d_height != h )
         prepareGeometryChange();
-    d_size.setHeight( h );
+    d_height = h;
 }
 
 void EpkNode::setSize(const QSizeF & s)
 {
     update();
     prepareGeometryChange();
-    d_size = s;
     const qreal minw = DiagItem::s_boxWidth * 0.25;
     const qreal minh = DiagItem::s_boxHeight * 0.25;
-    if( d_size.width() < minw )
-        d_size.setWidth( minw );
-    if( d_size.height() < minh )
-        d_size.setHeight( minh );
+    d_width = qMax( s.width(), minw );
+    d_height = qMax( s.height(), minh );
+    _updateIndex( this );
     update();
 }
 
@@ -156,7 +163,7 @@ QRectF EpkNode::boundingRect() const
 QPolygonF EpkNode::toPolygon() const
 {
     // Bei allen Formen ausser Note/Frame ist der Nullpunkt in der Mitte der Form
-    switch( d_type )
+    switch( type() )
     {
     case _Event:
         {
@@ -189,7 +196,7 @@ QPolygonF EpkNode::toPolygon() const
         {
             // Bei Frame und Note ist Nullpunkt links oben
 			//const qreal pwh = DiagItem::s_penWidth / 2.0;
-            return QRectF( 0, 0, d_size.width(), d_size.height() );
+            return QRectF( 0, 0, d_width, d_height );
         }
     default:
         return QRectF( - DiagItem::s_boxWidth / 2.0, - DiagItem::s_boxHeight / 2.0,
@@ -201,9 +208,9 @@ void EpkNode::adjustSize(qreal dx, qreal dy)
 {
     Q_UNUSED(dy);
     if( type() == _Note )
-        setWidth( d_size.width() + dx );
+        setWidth( d_width + dx );
     else if( type() == _Frame )
-        setSize( QSizeF( d_size.width() + dx, d_size.height() + dy ) );
+        setSize( QSizeF( d_width + dx, d_height + dy ) );
 }
 
 QPainterPath EpkNode::shape () const
@@ -219,7 +226,7 @@ QPainterPath EpkNode::shape () const
 
 void EpkNode::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-    switch( d_type )
+    switch( type() )
     {
     case _Function:
         paintFunction( painter, option, widget );
@@ -240,7 +247,7 @@ void EpkNode::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, Q
         paintFrame( painter, option, widget );
         break;
     default:
-        qWarning( "Don't know how to paint DiagItem type=%d", d_type );
+        qWarning( "Don't know how to paint DiagItem type=%d", type() );
     }
 }
 
@@ -261,7 +268,10 @@ void EpkNode::setText(const QString &t)
 {
     d_text = t;
     if( type() == _Note )
+    {
         updateNoteHeight();
+        _updateIndex( this );
+    }
 }
 
 void EpkNode::addLine(LineSegment *arrow, bool start)
@@ -299,6 +309,7 @@ QVariant EpkNode::itemChange(GraphicsItemChange change, const QVariant &value)
 	switch( change )
 	{
 	case QGraphicsItem::ItemPositionHasChanged:
+		_updateIndex( this );
 		foreach( LineSegment *arrow, d_links )
 			arrow->updatePosition();
 		break;
@@ -522,7 +533,7 @@ void EpkNode::paintNote(QPainter *painter, const QStyleOptionGraphicsItem *, QWi
         painter->setPen( Qt::NoPen );
     painter->setBrush( QColor( 240, 240, 240 ) );
 
-    const QRectF rect( QPointF(0,0),d_size );
+    const QRectF rect( 0, 0, d_width, d_height );
 
 //	if( isSelected() && d_pinnedTo )
 //		painter->drawLine( rect.center(), mapFromItem( d_pinnedTo, QPointF(0,0) ) );
@@ -543,7 +554,7 @@ void EpkNode::paintFrame(QPainter *painter, const QStyleOptionGraphicsItem *opti
         painter->setPen( QPen( Qt::gray, DiagItem::s_penWidth ) );
     painter->setBrush( QColor( 250, 250, 250 ) );
 
-    QRectF r( 0, 0, d_size.width(), d_size.height() );
+    QRectF r( 0, 0, d_width, d_height );
     painter->drawRoundedRect( r, DiagItem::s_radius, DiagItem::s_radius );
     painter->setPen( Qt::black );
     QFont f = _mdl( this )->getChartFont();
@@ -579,10 +590,11 @@ LineSegment::~LineSegment()
     if( d_end )
         d_end->removeLine( this );
     Q_ASSERT( d_end == 0 );
-    if( d_itemOid || d_origOid )
+    EpkItemMdl* mdl = dynamic_cast<EpkItemMdl*>( scene() );
+    if( mdl )
     {
-        EpkItemMdl* mdl = dynamic_cast<EpkItemMdl*>( scene() );
-        if( mdl )
+        mdl->removeFromIndex( this );
+        if( d_itemOid || d_origOid )
             mdl->removeFromCache( this );
     }
 }
@@ -603,6 +615,7 @@ void LineSegment::updatePosition()
 {
 	QLineF line( mapFromItem(d_start, 0, 0), mapFromItem(d_end, 0, 0) );
     setLine(line);
+    _updateIndex( this );
 }
 
 void LineSegment::paint(QPainter *painter, const QStyleOptionGraphicsItem *,QWidget *)
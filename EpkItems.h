@@ -47,7 +47,7 @@ namespace Epk
         void setWidth( qreal w ); // fr Note
         void updateNoteHeight();
         void setSize( const QSizeF& ); // fr Frame
-        const QSizeF& getSize() const { return d_size; }
+        QSizeF getSize() const { return QSizeF( d_width, d_height ); }
         EpkNode* parentNode() const { return dynamic_cast<EpkNode*>(parentItem() ); }
 
         // Interface fr Model
@@ -73,7 +73,7 @@ namespace Epk
         virtual QPainterPath shape () const;
         virtual void paint ( QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget = 0 );
         virtual void adjustSize( qreal dx, qreal dy );
-        virtual int type () const { return d_type; }
+        virtual int type () const { return UserType + d_kind; }
     protected:
         void paintEvent( QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget = 0 );
         void paintFunction( QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget = 0 );
@@ -91,14 +91,15 @@ namespace Epk
 		QList<EpkNode*> d_pinneds;
         quint32 d_itemOid; // DiagItem
         quint32 d_origOid; // OrigObject
-        QString d_text;
-        QString d_id;  // von OrigObject
-        int d_type;
+        QString d_text; // via EpkItemMdl::intern geteilt
+        QString d_id;  // von OrigObject, dito
+        float d_width; // fr Note (width) und Frame (width, height)
+        float d_height;
         // Text stammt ebenfalls von OrigObject
-        bool d_alias; // true: OrigObject.getParent() != PdmItem.getParent()
-        bool d_isProcess;
-        quint8 d_code; // Types
-        QSizeF d_size; // fr Note (width) und Frame (width, height)
+        quint16 d_kind : 4; // Type - UserType
+        quint16 d_alias : 1; // true: OrigObject.getParent() != PdmItem.getParent()
+        quint16 d_isProcess : 1;
+        quint16 d_code : 8; // Types
     };
 
     class LineSegment : public QGraphicsLineItem
@@ -105,11 +105,13 @@ void EpkLinkViewCtrl::setObj(const Udb::Obj & o)
     if( o.isNull() )
         return;
 
+    Index::ensure( o.getTxn(), Index::Succ );
     Udb::Idx succIdx( o.getTxn(), Index::Succ );
     if( succIdx.seek( Stream::DataCell().setOid( o.getOid() ) ) ) do
     {
         addLink( o.getObject( succIdx.getOid() ), true );
     }while( succIdx.nextKey() );
+    Index::ensure( o.getTxn(), Index::Pred );
     Udb::Idx predIdx( o.getTxn(), Index::Pred );
     if( predIdx.seek( Stream::DataCell().setOid( o.getOid() ) ) ) do
     {
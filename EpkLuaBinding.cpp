@@ -80,6 +80,7 @@ struct _Node
 	{
 		Node* f = CoBin<Node>::check( L, 1 );
 		QList<Udb::Obj> links;
+		Epk::Index::ensure( f->getTxn(), Epk::Index::Pred );
 		Udb::Idx idx( f->getTxn(), Epk::Index::Pred );
 		if( idx.seek( Stream::DataCell().setOid( f->getOid() ) ) ) do
 		{
@@ -100,6 +101,7 @@ struct _Node
 	{
 		Node* f = CoBin<Node>::check( L, 1 );
 		QList<Udb::Obj> links;
+		Epk::Index::ensure( f->getTxn(), Epk::Index::Succ );
 		Udb::Idx idx( f->getTxn(), Epk::Index::Succ );
 		if( idx.seek( Stream::DataCell().setOid( f->getOid() ) ) ) do
 		{
@@ -220,6 +222,7 @@ struct _Function
 	{
 		Function* obj = CoBin<Function>::check( L, 1 );
 		QList<Udb::Obj> allocs;
+		Epk::Index::ensure( obj->getTxn(), Epk::Index::Func );
 		Udb::Idx idx( obj->getTxn(), Epk::Index::Func );
 		if( idx.seek( Stream::DataCell().setOid( obj->getOid() ) ) ) do
 		{
@@ -331,6 +334,10 @@ struct _Repository
 	static int rollback(lua_State *L)
 	{
 		_Repository* obj = Lua::ValueBinding<_Repository>::check( L, 1 );
+		// Vorgemerkte Aenderungen des Benutzers (z.B. zwischen zwei Zeilen im Terminal) zuerst committen,
+		// sonst verwirft sie das rollback stillschweigend. Ist ein Commit vorgemerkt, geht dabei auch
+		// Uncommittetes des Skripts mit; beides liegt in derselben Transaction.
+		Epk::Procs::flushCommits( obj->d_txn );
 		obj->d_txn->rollback();
 		return 0;
 	}
@@ -459,6 +466,7 @@ static int _getAllocs(lua_State *L)
 {
 	SystemElement* obj = CoBin<SystemElement>::check( L, 1 );
 	QList<Udb::Obj> allocs;
+	Epk::Index::ensure( obj->getTxn(), Epk::Index::Elem );
 	Udb::Idx idx( obj->getTxn(), Epk::Index::Elem );
 	if( idx.seek( Stream::DataCell().setOid( obj->getOid() ) ) ) do
 	{
@@ -19,11 +19,13 @@
 
 #include "EpkObjects.h"
 #include "EpkProcs.h"
+#include "EpkItemMdl.h"
 #include <Oln2/OutlineItem.h>
 #include <Udb/Database.h>
 #include <Udb/Transaction.h>
 #include <Udb/Idx.h>
 #include <QSet>
+#include <QMutex>
 using namespace Epk;
 using namespace Stream;
 
@@ -36,6 +38,7 @@ int FuncDomain::TID = 305;
 int Diagram::TID = 306;
 int Allocation::TID = 307;
 int SystemElement::TID = 308;
+int Tombstone::TID = 309;
 
 const float DiagItem::s_penWidth = 1.0;
 const float DiagItem::s_selPenWidth = 3.0;
@@ -77,10 +80,10 @@ void DiagItem::setNodeList(const QPolygonF & p)
     setModifiedOn();
 }
 
-QPolygonF DiagItem::getNodeList() const
+static QPolygonF _getNodeList( const Stream::DataCell& v )
 {
     QPolygonF res;
-    Stream::DataReader r( getValue( AttrNodeList ) );
+    Stream::DataReader r( v );
     Stream::DataReader::Token t = r.nextToken();
     while( t == Stream::DataReader::BeginFrame )
     {
@@ -104,6 +107,11 @@ QPolygonF DiagItem::getNodeList() const
     return res;
 }
 
+QPolygonF DiagItem::getNodeList() const
+{
+    return _getNodeList( getValue( AttrNodeList ) );
+}
+
 bool DiagItem::hasNodeList() const
 {
     return hasValue( AttrNodeList );
@@ -136,6 +144,7 @@ QList<DiagItem> DiagItem::getPinneds() const
 	QList<DiagItem> res;
 	if( isNull() )
 		return res;
+	Index::ensure( getTxn(), Index::PinnedTo );
 	Udb::Idx idx( getTxn(), Index::PinnedTo );
 	if( idx.seek( *this ) ) do
 	{
@@ -190,6 +199,7 @@ DiagItem DiagItem::create(Udb::Obj diagram, Udb::Obj orig, const QPointF &p)
     Q_ASSERT( !diagram.isNull() );
     DiagItem item = diagram.createAggregate( TID );
     item.setCreatedOn();
+    item.getUuid(); // fuer EpkDelta
     item.setOrigObject( orig );
     if( !p.isNull() )
         item.setPos( p );
@@ -201,6 +211,7 @@ DiagItem DiagItem::createKind(Udb::Obj diagram, Kind k, const QPointF &p)
     Q_ASSERT( !diagram.isNull() );
     DiagItem item = diagram.createAggregate( TID );
     item.setCreatedOn();
+    item.getUuid(); // fuer EpkDelta
     item.setValue(AttrKind, DataCell().setUInt8(k) );
     if( k == Note )
         item.setValue( AttrWidth, DataCell().setFloat( s_boxWidth ) );
@@ -228,98 +239,175 @@ DiagItem DiagItem::createLink(Udb::Obj diagram, Udb::Obj pred, const Udb::Obj &s
 QList<Udb::Obj> DiagItem::writeItems(const QList<Udb::Obj> &items, DataWriter & out1)
 {
     out1.writeSlot( Stream::DataCell().setUuid( items.first().getDb()->getDbUuid() ) );
-    // Wir mssen das Format auf die lokale DB beschrnken, da es Referenzen auf Objekte gibt
-	// Gehe zweimal durch, dass sicher die Funktionen/Events zuerst kopiert werden
+    // Wir muessen das Format auf die lokale DB beschraenken, da es Referenzen auf Objekte gibt
+    // Ein Durchgang; Links werden zurueckgestellt, damit beim Paste die Funktionen/Events zuerst kommen.
+    // Die OIDs stehen einmal in der Tabelle 'oids'; Items und Links verweisen mit Index darauf.
     QList<Udb::Obj> origs;
-    foreach( Udb::Obj o, items )
+    QList<Udb::Obj> links;
+    out1.startFrame( Stream::NameTag( "oids" ) );
+    foreach( const Udb::Obj& o, items )
     {
-        if( o.getValueAsObj(AttrOrigObject).getType() != ConFlow::TID )
+        const Udb::Obj orig = o.getValueAsObj( AttrOrigObject );
+        if( orig.getType() == ConFlow::TID )
+            links.append( o );
+        else if( o.getValue( AttrKind ).getUInt8() == Plain )
         {
-            out1.startFrame( Stream::NameTag( "item" ) );
-            out1.writeSlot( o.getValue( AttrPosX ), Stream::NameTag("x") );
-            out1.writeSlot( o.getValue( AttrPosY ), Stream::NameTag("y") );
-            out1.writeSlot( o.getValue( AttrWidth ), Stream::NameTag("w") );
-            out1.writeSlot( o.getValue( AttrHeight ), Stream::NameTag("h") );
-            out1.writeSlot( o.getValue( AttrKind ), Stream::NameTag("k") );
-            out1.writeSlot( o.getValue( AttrText ), Stream::NameTag("txt") );
-            if( o.getValue( AttrKind ).getUInt8() == 0 )
-            {
-                // Nur bei den Plain DiagItems wird Orig gespeichert; bei den anderen zeigt Orig auf sich selbst.
-                Udb::Obj orig = o.getValueAsObj( AttrOrigObject );
-                out1.writeSlot( orig, Stream::NameTag("obj") );
-                origs.append( orig );
-            }
-            out1.endFrame();
+            // Nur bei den Plain DiagItems wird Orig gespeichert; bei den anderen zeigt Orig auf sich selbst.
+            out1.writeSlot( DataCell().setOid( orig.getOid() ) );
+            origs.append( orig );
         }
     }
-    foreach( Udb::Obj o, items )
+    foreach( const Udb::Obj& o, links )
+    {
+        const Udb::Obj orig = o.getValueAsObj( AttrOrigObject );
+        out1.writeSlot( DataCell().setOid( orig.getOid() ) );
+        origs.append( orig );
+    }
+    out1.endFrame();
+
+    quint32 index = 0;
+    foreach( const Udb::Obj& o, items )
     {
-        if( o.getValueAsObj(AttrOrigObject).getType() == ConFlow::TID )
+        if( o.getValueAsObj( AttrOrigObject ).getType() == ConFlow::TID )
+            continue;
+        out1.startFrame( Stream::NameTag( "item" ) );
+        out1.writeSlot( o.getValue( AttrPosX ), Stream::NameTag("x") );
+        out1.writeSlot( o.getValue( AttrPosY ), Stream::NameTag("y") );
+        const quint8 k = o.getValue( AttrKind ).getUInt8();
+        if( k == Plain )
+            out1.writeSlot( DataCell().setUInt32( index++ ), Stream::NameTag("o") );
+        else
         {
-            out1.startFrame( Stream::NameTag( "link" ) );
-            out1.writeSlot( o.getValue( AttrNodeList ), Stream::NameTag("path") );
-            Udb::Obj orig = o.getValueAsObj( AttrOrigObject );
-            out1.writeSlot( orig, Stream::NameTag("obj") );
-            out1.endFrame();
-            origs.append( orig );
+            out1.writeSlot( DataCell().setUInt8( k ), Stream::NameTag("k") );
+            DataCell v = o.getValue( AttrWidth );
+            if( v.hasValue() )
+                out1.writeSlot( v, Stream::NameTag("w") );
+            v = o.getValue( AttrHeight );
+            if( v.hasValue() )
+                out1.writeSlot( v, Stream::NameTag("h") );
+            v = o.getValue( AttrText );
+            if( v.hasValue() )
+                out1.writeSlot( v, Stream::NameTag("txt") );
         }
+        out1.endFrame();
+    }
+    foreach( const Udb::Obj& o, links )
+    {
+        out1.startFrame( Stream::NameTag( "link" ) );
+        const DataCell path = o.getValue( AttrNodeList );
+        if( path.hasValue() )
+            out1.writeSlot( path, Stream::NameTag("path") );
+        out1.writeSlot( DataCell().setUInt32( index++ ), Stream::NameTag("o") );
+        out1.endFrame();
     }
     return origs;
 }
 
-QList<Udb::Obj> DiagItem::readItems(Udb::Obj diagram, DataReader & r)
+struct _ClipItem
+{
+    Stream::DataCell d_x;
+    Stream::DataCell d_y;
+    Stream::DataCell d_w;
+    Stream::DataCell d_h;
+    Stream::DataCell d_txt;
+    Stream::DataCell d_path;
+    quint32 d_index;
+    quint8 d_kind;
+    _ClipItem():d_index(0xffffffff),d_kind(DiagItem::Plain){}
+};
+
+static bool _readClipItem( DataReader& r, _ClipItem& i )
+{
+    Stream::DataReader::Token t = r.nextToken();
+    while( t == Stream::DataReader::Slot )
+    {
+        const Stream::NameTag n = r.getName().getTag();
+        if( n.equals("x") )
+            i.d_x = r.getValue();
+        else if( n.equals("y") )
+            i.d_y = r.getValue();
+        else if( n.equals("w") )
+            i.d_w = r.getValue();
+        else if( n.equals("h") )
+            i.d_h = r.getValue();
+        else if( n.equals("txt") )
+            i.d_txt = r.getValue();
+        else if( n.equals("k") )
+            i.d_kind = r.getValue().getUInt8();
+        else if( n.equals("o") )
+            i.d_index = r.getValue().getUInt32();
+        else if( n.equals("path") )
+            i.d_path = r.getValue();
+        t = r.nextToken();
+    }
+    return t == Stream::DataReader::EndFrame;
+}
+
+QList<Udb::Obj> DiagItem::readItems(Udb::Obj diagram, DataReader & r, bool moveTo, const QPointF& to)
 {
     Q_ASSERT( !diagram.isNull() );
     QList<Udb::Obj> res;
     Stream::DataReader::Token t = r.nextToken();
     if( t != Stream::DataReader::Slot || r.getValue().getUuid() != diagram.getDb()->getDbUuid() )
-        return res; // Objekte leben in anderer Datenbank; kein Paste mglich.
-    QSet<Udb::OID> existingItems = Procs::findAllItemOrigOids( diagram );
+        return res; // Objekte leben in anderer Datenbank; kein Paste moeglich.
     t = r.nextToken();
-    QList<Udb::Obj> done;
-    while( t == Stream::DataReader::BeginFrame && r.getName().getTag().equals( "item" ) )
+    if( t != Stream::DataReader::BeginFrame || !r.getName().getTag().equals( "oids" ) )
+        return res;
+    QVector<Udb::OID> oids;
+    t = r.nextToken();
+    while( t == Stream::DataReader::Slot )
     {
-        Stream::DataCell x;
-        Stream::DataCell y;
-        Stream::DataCell w;
-        Stream::DataCell h;
-        Stream::DataCell txt;
-        DiagItem::Kind k;
-        Stream::DataCell obj;
+        oids.append( r.getValue().getOid() );
         t = r.nextToken();
-        while( t == Stream::DataReader::Slot )
+    }
+    // Zuerst alles lesen, damit die Items gleich an der Zielposition angelegt werden koennen
+    QList<_ClipItem> items;
+    QList<_ClipItem> links;
+    QRectF bound;
+    t = r.nextToken();
+    while( t == Stream::DataReader::BeginFrame )
+    {
+        const bool isLink = r.getName().getTag().equals( "link" );
+        _ClipItem i;
+        if( !_readClipItem( r, i ) )
+            return res;
+        if( isLink )
+            links.append( i );
+        else
         {
-            if( r.getName().getTag().equals("x") )
-                x = r.getValue();
-            else if( r.getName().getTag().equals("y") )
-                y = r.getValue();
-            else if( r.getName().getTag().equals("w") )
-                w = r.getValue();
-            else if( r.getName().getTag().equals("h") )
-                h = r.getValue();
-            else if( r.getName().getTag().equals("txt") )
-                txt = r.getValue();
-            else if( r.getName().getTag().equals("k") )
-                k = (DiagItem::Kind)r.getValue().getUInt8();
-            else if( r.getName().getTag().equals("obj") )
-                obj = r.getValue();
-            t = r.nextToken();
+            QRectF rect( i.d_x.getFloat(), i.d_y.getFloat(), s_boxWidth, s_boxHeight );
+            if( i.d_kind != Plain && i.d_w.hasValue() )
+                rect.setWidth( i.d_w.getFloat() );
+            if( i.d_kind != Plain && i.d_h.hasValue() )
+                rect.setHeight( i.d_h.getFloat() );
+            bound = bound.isNull() ? rect : bound.united( rect );
+            items.append( i );
         }
-        Q_ASSERT( t == Stream::DataReader::EndFrame );
-        Udb::Obj orig = diagram.getObject( obj.getOid() );
-        if( k != Plain || ( !orig.isNull() && !existingItems.contains( obj.getOid() ) ) )
+        t = r.nextToken();
+    }
+    // Nicht to.isNull() als Kennzeichen, denn (0,0) ist ein gueltiges Ziel
+    const QPointF off = ( moveTo ) ? to - bound.topLeft() : QPointF();
+
+    QSet<Udb::OID> existingItems = Procs::findAllItemOrigOids( diagram );
+    QList<Udb::Obj> done;
+    foreach( const _ClipItem& i, items )
+    {
+        const Udb::Obj orig = diagram.getObject( oids.value( i.d_index ) );
+        if( i.d_kind != Plain || ( !orig.isNull() && !existingItems.contains( orig.getOid() ) ) )
         {
-            // Lege nur Diagrammelemente fr Objekte an, die im Diagramm noch nicht vorhanden sind,
-            // oder aber fr Notes
-            DiagItem current = create( diagram, orig );
-            current.setValue( AttrPosX, x );
-            current.setValue( AttrPosY, y );
-            if( k != Plain )
+            // Lege nur Diagrammelemente fuer Objekte an, die im Diagramm noch nicht vorhanden sind,
+            // oder aber fuer Notes
+            DiagItem current = create( diagram, orig,
+                EpkItemMdl::rastered( QPointF( i.d_x.getFloat(), i.d_y.getFloat() ) + off ) );
+            if( i.d_kind != Plain )
             {
-                current.setValue( AttrWidth, w );
-                current.setValue( AttrHeight, h );
-                current.setValue( AttrText, txt );
-                current.setValue( AttrKind, DataCell().setUInt8(k) );
+                if( i.d_w.hasValue() )
+                    current.setValue( AttrWidth, i.d_w );
+                if( i.d_h.hasValue() )
+                    current.setValue( AttrHeight, i.d_h );
+                if( i.d_txt.hasValue() )
+                    current.setValue( AttrText, i.d_txt );
+                current.setValue( AttrKind, DataCell().setUInt8( i.d_kind ) );
                 current.setValueAsObj( AttrOrigObject, current );
             }else
             {
@@ -328,37 +416,29 @@ QList<Udb::Obj> DiagItem::readItems(Udb::Obj diagram, DataReader & r)
             }
             res.append( current );
         }
-        t = r.nextToken();
     }
-    while( t == Stream::DataReader::BeginFrame && r.getName().getTag().equals( "link" ) )
+    foreach( const _ClipItem& i, links )
     {
-        Stream::DataCell path;
-        Stream::DataCell obj;
-        t = r.nextToken();
-        while( t == Stream::DataReader::Slot )
-        {
-            if( r.getName().getTag().equals("path") )
-                path = r.getValue();
-            else if( r.getName().getTag().equals("obj") )
-                obj = r.getValue();
-            t = r.nextToken();
-        }
-        Q_ASSERT( t == Stream::DataReader::EndFrame );
-        Udb::Obj link = diagram.getObject( obj.getOid() );
+        const Udb::Obj link = diagram.getObject( oids.value( i.d_index ) );
         if( !link.isNull() && !existingItems.contains( link.getOid() ) &&
                 existingItems.contains( link.getValue( ConFlow::AttrPred ).getOid() ) &&
                 existingItems.contains( link.getValue( ConFlow::AttrSucc ).getOid() ) )
         {
-            // Lege nur Links fr Objekte an, die im Diagramm vorhanden sind
-            Udb::Obj current = create( diagram, link );
-            current.setValue( AttrNodeList, path );
+            // Lege nur Links fuer Objekte an, die im Diagramm vorhanden sind
+            DiagItem current = create( diagram, link );
+            if( i.d_path.hasValue() )
+            {
+                QPolygonF path = _getNodeList( i.d_path );
+                for( int j = 0; j < path.size(); j++ )
+                    path[j] = EpkItemMdl::rastered( path[j] + off );
+                current.setNodeList( path );
+            }
             existingItems.insert( link.getOid() );
             res.append( current );
         }
-        t = r.nextToken();
     }
-    QList<Udb::Obj> links = Procs::findHiddenLinks( diagram, done );
-    foreach( Udb::Obj link, links )
+    QList<Udb::Obj> hidden = Procs::findHiddenLinks( diagram, done );
+    foreach( Udb::Obj link, hidden )
         res.append( create( diagram, link ) );
     return res;
 }
@@ -477,68 +557,130 @@ const char* Index::Succ = "Succ";
 const char* Index::PinnedTo = "PinnedTo";
 const char* Index::Func = "Func";
 const char* Index::Elem = "Elem";
+const char* Index::ModifiedOn = "ModifiedOn";
+
+QList<Index::Def> Index::getDefs()
+{
+    // Reihenfolge ist auch die Reihenfolge im Hintergrund; zuerst, was die GUI beim Start braucht
+    QList<Def> res;
+    res << Def( Index::OrigObject, DiagItem::AttrOrigObject );
+    res << Def( Index::Pred, ConFlow::AttrPred );
+    res << Def( Index::Succ, ConFlow::AttrSucc );
+    res << Def( Index::PinnedTo, DiagItem::AttrPinnedTo );
+    res << Def( Index::Func, Allocation::AttrFunc );
+    res << Def( Index::Elem, Allocation::AttrElem );
+    res << Def( Index::Ident, Udb::ContentObject::AttrIdent );
+    res << Def( Index::AltIdent, Udb::ContentObject::AttrAltIdent );
+    res << Def( Oln::OutlineItem::AliasIndex, Oln::OutlineItem::AttrAlias );
+    res << Def( Index::ModifiedOn, Udb::ContentObject::AttrModifiedOn );
+    return res;
+}
 
-void Index::init(Udb::Database &db)
+// Pro Datenbank die noch fehlenden und der gerade entstehende Index. Gebaut wird nur im GUI-Thread
+// (IndexBuilder, ensure); die Sperre schuetzt die Listen gegen Leser in Worker-Threads.
+static QMutex s_indexLock;
+static QHash<Udb::Database*,QList<QByteArray> > s_pending;
+static QHash<Udb::Database*,QByteArray> s_building;
+
+static quint32 _attrOf( const QByteArray& name )
+{
+    foreach( const Index::Def& d, Index::getDefs() )
+        if( name == d.first )
+            return d.second;
+    return 0;
+}
+
+static void _create( Udb::Database& db, const QByteArray& name )
+{
+    Udb::Database::Lock lock( &db );
+    if( db.findIndex( name ) != 0 )
+        return;
+    Udb::IndexMeta def( Udb::IndexMeta::Value );
+    def.d_items.append( Udb::IndexMeta::Item( _attrOf( name ) ) );
+    db.createIndex( name, def );
+}
+
+void Index::init(Udb::Database &db, bool deferred )
 {
 	Oln::OutlineItem::AliasIndex = "Alias";
     Udb::Database::Lock lock( &db);
 
     db.presetAtom( "StartOfDynAttr", StartOfDynAttr );
 
-    if( db.findIndex( Index::Ident ) == 0 )
-    {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( Udb::ContentObject::AttrIdent ) );
-        db.createIndex( Index::Ident, def );
-    }
-    if( db.findIndex( Index::AltIdent ) == 0 )
+    QList<QByteArray> missing;
+    foreach( const Def& d, getDefs() )
     {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( Udb::ContentObject::AttrAltIdent ) );
-        db.createIndex( Index::AltIdent, def );
-    }
-	if( db.findIndex( Oln::OutlineItem::AliasIndex ) == 0 )
-    {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( Oln::OutlineItem::AttrAlias ) );
-		db.createIndex( Oln::OutlineItem::AliasIndex, def );
-    }
-    if( db.findIndex( Index::OrigObject ) == 0 )
-    {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( DiagItem::AttrOrigObject ) );
-        db.createIndex( Index::OrigObject, def );
+        if( db.findIndex( d.first ) != 0 )
+            continue;
+        // Den Alias-Index fragen Oln-Bibliotheken ohne ensure ab; er muss deshalb sofort vorhanden sein
+        if( deferred && ::qstrcmp( d.first, Oln::OutlineItem::AliasIndex ) != 0 )
+            missing.append( d.first );
+        else
+            _create( db, d.first );
     }
-    if( db.findIndex( Index::Pred ) == 0 )
+    QMutexLocker l( &s_indexLock );
+    if( missing.isEmpty() )
+        s_pending.remove( &db );
+    else
+        s_pending[&db] = missing;
+}
+
+QList<QByteArray> Index::getPending(Udb::Database * db)
+{
+    QMutexLocker l( &s_indexLock );
+    QList<QByteArray> res = s_pending.value( db );
+    if( s_building.contains( db ) )
+        res.prepend( s_building.value( db ) );
+    return res;
+}
+
+bool Index::isReady(Udb::Database * db, const char *name)
+{
+    QMutexLocker l( &s_indexLock );
+    return !s_pending.value( db ).contains( name ) && s_building.value( db ) != name;
+}
+
+bool Index::buildNext(Udb::Database * db)
+{
+    QByteArray name;
     {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( ConFlow::AttrPred ) );
-        db.createIndex( Index::Pred, def );
+        QMutexLocker l( &s_indexLock );
+        QList<QByteArray>& p = s_pending[db];
+        if( p.isEmpty() )
+        {
+            s_pending.remove( db );
+            return false;
+        }
+        name = p.takeFirst();
+        s_building[db] = name;
     }
-    if( db.findIndex( Index::Succ ) == 0 )
+    try
     {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( ConFlow::AttrSucc ) );
-        db.createIndex( Index::Succ, def );
-    }
-    if( db.findIndex( Index::PinnedTo ) == 0 )
+        _create( *db, name );
+    }catch( ... )
     {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( DiagItem::AttrPinnedTo ) );
-        db.createIndex( Index::PinnedTo, def );
+        QMutexLocker l( &s_indexLock );
+        s_building.remove( db );
+        s_pending[db].prepend( name ); // bleibt vorgemerkt; ensure baut ihn bei Bedarf
+        throw;
     }
-    if( db.findIndex( Index::Func ) == 0 )
+    QMutexLocker l( &s_indexLock );
+    s_building.remove( db );
+    return true;
+}
+
+void Index::ensure(Udb::Transaction * txn, const char *name)
+{
+    Q_ASSERT( txn != 0 );
+    Udb::Database* db = txn->getDb();
     {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( Allocation::AttrFunc ) );
-        db.createIndex( Index::Func, def );
+        // Alles im GUI-Thread; ein Index in s_building ist also fertig, bevor hier wieder jemand fragt
+        QMutexLocker l( &s_indexLock );
+        if( !s_pending.contains( db ) || !s_pending[db].removeAll( name ) )
+            return;
     }
-    if( db.findIndex( Index::Elem ) == 0 )
-    {
-        Udb::IndexMeta def( Udb::IndexMeta::Value );
-        def.d_items.append( Udb::IndexMeta::Item( Allocation::AttrElem ) );
-        db.createIndex( Index::Elem, def );
-	}
+    // Noch nicht an der Reihe: sofort selber bauen
+    _create( *db, name );
 }
 
 Udb::Obj Index::getRoot(Udb::Transaction * txn)
@@ -553,6 +695,15 @@ FuncDomain FuncDomain::getOrCreateRoot(Udb::Transaction * txn)
     return txn->getOrCreateObject( s_uuid, TID );
 }
 
+Tombstone Tombstone::create(const Udb::Obj & erased)
+{
+    Q_ASSERT( !erased.isNull() );
+    Tombstone t = erased.getTxn()->createObject( TID );
+    t.setValue( AttrErasedObj, DataCell().setUuid( erased.getUuid() ) );
+    t.setModifiedOn();
+    return t;
+}
+
 const QUuid SystemElement::s_uuid = "{fd68a9e9-8a1b-4d6c-858e-c4e8eb586b00}";
 SystemElement SystemElement::getOrCreateRoot(Udb::Transaction * txn)
 {
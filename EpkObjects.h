@@ -22,10 +22,11 @@
 
 #include <Udb/ContentObject.h>
 #include <Oln2/OutlineItem.h>
+#include <QPair>
 
 namespace Epk
 {
-	enum { MinAttr = 301, MaxAttr = 321, StartOfDynAttr = 0x100000 };
+	enum { MinAttr = 301, MaxAttr = 322, StartOfDynAttr = 0x100000 };
 
     class Root : public Udb::ContentObject
     {
@@ -93,7 +94,10 @@ namespace Epk
         static DiagItem createKind(Udb::Obj diagram, Kind k, const QPointF & p = QPointF());
         static DiagItem createLink( Udb::Obj diagram, Udb::Obj pred, const Udb::Obj& succ );
         static QList<Udb::Obj> writeItems( const QList<Udb::Obj> & items, Stream::DataWriter& );
-        static QList<Udb::Obj> readItems(Udb::Obj diagram, Stream::DataReader& );
+        // Legt die Items so an, dass die linke obere Ecke der Auswahl bei 'to' liegt (falls nicht null)
+        // moveTo: die linke obere Ecke der Auswahl nach 'to' verschieben; Positionen werden gerastert
+        static QList<Udb::Obj> readItems(Udb::Obj diagram, Stream::DataReader&, bool moveTo = false,
+                                         const QPointF& to = QPointF() );
     };
 
 	class Node : public Root
@@ -235,6 +239,21 @@ namespace Epk
         static SystemElement getOrCreateRoot( Udb::Transaction* );
     };
 
+    class Tombstone : public Udb::ContentObject
+    {
+        // Wird von Procs::erase angelegt, damit ein Delta-Export (EpkDelta) auch Loeschungen
+        // weitergeben kann. Nicht aggregiert; gefunden wird er ueber Index::ModifiedOn.
+    public:
+        static int TID;
+        enum Attrs
+        {
+            AttrErasedObj = 322     // Uuid des geloeschten Objekts
+        };
+        Tombstone( const Udb::Obj& o ):Udb::ContentObject(o){}
+        Tombstone(){}
+        static Tombstone create( const Udb::Obj& erased );
+    };
+
     struct Index
     {
         static const char* Ident; // AttrIdent
@@ -245,7 +264,17 @@ namespace Epk
         static const char* PinnedTo; // AttrPinnedTo
         static const char* Func; // AttrFunc
         static const char* Elem; // AttrElem
-        static void init( Udb::Database &db );
+        static const char* ModifiedOn; // AttrModifiedOn
+        typedef QPair<const char*,quint32> Def; // Name, Attribut
+        static QList<Def> getDefs();
+        // deferred: fehlende Indizes nur vormerken (ausser Alias); gebaut werden sie im GUI-Thread mit
+        // buildNext (IndexBuilder)
+        static void init( Udb::Database &db, bool deferred = false );
+        static QList<QByteArray> getPending( Udb::Database* );
+        static bool isReady( Udb::Database*, const char* name );
+        static bool buildNext( Udb::Database* ); // false..nichts mehr zu tun
+        // Vor jeder Abfrage ueber Udb::Idx; baut einen noch fehlenden Index sofort
+        static void ensure( Udb::Transaction*, const char* name );
 		static Udb::Obj getRoot( Udb::Transaction * );
 	};
 }
@@ -19,14 +19,74 @@
 
 #include "EpkProcs.h"
 #include "EpkObjects.h"
+#include "EpkDelta.h"
 #include <Oln2/OutlineItem.h>
 #include <Oln2/OutlineUdbMdl.h>
 #include <Oln2/LinkSupport.h>
 #include <Txt/TextOutHtml.h>
 #include <Udb/Idx.h>
 #include <QtDebug>
+#include <QTimerEvent>
 using namespace Epk;
 
+int Procs::s_commitWindow = 250;
+
+class _CommitBatcher : public QObject
+{
+    // Child der Transaction; ein Timer pro Fenster, gestartet beim ersten vorgemerkten Commit
+public:
+    _CommitBatcher( Udb::Transaction* txn ):QObject( txn ),d_txn( txn ),d_timer( 0 )
+    {
+        setObjectName( "Epk::CommitBatcher" );
+    }
+    void schedule( int ms )
+    {
+        if( d_timer == 0 )
+            d_timer = startTimer( ms );
+    }
+    void flush()
+    {
+        if( d_timer == 0 )
+            return;
+        killTimer( d_timer );
+        d_timer = 0;
+        d_txn->commit();
+    }
+protected:
+    void timerEvent( QTimerEvent* e )
+    {
+        if( e->timerId() == d_timer )
+            flush();
+        else
+            QObject::timerEvent( e );
+    }
+private:
+    Udb::Transaction* d_txn;
+    int d_timer;
+};
+
+void Procs::deferCommit(Udb::Transaction * txn)
+{
+    Q_ASSERT( txn != 0 );
+    if( s_commitWindow <= 0 )
+    {
+        txn->commit();
+        return;
+    }
+    _CommitBatcher* b = static_cast<_CommitBatcher*>( txn->findChild<QObject*>( "Epk::CommitBatcher" ) );
+    if( b == 0 )
+        b = new _CommitBatcher( txn );
+    b->schedule( s_commitWindow );
+}
+
+void Procs::flushCommits(Udb::Transaction * txn)
+{
+    if( txn == 0 )
+        return;
+    if( _CommitBatcher* b = static_cast<_CommitBatcher*>( txn->findChild<QObject*>( "Epk::CommitBatcher" ) ) )
+        b->flush();
+}
+
 QString Procs::prettyTypeName(quint32 type)
 {
     if( type == Function::TID )
@@ -57,6 +117,8 @@ QString Procs::prettyTypeName(quint32 type)
         return tr("Allocation");
     else if( type == SystemElement::TID )
         return tr("System Element");
+    else if( type == Tombstone::TID )
+        return tr("Tombstone");
 	else if( type == Udb::ScriptSource::TID )
 		return tr("Lua Script");
 	else
@@ -110,6 +172,8 @@ QString Procs::prettyAttrName(quint32 attr)
         return tr("Function");
     case Allocation::AttrElem:
         return tr("System Element");
+    case Tombstone::AttrErasedObj:
+        return tr("Erased Object");
 	}
     return QString();
 }
@@ -175,6 +239,9 @@ bool Procs::canConvert(const Udb::Obj & obj, quint32 toType)
             allowed = true;
         else if( toType == FuncDomain::TID )
         {
+            Index::ensure( obj.getTxn(), Index::OrigObject );
+            Index::ensure( obj.getTxn(), Index::Pred );
+            Index::ensure( obj.getTxn(), Index::Succ );
             Udb::Idx idx( obj.getTxn(), Index::OrigObject );
             Udb::Idx predIdx( obj.getTxn(), Index::Pred );
             Udb::Idx succIdx( obj.getTxn(), Index::Succ );
@@ -341,6 +408,8 @@ Udb::Obj Procs::createObject(quint32 type, Udb::Obj parent, const Udb::Obj& befo
     if( canHaveText( type ) )
         o.setString( Root::AttrText, prettyTypeName( type ) );
 	o.setTimeStamp( Root::AttrCreatedOn );
+	o.setTimeStamp( Root::AttrModifiedOn ); // sonst fehlt ein nie bearbeitetes Objekt im Delta-Export
+    o.getUuid(); // Identitaet fuer den Delta-Export (EpkDelta)
     const QString id = getNextIdString( o.getTxn(), type );
     if( !id.isEmpty() )
         o.setString( Root::AttrIdent, id );
@@ -425,6 +494,7 @@ void Procs::moveTo(Udb::Obj &o, Udb::Obj &newParent, const Udb::Obj &before)
 
 static void _erasePinnedDiagItems( const Udb::Obj& diagItem )
 {
+	Index::ensure( diagItem.getTxn(), Index::PinnedTo );
 	Udb::Idx idx2( diagItem.getTxn(), Index::PinnedTo );
 	if( idx2.seek( diagItem ) ) do
 	{
@@ -442,6 +512,7 @@ static void _eraseDiagItems( const Udb::Obj& orig )
 {
     if( orig.isNull() )
         return;
+    Index::ensure( orig.getTxn(), Index::OrigObject );
     Udb::Idx idx( orig.getTxn(), Index::OrigObject );
     if( idx.seek( orig ) ) do
     {
@@ -459,6 +530,7 @@ static void _recursiveEraseLinks( Udb::Obj &orig )
     // Children des Predecessors)
     if( orig.isNull() )
         return;
+    Index::ensure( orig.getTxn(), Index::Succ );
     Udb::Idx idx( orig.getTxn(), Index::Succ );
     if( idx.seek( Stream::DataCell().setOid( orig.getOid() ) ) ) do
     {
@@ -480,6 +552,51 @@ static void _recursiveEraseLinks( Udb::Obj &orig )
     }while( sub.next() );
 }
 
+Udb::Obj Procs::createStaging(Udb::Transaction * txn)
+{
+    Q_ASSERT( txn != 0 );
+    static const QUuid s_stagingRoot = "{8d1c5e3a-2f47-4b9e-a6d0-73e15c9b42f8}";
+    Udb::Obj root = txn->getOrCreateObject( s_stagingRoot, FuncDomain::TID );
+    Udb::Obj old = root.getFirstObj();
+    while( !old.isNull() )
+    {
+        Udb::Obj next = old.getNext();
+        erase( old );
+        old = next;
+    }
+    Udb::Obj staging = root.createAggregate( FuncDomain::TID );
+    staging.setString( Root::AttrText, QLatin1String( "Import in progress" ) );
+    staging.setTimeStamp( Root::AttrCreatedOn );
+    return staging;
+}
+
+Udb::Obj Procs::finishStaging(Udb::Obj & staging, Udb::Obj & parent)
+{
+    Q_ASSERT( !staging.isNull() && !parent.isNull() );
+    Udb::Obj first;
+    Udb::Obj o = staging.getFirstObj();
+    while( !o.isNull() )
+    {
+        Udb::Obj next = o.getNext();
+        moveTo( o, parent, Udb::Obj() );
+        if( first.isNull() )
+            first = o;
+        o = next;
+    }
+    erase( staging );
+    parent.getTxn()->commit();
+    return first;
+}
+
+void Procs::discardStaging(Udb::Obj & staging)
+{
+    Q_ASSERT( !staging.isNull() );
+    Udb::Transaction* txn = staging.getTxn();
+    txn->rollback(); // was seit dem letzten Zwischen-Commit kam
+    erase( staging );
+    txn->commit();
+}
+
 void Procs::erase(Udb::Obj &o)
 {
     if( o.isNull( false, true ) )
@@ -503,6 +620,8 @@ void Procs::erase(Udb::Obj &o)
 		// Entferne auch die DiagItems, welche an das item gepinnt sind
 		_erasePinnedDiagItems( o );
 	}
+    if( EpkDelta::isSupportedType( o.getType() ) && !o.getUuid( false ).isNull() )
+        Tombstone::create( o ); // fuer den Delta-Export; ohne Uuid kann das Objekt nirgends bekannt sein
     o.erase();
 	// Weil this und die untergeordneten eh geloescht werden ist, auch Function::AttrElemCount nicht mehr relevant
 }
@@ -591,6 +710,7 @@ QList<Udb::Obj> Procs::findHiddenLinks(const Udb::Obj &diagram, QList<Udb::Obj>
     QSet<Udb::OID> existingItems = findAllItemOrigOids( diagram );
     foreach( Udb::Obj o, startset )
     {
+        Index::ensure( o.getTxn(), Index::Pred );
         Udb::Idx predIdx( o.getTxn(), Index::Pred );
         if( predIdx.seek( Stream::DataCell().setOid( o.getOid() ) ) ) do
         {
@@ -604,6 +724,7 @@ QList<Udb::Obj> Procs::findHiddenLinks(const Udb::Obj &diagram, QList<Udb::Obj>
                 existingItems.insert( link.getOid() ); // vorher war "&& !res.contains( link )" in Bedingung
             }
         }while( predIdx.nextKey() );
+        Index::ensure( o.getTxn(), Index::Succ );
         Udb::Idx succIdx( o.getTxn(), Index::Succ );
         if( succIdx.seek( Stream::DataCell().setOid( o.getOid() ) ) ) do
         {
@@ -684,6 +805,7 @@ QList<Udb::Obj> Procs::findSuccessors(const Udb::Obj &item)
 {
     // Diese Funktion garantiert nicht, dass Items nicht schon im Diagramm sind!
     QList<Udb::Obj> successors;
+    Index::ensure( item.getTxn(), Index::Pred );
     Udb::Idx predIdx( item.getTxn(), Index::Pred );
     if( predIdx.seek( Stream::DataCell().setOid( item.getOid() ) ) ) do
     {
@@ -702,6 +824,7 @@ QList<Udb::Obj> Procs::findPredecessors( const Udb::Obj &item)
 {
     // Diese Funktion garantiert nicht, dass Items nicht schon im Diagramm sind!
     QList<Udb::Obj> predecessors;
+    Index::ensure( item.getTxn(), Index::Succ );
     Udb::Idx succIdx( item.getTxn(), Index::Succ );
     if( succIdx.seek( Stream::DataCell().setOid( item.getOid() ) ) ) do
     {
@@ -772,6 +895,7 @@ QList<Udb::Obj> Procs::findShortestPath(const Udb::Obj &start, const Udb::Obj &g
     // Es gibt dafr keinen schlauen bzw. etablierten Algorithmus ausser rudimentre Suche
     Visited visited;
     PredSucc predSucc;
+    Index::ensure( start.getTxn(), Index::Pred );
     Udb::Idx predIdx( start.getTxn(), Index::Pred );
     if( predIdx.first() ) do
     {
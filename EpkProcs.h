@@ -46,6 +46,21 @@ namespace Epk
         static void retypeObject( Udb::Obj& o, quint32 type ); // Prft nicht, ob zulssig!
         static void moveTo( Udb::Obj& o, Udb::Obj& newParent, const Udb::Obj& before ); // Prft nicht, ob zulssig!
         static void erase( Udb::Obj& o );
+        // Staging fuer Importe: eine neue FuncDomain unter einer eigenen Wurzel, welche kein Baum anzeigt.
+        // Reste eines abgebrochenen Imports (Absturz) werden beim naechsten Aufruf entfernt. Kein Commit.
+        static Udb::Obj createStaging( Udb::Transaction* );
+        // Verschiebt alles aus der Staging-Domain nach parent, loescht sie und committed; gibt das erste
+        // verschobene Objekt zurueck. discardStaging verwirft Uncommittetes und loescht sie samt Inhalt.
+        static Udb::Obj finishStaging( Udb::Obj& staging, Udb::Obj& parent );
+        static void discardStaging( Udb::Obj& staging );
+        // Gruppen-Commit fuer interaktive Aenderungen: statt sofort zu committen wird der Commit um
+        // s_commitWindow ms verschoben; alle Aenderungen in diesem Fenster gehen mit einem einzigen
+        // Schreibvorgang auf die Platte. Die Notifikationen kommen weiterhin in der Reihenfolge der
+        // Aenderungen, nur spaeter. Jeder direkte commit() nimmt Vorgemerktes mit. Vor rollback() und
+        // beim Schliessen flushCommits() aufrufen, sonst gehen vorgemerkte Aenderungen verloren.
+        static int s_commitWindow; // ms, 0..sofort committen
+        static void deferCommit( Udb::Transaction* );
+        static void flushCommits( Udb::Transaction* );
         static bool isDiagram( quint32 type );
         static bool isDiagNode( quint32 type );
         static QSet<Udb::OID> findAllItemOrigOids( const Udb::Obj& diagram );
@@ -0,0 +1,130 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkSnapshot.h"
+#include <Udb/Database.h>
+#include <Udb/DatabaseException.h>
+#include <Udb/Transaction.h>
+#include <QMutex>
+#include <QHash>
+#include <QAtomicInt>
+using namespace Epk;
+
+static QMutex s_genLock;
+static QHash<QString,quint32> s_generations; // Dateipfad -> Generation
+static QAtomicInt s_open;
+static QAtomicInt s_activity;
+
+SnapshotTracker::SnapshotTracker(Udb::Database * db):QObject(db),d_db(db),d_path(db->getFilePath())
+{
+    Q_ASSERT( db != 0 );
+    QMutexLocker l( &s_genLock );
+    s_generations[d_path] = 0;
+    l.unlock();
+    d_db->addObserver( this, SLOT( onDbUpdate( Udb::UpdateInfo ) ) );
+}
+
+SnapshotTracker::~SnapshotTracker()
+{
+    d_db->removeObserver( this, SLOT( onDbUpdate( Udb::UpdateInfo ) ) );
+    QMutexLocker l( &s_genLock );
+    s_generations.remove( d_path );
+}
+
+quint32 SnapshotTracker::getGeneration(const QString & filePath)
+{
+    QMutexLocker l( &s_genLock );
+    return s_generations.value( filePath );
+}
+
+void SnapshotTracker::onDbUpdate(Udb::UpdateInfo)
+{
+    // Jede Notifikation heisst: der committete Stand hat sich geaendert
+    QMutexLocker l( &s_genLock );
+    s_generations[d_path]++;
+}
+
+Snapshot::Snapshot(Udb::Database * source):d_db(0),d_txn(0),d_generation(0)
+{
+    Q_ASSERT( source != 0 );
+    d_path = source->getFilePath();
+    open();
+}
+
+Snapshot::Snapshot(const QString & filePath):d_path(filePath),d_db(0),d_txn(0),d_generation(0)
+{
+    open();
+}
+
+void Snapshot::open()
+{
+    s_open.ref();
+    s_activity.ref();
+    // Generation vor dem Oeffnen lesen; ein Commit waehrend open() macht den Snapshot sicher stale
+    d_generation = SnapshotTracker::getGeneration( d_path );
+    try
+    {
+        d_db = new Udb::Database( 0 );
+        d_db->open( d_path );
+        d_txn = new Udb::Transaction( d_db, 0 );
+    }catch( Udb::DatabaseException& e )
+    {
+        d_error = QString( "%1: %2" ).arg( e.getCodeString() ).arg( e.getMsg() );
+        delete d_txn;
+        d_txn = 0;
+    }
+}
+
+Snapshot::~Snapshot()
+{
+    try
+    {
+        if( d_txn )
+            d_txn->rollback(); // nur gelesen
+    }catch( Udb::DatabaseException& )
+    {
+        // Auch beim Aufraeumen nach einer Exception nichts weiterwerfen
+    }
+    delete d_txn;
+    delete d_db;
+    s_activity.ref();
+    s_open.deref();
+}
+
+Udb::Obj Snapshot::getObject(quint64 oid) const
+{
+    if( d_txn == 0 )
+        return Udb::Obj();
+    return d_txn->getObject( oid );
+}
+
+bool Snapshot::isStale() const
+{
+    return SnapshotTracker::getGeneration( d_path ) != d_generation;
+}
+
+int Snapshot::getOpenCount()
+{
+    return s_open; // Qt 4: QAtomicInt konvertiert implizit nach int
+}
+
+int Snapshot::getActivity()
+{
+    return s_activity;
+}
@@ -0,0 +1,77 @@
+#ifndef EPKSNAPSHOT_H
+#define EPKSNAPSHOT_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <Udb/Obj.h>
+#include <Udb/UpdateInfo.h>
+
+namespace Epk
+{
+    class SnapshotTracker : public QObject
+    {
+        // Zaehlt die Aenderungen einer Datenbank (Generation); lebt im GUI-Thread als Child der Datenbank.
+        Q_OBJECT
+    public:
+        SnapshotTracker( Udb::Database* );
+        ~SnapshotTracker();
+        static quint32 getGeneration( const QString& filePath ); // threadsicher
+    protected slots:
+        void onDbUpdate( Udb::UpdateInfo );
+    private:
+        Udb::Database* d_db;
+        QString d_path;
+    };
+
+    class Snapshot
+    {
+        // Nur lesende Sicht fuer Worker-Threads. Udb kennt kein MVCC; der Snapshot oeffnet deshalb eine eigene
+        // Verbindung auf dieselbe Datei mit eigener Transaction und eigenem Cache und sieht so nur committete
+        // Daten, nie die halb angewendeten Aenderungen der gemeinsamen GUI-Transaction. Ob seit dem Oeffnen
+        // committet wurde, sagt isStale() anhand der Generation des SnapshotTracker; wer einen exakt
+        // aktuellen Stand braucht, wiederholt dann die Arbeit. Darf in jedem Thread erzeugt werden, aber
+        // Snapshot und alle daraus gelesenen Udb::Obj gehoeren diesem Thread.
+        // Jobs, welche die Quell-Datenbank ueberleben koennen, uebergeben statt dieser deren Dateipfad.
+    public:
+        Snapshot( Udb::Database* source ); // nur solange source sicher lebt (z.B. blockierender Aufrufer)
+        Snapshot( const QString& filePath );
+        ~Snapshot();
+        bool isOpen() const { return d_txn != 0; }
+        const QString& getError() const { return d_error; }
+        Udb::Transaction* getTxn() const { return d_txn; }
+        Udb::Obj getObject( quint64 oid ) const;
+        bool isStale() const;
+        // Prozessweit, threadsicher; aendert sich bei jedem Oeffnen und Schliessen. Fuer Messungen des
+        // Prozess-I/O (CacheTuner), die Lesezugriffe der Snapshots nicht der GUI-Verbindung zuschreiben duerfen.
+        static int getOpenCount();
+        static int getActivity();
+    private:
+        Q_DISABLE_COPY( Snapshot )
+        void open();
+        QString d_path;
+        Udb::Database* d_db;
+        Udb::Transaction* d_txn;
+        QString d_error;
+        quint32 d_generation;
+    };
+}
+
+#endif // EPKSNAPSHOT_H
@@ -0,0 +1,271 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkSpatialIndex.h"
+#include "EpkItems.h"
+#include <QGraphicsItem>
+#include <QPainterPath>
+#include <QSet>
+#include <math.h>
+using namespace Epk;
+
+static const qreal s_segMargin = 10.0; // Pen und Pfeilspitze
+
+SpatialIndex::SpatialIndex(qreal cellWidth, qreal cellHeight):
+    d_cellWidth( cellWidth ),d_cellHeight( cellHeight ),d_seq(0)
+{
+    Q_ASSERT( cellWidth > 0.0 && cellHeight > 0.0 );
+}
+
+void SpatialIndex::clear()
+{
+    d_entries.clear();
+    d_grid.clear();
+    d_bounds = QRectF();
+    d_seq = 0;
+}
+
+QRect SpatialIndex::toCells(const QRectF & r) const
+{
+    const int x1 = ::floor( r.left() / d_cellWidth );
+    const int y1 = ::floor( r.top() / d_cellHeight );
+    const int x2 = ::floor( r.right() / d_cellWidth );
+    const int y2 = ::floor( r.bottom() / d_cellHeight );
+    return QRect( QPoint( x1, y1 ), QPoint( x2, y2 ) );
+}
+
+void SpatialIndex::collectKeys(QGraphicsItem * i, QVector<Key> & keys) const
+{
+    LineSegment* ls = 0;
+    if( i->type() == EpkNode::_Flow )
+        ls = static_cast<LineSegment*>( i );
+    if( ls && ls->getStartItem() && ls->getEndItem() )
+    {
+        // Nur die Zellen entlang der Linie; ein langer diagonaler Flow wuerde sonst als Rechteck
+        // sehr viele Zellen belegen.
+        const QPointF p1 = ls->getStartItem()->scenePos();
+        const QPointF p2 = ls->getEndItem()->scenePos();
+        const qreal len = QLineF( p1, p2 ).length();
+        const qreal step = qMin( d_cellWidth, d_cellHeight ) * 0.5;
+        const int n = qMax( 1, int( ::ceil( len / step ) ) );
+        QSet<Key> done;
+        for( int k = 0; k <= n; k++ )
+        {
+            const QPointF p = p1 + ( p2 - p1 ) * ( qreal(k) / qreal(n) );
+            const QRect c = toCells( QRectF( p.x() - s_segMargin, p.y() - s_segMargin,
+                                             2.0 * s_segMargin, 2.0 * s_segMargin ) );
+            for( int x = c.left(); x <= c.right(); x++ )
+                for( int y = c.top(); y <= c.bottom(); y++ )
+                {
+                    const Key key = toKey( x, y );
+                    if( !done.contains( key ) )
+                    {
+                        done.insert( key );
+                        keys.append( key );
+                    }
+                }
+        }
+    }else
+    {
+        const QRect c = toCells( i->sceneBoundingRect() );
+        for( int x = c.left(); x <= c.right(); x++ )
+            for( int y = c.top(); y <= c.bottom(); y++ )
+                keys.append( toKey( x, y ) );
+    }
+}
+
+void SpatialIndex::update(QGraphicsItem * i)
+{
+    Q_ASSERT( i != 0 );
+    QHash<QGraphicsItem*,Entry>::iterator e = d_entries.find( i );
+    if( e == d_entries.end() )
+    {
+        e = d_entries.insert( i, Entry() );
+        e.value().d_seq = d_seq++;
+    }else
+    {
+        foreach( Key k, e.value().d_keys )
+        {
+            QHash<Key,QVector<QGraphicsItem*> >::iterator c = d_grid.find( k );
+            if( c != d_grid.end() )
+            {
+                const int pos = c.value().indexOf( i );
+                if( pos != -1 )
+                    c.value().remove( pos );
+                if( c.value().isEmpty() )
+                    d_grid.erase( c );
+            }
+        }
+        e.value().d_keys.clear();
+    }
+    collectKeys( i, e.value().d_keys );
+    foreach( Key k, e.value().d_keys )
+        d_grid[k].append( i );
+    d_bounds |= i->sceneBoundingRect();
+}
+
+void SpatialIndex::remove(QGraphicsItem * i)
+{
+    QHash<QGraphicsItem*,Entry>::iterator e = d_entries.find( i );
+    if( e == d_entries.end() )
+        return;
+    foreach( Key k, e.value().d_keys )
+    {
+        QHash<Key,QVector<QGraphicsItem*> >::iterator c = d_grid.find( k );
+        if( c != d_grid.end() )
+        {
+            const int pos = c.value().indexOf( i );
+            if( pos != -1 )
+                c.value().remove( pos );
+            if( c.value().isEmpty() )
+                d_grid.erase( c );
+        }
+    }
+    d_entries.erase( e );
+}
+
+qint64 SpatialIndex::memoryUsage() const
+{
+    static const int s_hashNode = 24;
+    static const int s_vectorOverhead = 16;
+    qint64 res = 0;
+    QHash<QGraphicsItem*,Entry>::const_iterator i;
+    for( i = d_entries.begin(); i != d_entries.end(); ++i )
+        res += s_hashNode + sizeof(Entry) + s_vectorOverhead + i.value().d_keys.capacity() * sizeof(Key);
+    QHash<Key,QVector<QGraphicsItem*> >::const_iterator j;
+    for( j = d_grid.begin(); j != d_grid.end(); ++j )
+        res += s_hashNode + s_vectorOverhead + j.value().capacity() * sizeof(void*);
+    return res;
+}
+
+struct _StackingOrder
+{
+    const QHash<QGraphicsItem*,quint32>& d_seqs;
+    _StackingOrder( const QHash<QGraphicsItem*,quint32>& s ):d_seqs(s) {}
+    bool operator()( QGraphicsItem* lhs, QGraphicsItem* rhs ) const
+    {
+        // Oberstes Item zuerst; bei gleichem z liegt das spaeter eingefuegte oben
+        if( lhs->zValue() != rhs->zValue() )
+            return lhs->zValue() > rhs->zValue();
+        return d_seqs.value( lhs ) > d_seqs.value( rhs );
+    }
+};
+
+void SpatialIndex::sortByStacking(QList<QGraphicsItem *> & l) const
+{
+    if( l.size() < 2 )
+        return;
+    QHash<QGraphicsItem*,quint32> seqs;
+    foreach( QGraphicsItem* i, l )
+        seqs[i] = d_entries.value( i ).d_seq;
+    qSort( l.begin(), l.end(), _StackingOrder( seqs ) );
+}
+
+QList<QGraphicsItem *> SpatialIndex::items(const QPointF & p) const
+{
+    QList<QGraphicsItem*> res;
+    const QVector<QGraphicsItem*> cell = d_grid.value( toKey( ::floor( p.x() / d_cellWidth ),
+                                                              ::floor( p.y() / d_cellHeight ) ) );
+    foreach( QGraphicsItem* i, cell )
+    {
+        if( i->isVisible() && i->sceneBoundingRect().contains( p ) && i->contains( i->mapFromScene( p ) ) )
+            res.append( i );
+    }
+    sortByStacking( res );
+    return res;
+}
+
+QGraphicsItem *SpatialIndex::itemAt(const QPointF & p) const
+{
+    const QList<QGraphicsItem*> l = items( p );
+    if( l.isEmpty() )
+        return 0;
+    else
+        return l.first();
+}
+
+QList<QGraphicsItem *> SpatialIndex::items(const QRectF & rect, Qt::ItemSelectionMode mode) const
+{
+    QList<QGraphicsItem*> res;
+    if( d_entries.isEmpty() )
+        return res;
+    const QRectF r = rect.normalized();
+    QRectF q = r & d_bounds;
+    if( q.isEmpty() )
+        q = r; // degenerierte Rechtecke
+    QSet<QGraphicsItem*> candidates;
+    const QRect c = toCells( q );
+    if( qint64( c.width() ) * qint64( c.height() ) > d_grid.size() )
+    {
+        // Grosse Abfragen (z.B. ganze Scene): belegte Zellen durchgehen statt leere abzufragen
+        QHash<Key,QVector<QGraphicsItem*> >::const_iterator j;
+        for( j = d_grid.begin(); j != d_grid.end(); ++j )
+        {
+            const int x = qint32( j.key() >> 32 );
+            const int y = qint32( j.key() & 0xffffffff );
+            if( c.contains( x, y ) )
+                foreach( QGraphicsItem* i, j.value() )
+                    candidates.insert( i );
+        }
+    }else
+    {
+        for( int x = c.left(); x <= c.right(); x++ )
+            for( int y = c.top(); y <= c.bottom(); y++ )
+            {
+                QHash<Key,QVector<QGraphicsItem*> >::const_iterator j = d_grid.find( toKey( x, y ) );
+                if( j != d_grid.end() )
+                    foreach( QGraphicsItem* i, j.value() )
+                        candidates.insert( i );
+            }
+    }
+    foreach( QGraphicsItem* i, candidates )
+    {
+        if( !i->isVisible() )
+            continue;
+        const QRectF br = i->sceneBoundingRect();
+        switch( mode )
+        {
+        case Qt::ContainsItemBoundingRect:
+            if( r.contains( br ) )
+                res.append( i );
+            break;
+        case Qt::IntersectsItemBoundingRect:
+            if( r.intersects( br ) )
+                res.append( i );
+            break;
+        case Qt::ContainsItemShape:
+            if( r.contains( br ) || r.contains( i->mapToScene( i->shape() ).boundingRect() ) )
+                res.append( i );
+            break;
+        case Qt::IntersectsItemShape:
+            if( r.contains( br ) )
+                res.append( i );
+            else if( r.intersects( br ) )
+            {
+                QPainterPath path;
+                path.addRect( r );
+                if( path.intersects( i->mapToScene( i->shape() ) ) )
+                    res.append( i );
+            }
+            break;
+        }
+    }
+    sortByStacking( res );
+    return res;
+}
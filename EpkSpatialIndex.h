@@ -0,0 +1,70 @@
+#ifndef EPKSPATIALINDEX_H
+#define EPKSPATIALINDEX_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QHash>
+#include <QVector>
+#include <QRectF>
+
+class QGraphicsItem;
+
+namespace Epk
+{
+    class SpatialIndex
+    {
+        // Uniform Grid fuer Hit-Testing in EpkItemMdl. Ergaenzt den BSP-Index von QGraphicsScene, welcher
+        // nur noch das Zeichnen bedient und nicht nach jedem Verschieben abgefragt wird. Hier wird nur das bewegte
+        // Item aus seinen Zellen entfernt und neu eingetragen. LineSegments belegen nur die Zellen entlang
+        // der Linie, nicht das ganze BoundingRect.
+    public:
+        SpatialIndex( qreal cellWidth, qreal cellHeight );
+        void clear();
+        void update( QGraphicsItem* ); // Fuegt ein oder traegt nach Bewegung/Groessenaenderung neu ein
+        void remove( QGraphicsItem* );
+        bool contains( QGraphicsItem* i ) const { return d_entries.contains( i ); }
+        int count() const { return d_entries.size(); }
+        qint64 memoryUsage() const; // Bytes, grob
+
+        // Resultate wie bei QGraphicsScene absteigend nach Stacking Order
+        QList<QGraphicsItem*> items( const QPointF& ) const; // Shape-genau
+        QList<QGraphicsItem*> items( const QRectF&, Qt::ItemSelectionMode = Qt::IntersectsItemShape ) const;
+        QGraphicsItem* itemAt( const QPointF& ) const;
+    private:
+        typedef quint64 Key;
+        struct Entry
+        {
+            QVector<Key> d_keys;
+            quint32 d_seq; // Einfuegereihenfolge, entscheidet bei gleichem z
+        };
+        Key toKey( int x, int y ) const { return ( quint64( quint32( x ) ) << 32 ) | quint32( y ); }
+        QRect toCells( const QRectF& ) const;
+        void collectKeys( QGraphicsItem*, QVector<Key>& ) const;
+        void sortByStacking( QList<QGraphicsItem*>& ) const;
+        QHash<QGraphicsItem*,Entry> d_entries;
+        QHash<Key,QVector<QGraphicsItem*> > d_grid;
+        QRectF d_bounds; // konservativ, wird beim Entfernen nicht verkleinert
+        qreal d_cellWidth;
+        qreal d_cellHeight;
+        quint32 d_seq;
+    };
+}
+
+#endif // EPKSPATIALINDEX_H
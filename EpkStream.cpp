@@ -23,9 +23,16 @@
 #include <Oln2/OutlineStream.h>
 #include "EpkObjects.h"
 #include "EpkProcs.h"
+#include <Udb/Idx.h>
+#include <QtEndian>
+#include <QtConcurrentMap>
+#include <QThread>
+#include <string.h>
 using namespace Epk;
 using namespace Stream;
 
+const char* EpkStream::s_tocMagic = "FLNXTOC1";
+
 void EpkStream::exportProc( Stream::DataWriter& out, const Udb::Obj& proc )
 {
     if( proc.isNull() || proc.getType() != Function::TID )
@@ -38,28 +45,205 @@ void EpkStream::exportProc( Stream::DataWriter& out, const Udb::Obj& proc )
 
 Udb::Obj EpkStream::importProc( Stream::DataReader& in, Udb::Obj& parent )
 {
-	d_error.clear();
+    reset();
 	if( in.nextToken() != DataReader::Slot || in.getValue().getArr() != "FlowLineStream" )
 	{
 		d_error = "invalid data stream";
 		return Udb::Obj();
 	}
-	if( in.nextToken() != DataReader::Slot || in.getValue().getArr() != "0.1" )
+	if( in.nextToken() != DataReader::Slot ||
+            ( in.getValue().getArr() != "0.1" && in.getValue().getArr() != "0.2" ) )
 	{
 		d_error = "invalid stream version";
 		return Udb::Obj();
 	}
+    const bool v02 = in.getValue().getArr() == "0.2";
 	if( in.nextToken() != DataReader::Slot || !in.getValue().isDateTime() )
 	{
 		d_error = "invalid protocol";
 		return Udb::Obj();
 	}
-	if( in.nextToken() != DataReader::BeginFrame || !in.getName().getTag().equals( "proc" ) )
-	{
-		d_error = "invalid protocol";
-		return Udb::Obj();
-	}
-    return readItem( in, parent );
+    Udb::Obj res;
+    if( !v02 )
+    {
+        if( in.nextToken() != DataReader::BeginFrame || !in.getName().getTag().equals( "proc" ) )
+        {
+            d_error = "invalid protocol";
+            return Udb::Obj();
+        }
+        res = readItem( in, parent );
+    }else
+    {
+        if( in.nextToken() != DataReader::Slot )
+        {
+            d_error = "invalid protocol";
+            return Udb::Obj();
+        }
+        d_compressed = in.getValue().getUInt8() & 0x1;
+        d_outer = &in;
+        QByteArray data;
+        if( !readBlockData( data ) )
+            return Udb::Obj();
+        const DataCell cell = DataCell().setBml( data );
+        DataReader r( cell );
+        if( r.nextToken() != DataReader::BeginFrame || !r.getName().getTag().equals( "proc" ) )
+        {
+            d_error = "invalid protocol";
+            return Udb::Obj();
+        }
+        res = readItem( r, parent );
+        d_outer = 0;
+        d_strings.clear();
+    }
+    if( !res.isNull() )
+        resolveFixups( parent.getTxn() );
+    return res;
+}
+
+void EpkStream::reset()
+{
+	d_error.clear();
+    d_count = 0;
+    d_remote.clear();
+    d_levels.clear();
+    d_targets.clear();
+    d_aliases.clear();
+    d_flows.clear();
+    d_strings.clear();
+    d_outer = 0;
+}
+
+Udb::Obj EpkStream::importBlock( Stream::DataReader& in, bool compressed, Udb::Obj& parent )
+{
+    Q_ASSERT( !parent.isNull() );
+    reset();
+    d_outer = &in;
+    d_compressed = compressed;
+    QByteArray data;
+    DataCell text, id;
+    Udb::Obj res;
+    bool ok = readBlockData( data, &text, &id );
+    if( ok )
+    {
+        const DataCell cell = DataCell().setBml( data );
+        DataReader r( cell );
+        if( r.nextToken() != DataReader::BeginFrame )
+        {
+            d_error = "invalid block";
+            ok = false;
+        }else if( r.getName().getTag().equals( "body" ) )
+        {
+            // Sub-proc eines einzelnen Prozesses; Text und Id stehen im Kopf des Blocks
+            res = Procs::createObject( Function::TID, parent );
+            if( text.hasValue() )
+                res.setValue( Root::AttrText, text );
+            if( id.hasValue() )
+                res.setValue( Root::AttrAltIdent, id ); // createObject vergibt bereits eine Ident
+            ok = created( res ) && readBody( r, res, 0 );
+        }else
+        {
+            // Archiv: der Block enthaelt einen vollstaendigen Prozess
+            res = readItem( r, parent );
+            ok = !res.isNull();
+        }
+    }
+    d_outer = 0;
+    if( !ok )
+        return Udb::Obj();
+    resolveFixups( parent.getTxn() );
+    return res;
+}
+
+Udb::OID EpkStream::toLocal( Udb::OID diagram, quint64 remote ) const
+{
+    QHash<Udb::OID,QHash<quint64,Udb::OID> >::const_iterator i = d_levels.find( diagram );
+    if( i != d_levels.end() )
+    {
+        const Udb::OID local = i.value().value( remote );
+        if( local != 0 )
+            return local;
+    }
+    return d_remote.value( remote );
+}
+
+bool EpkStream::createFlow( Udb::Transaction* txn, const FlowFixup& f )
+{
+    const Udb::OID from = toLocal( f.d_diagram, f.d_from );
+    const Udb::OID to = toLocal( f.d_diagram, f.d_to );
+    if( from == 0 || to == 0 )
+        return false;
+    DiagItem di = DiagItem::createLink( txn->getObject( f.d_diagram ),
+                                        txn->getObject( from ), txn->getObject( to ) );
+    di.setNodeList( f.d_nodes );
+    return true;
+}
+
+void EpkStream::resolveFlows( const Udb::Obj& diagram )
+{
+    // Am Ende eines Prozesses sind alle seine Elemente bekannt; uebrig bleiben nur Flows, deren Ende
+    // in einem spaeteren Prozess steht. So waechst d_flows nicht mit der Groesse des ganzen Streams.
+    QList<FlowFixup>::iterator i = d_flows.begin();
+    while( i != d_flows.end() )
+    {
+        if( (*i).d_diagram == diagram.getOid() && createFlow( diagram.getTxn(), *i ) )
+            i = d_flows.erase( i );
+        else
+            ++i;
+    }
+    d_levels.remove( diagram.getOid() );
+}
+
+void EpkStream::resolveFixups( Udb::Transaction* txn )
+{
+    foreach( const AliasFixup& f, d_aliases )
+    {
+        // Ein Ziel im Stream hat Vorrang; sonst wie bisher ein bereits in der Datenbank vorhandenes Objekt
+        const Udb::OID local = d_targets.value( f.d_target );
+        const Udb::Obj a = ( local != 0 ) ? txn->getObject( local ) :
+                                            txn->getObject( DataCell().setUuid( f.d_target ) );
+        if( !a.isNull() )
+            txn->getObject( f.d_obj ).setValue( Oln::OutlineItem::AttrAlias, a );
+    }
+    foreach( const FlowFixup& f, d_flows )
+    {
+        if( !createFlow( txn, f ) )
+            qWarning() << "EpkStream: flow with unknown end ignored";
+    }
+    d_remote.clear();
+    d_levels.clear();
+    d_targets.clear();
+    d_aliases.clear();
+    d_flows.clear();
+}
+
+Udb::Obj EpkStream::importProcStaged( Stream::DataReader& in, Udb::Obj& parent )
+{
+    Q_ASSERT( !parent.isNull() );
+    Udb::Transaction* txn = parent.getTxn();
+    // Die Staging-Domain ist in keinem Baum sichtbar; die Tree-Modelle ignorieren die Zwischen-Commits
+    Udb::Obj staging = Procs::createStaging( txn );
+    txn->commit();
+    Udb::Obj o = importProc( in, staging );
+    if( o.isNull() )
+    {
+        Procs::discardStaging( staging );
+        return Udb::Obj();
+    }
+    return Procs::finishStaging( staging, parent );
+}
+
+bool EpkStream::created( const Udb::Obj& o )
+{
+    static const int s_progressStep = 100;
+    d_count++;
+    if( d_batchSize > 0 && d_count % d_batchSize == 0 )
+        o.getTxn()->commit(); // haelt die Transaktion klein
+    if( d_count % s_progressStep == 0 && !progress( d_count ) )
+    {
+        d_error = QLatin1String( "import canceled" );
+        return false;
+    }
+    return true;
 }
 
 static inline DataCell _floatToDouble( const DataCell& in )
@@ -67,6 +251,21 @@ static inline DataCell _floatToDouble( const DataCell& in )
     return DataCell().setDouble( in.getFloat() );
 }
 
+static void _writeRefs( Stream::DataWriter& out, const Udb::Obj& orig )
+{
+    DataCell v = orig.getValue( Connector::AttrConnType );
+    if( v.hasValue() )
+        out.writeSlot( v, NameTag( "ctyp" ), true );
+    Index::ensure( orig.getTxn(), Oln::OutlineItem::AliasIndex );
+    Udb::Idx idx( orig.getTxn(), Oln::OutlineItem::AliasIndex );
+    if( idx.seek( orig ) )
+        out.writeSlot( DataCell().setUuid( orig.getUuid() ), NameTag( "uuid" ), true ); // Ziel fuer 'ali'
+    v = orig.getValue( Oln::OutlineItem::AttrAlias );
+    if( v.hasValue() )
+        out.writeSlot( DataCell().setUuid( orig.getValueAsObj(
+            Oln::OutlineItem::AttrAlias ).getUuid() ), NameTag( "ali" ), true );
+}
+
 void EpkStream::writeAtts( Stream::DataWriter& out, const Udb::Obj& orig, const Udb::Obj &diagItem )
 {
 	DataCell v;
@@ -78,13 +277,7 @@ void EpkStream::writeAtts( Stream::DataWriter& out, const Udb::Obj& orig, const
     v = orig.getValue( Root::AttrIdent );
 	if( v.hasValue() )
 		out.writeSlot( v, NameTag( "id" ) );
-    v = orig.getValue( Connector::AttrConnType );
-    if( v.hasValue() )
-        out.writeSlot( v, NameTag( "ctyp" ), true );
-    v = orig.getValue( Oln::OutlineItem::AttrAlias );
-    if( v.hasValue() )
-        out.writeSlot( DataCell().setUuid( orig.getValueAsObj(
-            Oln::OutlineItem::AttrAlias ).getUuid() ), NameTag( "ali" ), true );
+    _writeRefs( out, orig );
 
     if( !diagItem.isNull() )
     {
@@ -172,6 +365,447 @@ void EpkStream::writeObjTo( Stream::DataWriter& out, const Udb::Obj& orig, const
     out.endFrame();
 }
 
+static inline void _putFloat( uchar* d, float f )
+{
+    quint32 u;
+    ::memcpy( &u, &f, 4 );
+    qToBigEndian( u, d );
+}
+
+static inline float _getFloat( const uchar* d )
+{
+    const quint32 u = qFromBigEndian<quint32>( d );
+    float f;
+    ::memcpy( &f, &u, 4 );
+    return f;
+}
+
+static QByteArray _packNodes( const QPolygonF& p )
+{
+    QByteArray res( p.size() * 8, 0 );
+    uchar* d = reinterpret_cast<uchar*>( res.data() );
+    for( int i = 0; i < p.size(); i++ )
+    {
+        _putFloat( d + i * 8, p[i].x() );
+        _putFloat( d + i * 8 + 4, p[i].y() );
+    }
+    return res;
+}
+
+static QPolygonF _unpackNodes( const QByteArray& in )
+{
+    QPolygonF res;
+    const uchar* d = reinterpret_cast<const uchar*>( in.constData() );
+    for( int i = 0; i + 8 <= in.size(); i += 8 )
+        res.append( QPointF( _getFloat( d + i ), _getFloat( d + i + 4 ) ) );
+    return res;
+}
+
+static const char* _frameTag( const Udb::Obj& orig )
+{
+    const quint32 type = orig.getType();
+    if( type == Function::TID )
+        return ( orig.getValue( Function::AttrElemCount ).getUInt32() > 0 ) ? "proc" : "func";
+    else if( type == Event::TID )
+        return "evt";
+    else if( type == Connector::TID )
+        return "conn";
+    else
+        return 0;
+}
+
+static void _writeString02( Stream::DataWriter& out, const DataCell& v, const char* name, const char* ref,
+                            QHash<QString,quint32>& strs )
+{
+    const QString key = QString::number( v.getType() ) + QChar(':') + v.toString();
+    QHash<QString,quint32>::const_iterator i = strs.find( key );
+    if( i != strs.end() )
+        out.writeSlot( DataCell().setUInt32( i.value() ), NameTag( ref ), true );
+    else
+    {
+        const quint32 n = strs.size();
+        strs.insert( key, n );
+        out.writeSlot( v, NameTag( name ) );
+    }
+}
+
+void EpkStream::writeAtts02( Stream::DataWriter& out, const Udb::Obj& orig, const Udb::Obj &diagItem,
+                             StringTable& strs )
+{
+    DataCell v;
+    out.writeSlot( orig, NameTag( "oid" ) );
+    v = orig.getValue( Root::AttrText );
+    if( v.hasValue() )
+        _writeString02( out, v, "text", "txtr", strs );
+    v = orig.getValue( Root::AttrIdent );
+    if( v.hasValue() )
+        _writeString02( out, v, "id", "idr", strs );
+    _writeRefs( out, orig );
+    if( !diagItem.isNull() )
+    {
+        // Die Positionen sind bereits float
+        v = diagItem.getValue( DiagItem::AttrPosX );
+        if( v.hasValue() )
+            out.writeSlot( v, NameTag( "posx" ), true );
+        v = diagItem.getValue( DiagItem::AttrPosY );
+        if( v.hasValue() )
+            out.writeSlot( v, NameTag( "posy" ), true );
+        v = diagItem.getValue( DiagItem::AttrWidth );
+        if( v.hasValue() )
+            out.writeSlot( v, NameTag( "w" ), true );
+        v = diagItem.getValue( DiagItem::AttrHeight );
+        if( v.hasValue() )
+            out.writeSlot( v, NameTag( "h" ), true );
+    }
+}
+
+void EpkStream::writeObjTo02( Stream::DataWriter& out, const Udb::Obj& orig, const Udb::Obj &diagItem,
+                              StringTable& strs, QList<Udb::Obj>* blocks )
+{
+    const char* tag = _frameTag( orig );
+    if( tag == 0 )
+        return;
+    out.startFrame( NameTag( tag ) );
+    writeAtts02( out, orig, diagItem, strs );
+    if( blocks != 0 && !diagItem.isNull() && ::strcmp( tag, "proc" ) == 0 )
+    {
+        // Direkter Sub-proc des exportierten proc: Inhalt in eigenem Block
+        blocks->append( orig );
+        out.writeSlot( DataCell().setUInt32( blocks->size() ), NameTag( "blk" ), true );
+    }else
+        writeBody02( out, orig, strs, ( diagItem.isNull() ) ? blocks : 0 );
+    out.endFrame();
+}
+
+void EpkStream::writeBody02( Stream::DataWriter& out, const Udb::Obj& orig, StringTable& strs,
+                             QList<Udb::Obj>* blocks )
+{
+    // Ein Durchgang; die Flows werden gesammelt und nach den Items geschrieben
+    Oln::OutlineStream olnout;
+    QList<DiagItem> flows;
+    Udb::Obj sub = orig.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() == DiagItem::TID )
+        {
+            DiagItem di = sub;
+            const Udb::Obj subOrig = di.getOrigObject();
+            if( subOrig.getType() == Oln::OutlineItem::TID )
+                olnout.writeTo( out, subOrig );
+            else if( subOrig.getType() == ConFlow::TID )
+                flows.append( di );
+            else
+                writeObjTo02( out, subOrig, sub, strs, blocks );
+        }
+    }while( sub.next() );
+    foreach( const DiagItem& di, flows )
+    {
+        const Udb::Obj subOrig = di.getOrigObject();
+        out.startFrame( NameTag( "flow" ) );
+        out.writeSlot( subOrig.getValue( ConFlow::AttrPred ), NameTag( "from" ) );
+        out.writeSlot( subOrig.getValue( ConFlow::AttrSucc ), NameTag( "to" ) );
+        out.writeSlot( DataCell().setLob( _packNodes( di.getNodeList() ) ), NameTag( "nlst" ) );
+        out.endFrame();
+    }
+}
+
+struct _TocEntry
+{
+    DataCell d_oid;
+    DataCell d_id;
+    DataCell d_text;
+    QString d_path;
+    quint64 d_off;
+    _TocEntry( const Udb::Obj& proc = Udb::Obj() ):d_off(0)
+    {
+        if( !proc.isNull() )
+        {
+            d_oid.setOid( proc.getOid() );
+            d_id = proc.getValue( Root::AttrIdent );
+            d_text = proc.getValue( Root::AttrText );
+        }
+    }
+};
+
+static void _writeHead( Stream::DataWriter& out, const _TocEntry& e )
+{
+    out.writeSlot( e.d_oid, NameTag( "oid" ) );
+    if( e.d_id.hasValue() )
+        out.writeSlot( e.d_id, NameTag( "id" ) );
+    if( e.d_text.hasValue() )
+        out.writeSlot( e.d_text, NameTag( "text" ) );
+}
+
+static void _writeBlock( Stream::DataWriter& out, QIODevice* dev, _TocEntry e, const QByteArray& data,
+                         QList<_TocEntry>& toc )
+{
+    // data ist bereits komprimiert, falls verlangt
+    e.d_off = dev->pos();
+    out.startFrame( NameTag( "blk" ) );
+    _writeHead( out, e );
+    out.writeSlot( DataCell().setLob( data ), NameTag( "data" ) );
+    out.endFrame();
+    toc.append( e );
+}
+
+static bool _writeToc( Stream::DataWriter& out, QIODevice* dev, const QList<_TocEntry>& toc )
+{
+    const quint64 tocPos = dev->pos();
+    out.startFrame( NameTag( "toc" ) );
+    foreach( const _TocEntry& e, toc )
+    {
+        out.startFrame();
+        _writeHead( out, e );
+        out.writeSlot( DataCell().setUInt64( e.d_off ), NameTag( "off" ) );
+        if( !e.d_path.isEmpty() )
+            out.writeSlot( DataCell().setString( e.d_path ), NameTag( "path" ) );
+        out.endFrame();
+    }
+    out.endFrame();
+    uchar trailer[16];
+    ::memcpy( trailer, EpkStream::s_tocMagic, 8 );
+    qToBigEndian( tocPos, trailer + 8 );
+    return dev->write( reinterpret_cast<const char*>( trailer ), 16 ) == 16;
+}
+
+bool EpkStream::exportProc( QIODevice* dev, const Udb::Obj& proc, bool compress )
+{
+    if( dev == 0 || proc.isNull() || proc.getType() != Function::TID )
+        return false;
+    Stream::DataWriter out( dev );
+    out.writeSlot( DataCell().setAscii( "FlowLineStream" ) );
+    out.writeSlot( DataCell().setAscii( "0.2" ) );
+    out.writeSlot( DataCell().setDateTime( QDateTime::currentDateTime() ) );
+    out.writeSlot( DataCell().setUInt8( ( compress ) ? 0x1 : 0x0 ) );
+
+    QList<_TocEntry> toc;
+    QList<Udb::Obj> blocks;
+    StringTable strs;
+    Stream::DataWriter top;
+    writeObjTo02( top, proc, Udb::Obj(), strs, &blocks );
+    const QByteArray data = top.getBml().getArr();
+    _writeBlock( out, dev, _TocEntry( proc ), ( compress ) ? qCompress( data ) : data, toc );
+    foreach( const Udb::Obj& sub, blocks )
+    {
+        StringTable subStrs;
+        Stream::DataWriter body;
+        body.startFrame( NameTag( "body" ) );
+        writeBody02( body, sub, subStrs, 0 );
+        body.endFrame();
+        const QByteArray data = body.getBml().getArr();
+        _writeBlock( out, dev, _TocEntry( sub ), ( compress ) ? qCompress( data ) : data, toc );
+    }
+    return _writeToc( out, dev, toc );
+}
+
+// Momentaufnahme eines Prozesses fuer exportArchive. Enthaelt nur implizit geteilte Qt-Werte, damit sie
+// ohne Zugriff auf die Datenbank in einem Worker-Thread serialisiert werden kann.
+struct _SnapFlow
+{
+    DataCell d_from;
+    DataCell d_to;
+    QPolygonF d_nodes;
+};
+
+struct _SnapItem
+{
+    const char* d_tag;
+    DataCell d_oid;
+    DataCell d_text;
+    DataCell d_id;
+    DataCell d_ctyp;
+    DataCell d_uuid; // nur falls Ziel eines Alias
+    DataCell d_ali;
+    DataCell d_x, d_y, d_w, d_h;
+    QList<QByteArray> d_olns; // bml je eingebettetes Outline
+    QList<int> d_subs; // Index in _SnapBlock::d_items
+    QList<_SnapFlow> d_flows;
+    _SnapItem():d_tag(0) {}
+};
+
+struct _SnapBlock
+{
+    QVector<_SnapItem> d_items; // d_items[0] ist der Prozess
+    bool d_compress;
+};
+
+static int _snap( _SnapBlock& b, const Udb::Obj& orig, const Udb::Obj& diagItem )
+{
+    _SnapItem s;
+    s.d_tag = _frameTag( orig );
+    if( s.d_tag == 0 )
+        return -1;
+    s.d_oid.setOid( orig.getOid() );
+    s.d_text = orig.getValue( Root::AttrText );
+    s.d_id = orig.getValue( Root::AttrIdent );
+    s.d_ctyp = orig.getValue( Connector::AttrConnType );
+    Index::ensure( orig.getTxn(), Oln::OutlineItem::AliasIndex );
+    Udb::Idx idx( orig.getTxn(), Oln::OutlineItem::AliasIndex );
+    if( idx.seek( orig ) )
+        s.d_uuid.setUuid( orig.getUuid() );
+    if( orig.hasValue( Oln::OutlineItem::AttrAlias ) )
+        s.d_ali.setUuid( orig.getValueAsObj( Oln::OutlineItem::AttrAlias ).getUuid() );
+    if( !diagItem.isNull() )
+    {
+        s.d_x = diagItem.getValue( DiagItem::AttrPosX );
+        s.d_y = diagItem.getValue( DiagItem::AttrPosY );
+        s.d_w = diagItem.getValue( DiagItem::AttrWidth );
+        s.d_h = diagItem.getValue( DiagItem::AttrHeight );
+    }
+    const int n = b.d_items.size();
+    b.d_items.append( s );
+    Oln::OutlineStream olnout;
+    Udb::Obj sub = orig.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() == DiagItem::TID )
+        {
+            DiagItem di = sub;
+            const Udb::Obj subOrig = di.getOrigObject();
+            if( subOrig.getType() == Oln::OutlineItem::TID )
+            {
+                Stream::DataWriter w;
+                olnout.writeTo( w, subOrig );
+                s.d_olns.append( w.getBml().getArr() );
+            }else if( subOrig.getType() == ConFlow::TID )
+            {
+                _SnapFlow f;
+                f.d_from = subOrig.getValue( ConFlow::AttrPred );
+                f.d_to = subOrig.getValue( ConFlow::AttrSucc );
+                f.d_nodes = di.getNodeList();
+                s.d_flows.append( f );
+            }else
+            {
+                const int i = _snap( b, subOrig, sub );
+                if( i >= 0 )
+                    s.d_subs.append( i );
+            }
+        }
+    }while( sub.next() );
+    b.d_items[n] = s; // erst jetzt, da die Rekursion d_items veraendert
+    return n;
+}
+
+static void _writeSnap( Stream::DataWriter& out, const _SnapBlock& b, int n, QHash<QString,quint32>& strs )
+{
+    const _SnapItem& s = b.d_items[n];
+    out.startFrame( NameTag( s.d_tag ) );
+    out.writeSlot( s.d_oid, NameTag( "oid" ) );
+    if( s.d_text.hasValue() )
+        _writeString02( out, s.d_text, "text", "txtr", strs );
+    if( s.d_id.hasValue() )
+        _writeString02( out, s.d_id, "id", "idr", strs );
+    if( s.d_ctyp.hasValue() )
+        out.writeSlot( s.d_ctyp, NameTag( "ctyp" ), true );
+    if( s.d_uuid.hasValue() )
+        out.writeSlot( s.d_uuid, NameTag( "uuid" ), true );
+    if( s.d_ali.hasValue() )
+        out.writeSlot( s.d_ali, NameTag( "ali" ), true );
+    if( s.d_x.hasValue() )
+        out.writeSlot( s.d_x, NameTag( "posx" ), true );
+    if( s.d_y.hasValue() )
+        out.writeSlot( s.d_y, NameTag( "posy" ), true );
+    if( s.d_w.hasValue() )
+        out.writeSlot( s.d_w, NameTag( "w" ), true );
+    if( s.d_h.hasValue() )
+        out.writeSlot( s.d_h, NameTag( "h" ), true );
+    foreach( const QByteArray& oln, s.d_olns )
+        out.writeSlot( DataCell().setBml( oln ), NameTag( "olnb" ) );
+    foreach( int i, s.d_subs )
+        _writeSnap( out, b, i, strs );
+    foreach( const _SnapFlow& f, s.d_flows )
+    {
+        out.startFrame( NameTag( "flow" ) );
+        out.writeSlot( f.d_from, NameTag( "from" ) );
+        out.writeSlot( f.d_to, NameTag( "to" ) );
+        out.writeSlot( DataCell().setLob( _packNodes( f.d_nodes ) ), NameTag( "nlst" ) );
+        out.endFrame();
+    }
+    out.endFrame();
+}
+
+static QByteArray _serializeSnap( const _SnapBlock& b )
+{
+    // Laeuft im Worker-Thread
+    QHash<QString,quint32> strs;
+    Stream::DataWriter w;
+    _writeSnap( w, b, 0, strs );
+    const QByteArray res = w.getBml().getArr();
+    if( b.d_compress )
+        return qCompress( res );
+    else
+        return res;
+}
+
+static void _collectProcs( const Udb::Obj& o, const QString& path, QList<Udb::Obj>& procs, QStringList& paths )
+{
+    if( o.getType() == Function::TID )
+    {
+        procs.append( o );
+        paths.append( path );
+    }else if( o.getType() == FuncDomain::TID )
+    {
+        const QString sub = ( path.isEmpty() ) ? o.getString( Root::AttrText ) :
+                                                 path + QChar('/') + o.getString( Root::AttrText );
+        Udb::Obj c = o.getFirstObj();
+        if( !c.isNull() ) do
+        {
+            _collectProcs( c, sub, procs, paths );
+        }while( c.next() );
+    }
+}
+
+int EpkStream::exportArchive( QIODevice* dev, const Udb::Obj& root, bool compress )
+{
+    if( dev == 0 || root.isNull() )
+        return -1;
+    QList<Udb::Obj> procs;
+    QStringList paths;
+    _collectProcs( root, QString(), procs, paths );
+    if( procs.isEmpty() )
+        return 0;
+
+    Stream::DataWriter out( dev );
+    out.writeSlot( DataCell().setAscii( "FlowLineStream" ) );
+    out.writeSlot( DataCell().setAscii( "0.2" ) );
+    out.writeSlot( DataCell().setDateTime( QDateTime::currentDateTime() ) );
+    out.writeSlot( DataCell().setUInt8( ( ( compress ) ? 0x1 : 0x0 ) | 0x2 ) );
+    QList<_TocEntry> toc;
+    // Udb ist nicht thread-safe; die Datenbank wird deshalb nur hier im aufrufenden (GUI-)Thread gelesen.
+    // Momentaufnahmen entstehen portionenweise; waehrend die Worker eine Portion serialisieren, wird die
+    // naechste kopiert. So sind hoechstens zwei Portionen gleichzeitig im Speicher.
+    const int batch = qMax( 2, 2 * QThread::idealThreadCount() );
+    QFuture<QByteArray> f;
+    int done = 0; // Anzahl bereits geschriebener Bloecke
+    for( int start = 0; start < procs.size(); start += batch )
+    {
+        QList<_SnapBlock> blocks;
+        for( int i = start; i < qMin( start + batch, procs.size() ); i++ )
+        {
+            _SnapBlock b;
+            b.d_compress = compress;
+            _snap( b, procs[i], Udb::Obj() );
+            blocks.append( b );
+        }
+        for( int i = 0; done < start; i++, done++ ) // die vorherige Portion
+        {
+            _TocEntry e( procs[done] );
+            e.d_path = paths[done];
+            _writeBlock( out, dev, e, f.resultAt( i ), toc ); // wartet bei Bedarf auf den Worker
+        }
+        f = QtConcurrent::mapped( blocks, _serializeSnap );
+    }
+    for( int i = 0; done < procs.size(); i++, done++ )
+    {
+        _TocEntry e( procs[done] );
+        e.d_path = paths[done];
+        _writeBlock( out, dev, e, f.resultAt( i ), toc );
+    }
+    if( !_writeToc( out, dev, toc ) )
+        return -1;
+    return procs.size();
+}
+
 static inline Udb::Obj _create( const NameTag& tag, Udb::Obj& parent )
 {
     DiagItem::Kind k = DiagItem::Plain;
@@ -223,9 +857,131 @@ static quint8 _flnConnTypeTo2( const DataCell& in )
     }
 }
 
-static float _flnPosTo2( const DataCell& in )
+float EpkStream::readPos( const DataCell& in ) const
+{
+    if( d_outer != 0 )
+        return in.getFloat(); // 0.2
+    else
+        return in.getDouble();
+}
+
+DataCell EpkStream::readString( const DataCell& v, bool ref )
+{
+    if( ref )
+        return d_strings.value( v.getUInt32() );
+    if( d_outer != 0 )
+        d_strings.append( v );
+    return v;
+}
+
+bool EpkStream::readChild( Stream::DataReader& in, Udb::Obj& orig, int level )
+{
+    // in steht vor einem BeginFrame (nextToken(true))
+    const NameTag n = in.getName().getTag();
+    if( n.equals( "oln" ) )
+    {
+        // olns.readFrom konsumiert final das Token
+       // qDebug() << QString(level*4,QChar('*')) << "Frame" << n.toString(); // TEST
+        Oln::OutlineStream olns;
+        Udb::Obj oln = olns.readFrom( in, orig.getTxn(), orig.getOid() );
+        if( oln.isNull() )
+        {
+            d_error = QString( "invalid embedded outline" );
+            return false;
+        }
+        oln.aggregateTo( orig );
+    }else if( n.equals( "flow" ) )
+    {
+        in.nextToken(); // bestaetige nextToken
+        readFlow( in, orig, level + 1 );
+    }else if( orig.getType() == Function::TID )
+    {
+        // Lese die Objekte ausser Flow, die in einem Process enthalten sein koennen
+        in.nextToken(); // bestaetige nextToken
+        quint64 remoteOid = 0;
+        Udb::Obj sub = readItem( in, orig, &remoteOid, level + 1 );
+        if( sub.isNull() && !d_error.isEmpty() )
+            return false; // Fehler oder Abbruch
+        // else ignore; readItem hat bereits ganzes Frame konsumiert
+    }else
+    {
+        d_error = QString( "invalid frame '%1' in oid=%2" ).arg( n.toString() ).arg( orig.getOid() );
+        return false;
+    }
+    return true;
+}
+
+bool EpkStream::readBlockData( QByteArray& data, DataCell* text, DataCell* id )
+{
+    Q_ASSERT( d_outer != 0 );
+    if( d_outer->nextToken() != DataReader::BeginFrame || !d_outer->getName().getTag().equals( "blk" ) )
+    {
+        d_error = "invalid block";
+        return false;
+    }
+    DataReader::Token t = d_outer->nextToken();
+    while( t == DataReader::Slot )
+    {
+        const NameTag n = d_outer->getName().getTag();
+        if( n.equals( "data" ) )
+            data = d_outer->getValue().getArr();
+        else if( text != 0 && n.equals( "text" ) )
+            *text = d_outer->getValue();
+        else if( id != 0 && n.equals( "id" ) )
+            *id = d_outer->getValue();
+        t = d_outer->nextToken();
+    }
+    if( t != DataReader::EndFrame || data.isEmpty() )
+    {
+        d_error = "invalid block";
+        return false;
+    }
+    if( d_compressed )
+    {
+        data = qUncompress( data );
+        if( data.isEmpty() )
+        {
+            d_error = "invalid compressed block";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EpkStream::readSubBlock( Udb::Obj& orig, int level )
 {
-    return in.getDouble();
+    QByteArray data;
+    if( !readBlockData( data ) )
+        return false;
+    const DataCell cell = DataCell().setBml( data );
+    DataReader in( cell );
+    if( in.nextToken() != DataReader::BeginFrame || !in.getName().getTag().equals( "body" ) )
+    {
+        d_error = "invalid block";
+        return false;
+    }
+    return readBody( in, orig, level );
+}
+
+bool EpkStream::readBody( Stream::DataReader& in, Udb::Obj& orig, int level )
+{
+    // 'body' ist bereits gelesen
+    const QList<DataCell> strings = d_strings; // jeder Block hat seine eigene Tabelle
+    d_strings.clear();
+    bool ok = true;
+    DataReader::Token t = in.nextToken( true );
+    while( ok && t == DataReader::BeginFrame )
+    {
+        ok = readChild( in, orig, level );
+        t = in.nextToken( true );
+    }
+    if( ok && t != DataReader::EndFrame )
+    {
+        d_error = "invalid block";
+        ok = false;
+    }
+    d_strings = strings;
+    return ok;
 }
 
 Udb::Obj EpkStream::readItem( Stream::DataReader& in, Udb::Obj& parent, quint64* remoteOid, int level )
@@ -242,6 +998,8 @@ Udb::Obj EpkStream::readItem( Stream::DataReader& in, Udb::Obj& parent, quint64*
         return Udb::Obj();
 	}
     Q_ASSERT( !orig.isNull() );
+    if( !created( orig ) )
+        return Udb::Obj();
     // orig.getType() ist Function, Event oder Connector, oder Aber DiagItem bei Notes und Frames
     DiagItem di;
     if( remoteOid != 0 ) // nur bei Top-Level-Call der Fall
@@ -252,8 +1010,6 @@ Udb::Obj EpkStream::readItem( Stream::DataReader& in, Udb::Obj& parent, quint64*
             di = orig;
     }
 
-	QHash<quint64,Udb::Obj> subs;
-	Oln::OutlineStream olns;
     Stream::DataReader::Token t = in.nextToken( true ); // Schaue eine Stelle voraus
 	// t kann sein: Slot, EndFrame, Start von Embedded oder Outline
 	while( Stream::DataReader::isUseful( t ) )
@@ -265,73 +1021,72 @@ Udb::Obj EpkStream::readItem( Stream::DataReader& in, Udb::Obj& parent, quint64*
 				in.nextToken(); // besttige nextToken
 				const NameTag n = in.getName().getTag();
                // qDebug() << QString(level*4,QChar(' ')) << "Slot" << n.toString() << in.getValue().toPrettyString(); // TEST
-				if( n.equals( "text" ) )
-                    orig.setValue( Root::AttrText, in.getValue() );
-				else if( n.equals( "id" ) )
+				if( n.equals( "text" ) || n.equals( "txtr" ) )
+                    orig.setValue( Root::AttrText, readString( in.getValue(), n.equals( "txtr" ) ) );
+				else if( n.equals( "id" ) || n.equals( "idr" ) )
 				{
+                    const DataCell v = readString( in.getValue(), n.equals( "idr" ) );
                     if( !orig.hasValue( Root::AttrIdent ) )
-                        orig.setValue( Root::AttrIdent, in.getValue() );
+                        orig.setValue( Root::AttrIdent, v );
                     else
-                        orig.setValue( Root::AttrAltIdent, in.getValue() );
-                }else if( n.equals( "oid" ) && remoteOid )
-                    *remoteOid = in.getValue().getOid();
+                        orig.setValue( Root::AttrAltIdent, v );
+                }else if( n.equals( "oid" ) )
+                {
+                    d_remote[ in.getValue().getOid() ] = orig.getOid();
+                    if( remoteOid )
+                    {
+                        // Direktes Element von parent; siehe toLocal
+                        *remoteOid = in.getValue().getOid();
+                        d_levels[ parent.getOid() ][ *remoteOid ] = orig.getOid();
+                    }
+                }else if( n.equals( "uuid" ) )
+                    d_targets[ in.getValue().getUuid() ] = orig.getOid();
                 else if( n.equals( "posx" ) && !di.isNull() )
-                    di.setValue( DiagItem::AttrPosX, DataCell().setFloat(_flnPosTo2(in.getValue())) );
+                    di.setValue( DiagItem::AttrPosX, DataCell().setFloat(readPos(in.getValue())) );
                 else if( n.equals( "posy" ) && !di.isNull() )
-                    di.setValue( DiagItem::AttrPosY, DataCell().setFloat(_flnPosTo2(in.getValue())) );
+                    di.setValue( DiagItem::AttrPosY, DataCell().setFloat(readPos(in.getValue())) );
                 else if( n.equals( "w" ) && !di.isNull() )
-                    di.setValue( DiagItem::AttrWidth, DataCell().setFloat(_flnPosTo2(in.getValue())) );
+                    di.setValue( DiagItem::AttrWidth, DataCell().setFloat(readPos(in.getValue())) );
                 else if( n.equals( "h" ) && !di.isNull() )
-                    di.setValue( DiagItem::AttrHeight, DataCell().setFloat(_flnPosTo2(in.getValue())) );
+                    di.setValue( DiagItem::AttrHeight, DataCell().setFloat(readPos(in.getValue())) );
 				else if( n.equals( "ctyp" ) )
                     orig.setValue( Connector::AttrConnType, DataCell().setUInt8( _flnConnTypeTo2( in.getValue() ) ) );
 				else if( n.equals( "ali" ) )
 				{
-					Udb::Obj a = parent.getTxn()->getObject( in.getValue() );
-					// TODO: was wenn a Teil des Streams ist und noch nicht instanziiert?
-                    orig.setValue( Oln::OutlineItem::AttrAlias, a );
-				}
+                    // a kann Teil des Streams und noch nicht instanziiert sein; siehe resolveFixups
+                    AliasFixup f;
+                    f.d_obj = orig.getOid();
+                    f.d_target = in.getValue().getUuid();
+                    d_aliases.append( f );
+				}else if( n.equals( "olnb" ) )
+                {
+                    const DataCell bml = in.getValue();
+                    DataReader r( bml );
+                    r.nextToken( true );
+                    Oln::OutlineStream olns;
+                    Udb::Obj oln = olns.readFrom( r, orig.getTxn(), orig.getOid() );
+                    if( oln.isNull() )
+                    {
+                        d_error = QString( "invalid embedded outline" );
+                        return Udb::Obj();
+                    }
+                    oln.aggregateTo( orig );
+                }else if( n.equals( "blk" ) && d_outer != 0 )
+                {
+                    // Inhalt steht im naechsten Block der Datei
+                    if( !readSubBlock( orig, level ) )
+                        return Udb::Obj();
+                }
 			}
 			break;
 		case Stream::DataReader::EndFrame:
 			in.nextToken(); // besttige nextToken
+            if( orig.getType() == Function::TID )
+                resolveFlows( orig );
             return orig;
 		case Stream::DataReader::BeginFrame:
-			{
-				const NameTag n = in.getName().getTag();
-				if( n.equals( "oln" ) )
-				{
-					// olns.readFrom konsumiert final das Token
-                   // qDebug() << QString(level*4,QChar('*')) << "Frame" << n.toString(); // TEST
-					Udb::Obj oln = olns.readFrom( in, orig.getTxn(), orig.getOid() );
-					if( oln.isNull() )
-					{
-						d_error = QString( "invalid embedded outline" );
-						return Udb::Obj();
-					}
-                    oln.aggregateTo( orig );
-				}else if( n.equals( "flow" ) )
-				{
-					in.nextToken(); // besttige nextToken
-                    readFlow( in, orig, subs, level + 1 );
-                }else if( orig.getType() == Function::TID )
-				{
-					// Lese die Objekte ausser Flow, die in einem Process enthalten sein knnen
-					in.nextToken(); // besttige nextToken
-                    quint64 remoteOid = 0;
-                    Udb::Obj sub = readItem( in, orig, &remoteOid, level + 1 );
-                    if( !sub.isNull() && remoteOid != 0 )
-                    {
-                        subs[ remoteOid ] = sub;
-                       // qDebug() << "Remote" << remoteOid << "Local" << sub.getOid();
-                    }
-                    // else ignore; readItem hat bereits ganzes Frame konsumiert
-				}else
-				{
-                    d_error = QString( "invalid frame '%1' in oid=%2" ).arg( n.toString() ).arg( *remoteOid );
-					return Udb::Obj();
-				}
-			}
+            if( !readChild( in, orig, level ) )
+                return Udb::Obj();
 			break;
 		} // switch
 		t = in.nextToken(true);
@@ -367,25 +1122,26 @@ static QPolygonF _flnNodesTo2( const DataCell& in )
     return res;
 }
 
-Udb::Obj EpkStream::readFlow( Stream::DataReader& in, Udb::Obj& parent,
-                              const QHash<quint64,Udb::Obj>& objs, int level )
+Udb::Obj EpkStream::readFlow( Stream::DataReader& in, Udb::Obj& parent, int level )
 {
     Q_ASSERT( in.getCurrentToken() == Stream::DataReader::BeginFrame && in.getName().getTag().equals("flow") );
     Q_ASSERT( !parent.isNull() );
     // Voraussetzung: 'in' sitzt auf einem BeginFrame, das nicht ein Flow ist.
     // qDebug() << QString(level*4,QChar('*')) << "Frame" << in.getName().toString(); // TEST
     Stream::DataReader::Token t = in.nextToken();
-    Udb::Obj from;
-    Udb::Obj to;
+    quint64 from = 0;
+    quint64 to = 0;
     QPolygonF nodes;
     while( t == Stream::DataReader::Slot )
     {
         const NameTag n = in.getName().getTag();
        //qDebug() << QString(level*4,QChar(' ')) << "Slot" << n.toString() << in.getValue().toPrettyString(); // TEST
         if( n.equals( "from" ) )
-            from = objs.value( in.getValue().getOid() );
+            from = in.getValue().getOid();
         else if( n.equals( "to" ) )
-            to = objs.value( in.getValue().getOid() );
+            to = in.getValue().getOid();
+        else if( n.equals( "nlst" ) && d_outer != 0 )
+            nodes = _unpackNodes( in.getValue().getArr() ); // 0.2
         else if( n.equals( "nlst" ) )
             nodes = _flnNodesTo2(in.getValue());
         t = in.nextToken();
@@ -396,12 +1152,25 @@ Udb::Obj EpkStream::readFlow( Stream::DataReader& in, Udb::Obj& parent,
         return Udb::Obj();
     }
     //qDebug() << QString(level*4,QChar(' ')) << "Diag" << parent.getOid() << "from" << from.getOid() << "to" << to.getOid(); // TEST
-    if( !from.isNull() && !to.isNull() )
+    // Sofort nur, wenn beide Enden bereits in diesem Prozess stehen; gleiche remote OIDs aus anderen
+    // Prozessen (Aliasse als Kopien) duerfen hier nicht gewinnen
+    const QHash<quint64,Udb::OID> local = d_levels.value( parent.getOid() );
+    if( local.contains( from ) && local.contains( to ) )
     {
-        DiagItem di = DiagItem::createLink( parent, from, to );
+        DiagItem di = DiagItem::createLink( parent, parent.getObject( local.value( from ) ),
+                                            parent.getObject( local.value( to ) ) );
         di.setNodeList( nodes );
        // qDebug() << QString(level*4,QChar(' ')) << "Fln2 Nodes" << nodes;
         return di.getOrigObject();
+    }else if( from != 0 && to != 0 )
+    {
+        // Ein Ende steht erst spaeter im Stream
+        FlowFixup f;
+        f.d_diagram = parent.getOid();
+        f.d_from = from;
+        f.d_to = to;
+        f.d_nodes = nodes;
+        d_flows.append( f );
     }
     return Udb::Obj();
 }
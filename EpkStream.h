@@ -24,6 +24,10 @@
 #include <Stream/DataWriter.h>
 #include <Udb/Obj.h>
 #include <Udb/Transaction.h>
+#include <QMap>
+#include <QPolygonF>
+
+class QIODevice;
 
 namespace Epk
 {
@@ -37,6 +41,39 @@ namespace Epk
 				Slot <DateTime> = now
 				[ Internal Format ]
 		*/
+		/* External Format 0.2
+
+				Slot <ascii> = "FlowLineStream"
+				Slot <ascii> = "0.2"
+				Slot <DateTime> = now
+				Slot <uint8> = Flags // 0x1..Bloecke mit qCompress komprimiert, 0x2..Archiv (siehe unten)
+				Sequence of
+					Frame 'blk' // Block 0: der exportierte proc; danach je ein Block pro direktem Sub-proc
+						Slot 'oid' = <oid>
+						[ Slot 'id' = <string> ]
+						[ Slot 'text' = <string> ]
+						Slot 'data' = <lob> // Internal Format 0.2, ev. komprimiert
+				Frame 'toc'
+					Sequence of
+						Frame
+							Slot 'oid' = <oid>
+							[ Slot 'id' = <string> ]
+							[ Slot 'text' = <string> ]
+							Slot 'off' = <uint64> // Position des 'blk' Frames in der Datei
+							[ Slot 'path' = <string> ] // nur Archiv: Domains oberhalb des Prozesses
+				Trailer: 8 Bytes s_tocMagic, 8 Bytes Position des 'toc' Frames (big endian)
+		*/
+		/* Internal Format 0.2 (Unterschiede zu 0.1)
+
+			Block 0 enthaelt ein 'proc' Frame, Bloecke > 0 ein Frame 'body' mit dem Inhalt eines Sub-proc.
+			Ein Sub-proc in Block 0 enthaelt anstelle des Inhalts Slot 'blk' = <uint32> (Blocknummer);
+			die Bloecke folgen in der Reihenfolge, in der sie referenziert werden.
+			Jeder Block hat eine eigene Stringtabelle fuer 'text' und 'id': die erste Verwendung steht als
+			String, jede weitere als Slot 'txtr' bzw. 'idr' = <uint32> (Index in der Tabelle).
+			'posx', 'posy', 'w' und 'h' sind <float>, 'nlst' ist <lob> mit x/y als float (big endian).
+			Bei einem Archiv (exportArchive) enthaelt jeder Block einen vollstaendigen, unabhaengigen Prozess
+			ohne ausgelagerte Sub-procs; eingebettete Outlines stehen dort als Slot 'olnb' = <bml>.
+		*/
 		/* Internal Format (names as Tags)
 
 		Sequence of
@@ -51,28 +88,92 @@ namespace Epk
 						Slot 'w'	= <double>
 						Slot 'h'	= <double>
 						Slot 'ctyp'	= <uint8>
-						[ Slot 'ali' = <uuid>
+						[ Slot 'uuid' = <uuid> ] // nur falls Ziel eines Alias
+						[ Slot 'ali' = <uuid> ] // darf auf ein spaeteres Objekt im Stream zeigen
 						[ OutlineStream Internal Format ]
 
 						[ Block ]* // falls proc, rekursiv
 
 				Sequence of 
 					Frame 'flow'
-						Slot 'from' = <oid>
+						Slot 'from' = <oid> // darf auch spaeter im Stream stehen
 						Slot 'to' = <oid>
 						Slot 'nlst' = <bml>						
 
 		*/
 
-        static void exportProc( Stream::DataWriter&, const Udb::Obj& proc ); // kann Uuid erzeugen
+        EpkStream():d_outer(0),d_compressed(false),d_batchSize(0),d_count(0) {}
+        virtual ~EpkStream() {}
+        static const char* s_tocMagic;
+        static void exportProc( Stream::DataWriter&, const Udb::Obj& proc ); // Format 0.1; kann Uuid erzeugen
+        static bool exportProc( QIODevice*, const Udb::Obj& proc, bool compress = true ); // Format 0.2; dito
+        // Alle Functions unterhalb einer FuncDomain (oder eine einzelne Function) je als eigenen Block.
+        // Alles Lesen aus der Datenbank bleibt im aufrufenden GUI-Thread und blockiert diesen; nur das
+        // Serialisieren und Komprimieren der Momentaufnahmen laeuft im Thread-Pool von QtConcurrent
+        // (keine Worker-Prozesse). Kann Uuids erzeugen.
+        static int exportArchive( QIODevice*, const Udb::Obj& root, bool compress = true );
 		const QString& getError() const { return d_error; }
         Udb::Obj importProc( Stream::DataReader&, Udb::Obj& parent );
+        // Importiert in eine Staging-Domain und committed alle BatchSize Objekte; erst am Schluss wird
+        // der Prozess nach parent verschoben. Bei Fehler oder Abbruch wird die Staging-Domain geloescht.
+        // Committed bzw. rollbacked selber.
+        Udb::Obj importProcStaged( Stream::DataReader&, Udb::Obj& parent );
+        // Importiert einen einzelnen Block > 0 eines 0.2-Streams als neue Function in parent, bzw.
+        // bei einem Archiv einen beliebigen Block; in steht vor dem 'blk' Frame. Kein Commit.
+        Udb::Obj importBlock( Stream::DataReader& in, bool compressed, Udb::Obj& parent );
+        void setBatchSize( int n ) { d_batchSize = n; } // 0..kein Zwischen-Commit
+        int getCount() const { return d_count; } // Anzahl bisher erzeugter Objekte
+    protected:
+        virtual bool progress( int count ) { Q_UNUSED(count); return true; } // false..Abbruch
 	private:
         static void writeObjTo( Stream::DataWriter&, const Udb::Obj& orig, const Udb::Obj &diagItem );
         Udb::Obj readItem( Stream::DataReader&, Udb::Obj& parent, quint64* remoteOid = 0, int level = 0 );
-        Udb::Obj readFlow( Stream::DataReader&, Udb::Obj& parent, const QHash<quint64, Udb::Obj> &objs, int level );
+        Udb::Obj readFlow( Stream::DataReader&, Udb::Obj& parent, int level );
         static void writeAtts( Stream::DataWriter&, const Udb::Obj& orig, const Udb::Obj& diagItem );
+        typedef QHash<QString,quint32> StringTable;
+        static void writeObjTo02( Stream::DataWriter&, const Udb::Obj& orig, const Udb::Obj &diagItem,
+                                  StringTable&, QList<Udb::Obj>* blocks );
+        static void writeBody02( Stream::DataWriter&, const Udb::Obj& orig, StringTable&, QList<Udb::Obj>* blocks );
+        static void writeAtts02( Stream::DataWriter&, const Udb::Obj& orig, const Udb::Obj& diagItem, StringTable& );
+        bool readChild( Stream::DataReader&, Udb::Obj& orig, int level );
+        bool readBlockData( QByteArray&, Stream::DataCell* text = 0, Stream::DataCell* id = 0 );
+        bool readSubBlock( Udb::Obj& orig, int level );
+        bool readBody( Stream::DataReader&, Udb::Obj& orig, int level );
+        void reset();
+        float readPos( const Stream::DataCell& ) const;
+        Stream::DataCell readString( const Stream::DataCell&, bool ref );
+        bool created( const Udb::Obj& );
+        void resolveFixups( Udb::Transaction* );
+        void resolveFlows( const Udb::Obj& diagram );
+        struct AliasFixup
+        {
+            Udb::OID d_obj;
+            QUuid d_target;
+        };
+        struct FlowFixup
+        {
+            Udb::OID d_diagram;
+            quint64 d_from; // remote
+            quint64 d_to;   // remote
+            QPolygonF d_nodes;
+        };
+        bool createFlow( Udb::Transaction*, const FlowFixup& );
+        Udb::OID toLocal( Udb::OID diagram, quint64 remote ) const;
+        // Vorwaertsreferenzen innerhalb eines Prozesses werden an dessen Ende aufgeloest, die uebrigen am
+        // Ende des Imports. Ein Element, das in mehreren Prozessen erscheint, steht mit derselben remote OID
+        // mehrfach im Stream; Flows werden deshalb zuerst gegen die Elemente des eigenen Prozesses
+        // (d_levels, lebt nur bis zu dessen Ende) aufgeloest und nur sonst ueber d_remote.
+        QHash<quint64,Udb::OID> d_remote; // remote OID -> lokale OID, ueber den ganzen Stream, letzte gilt
+        QHash<Udb::OID,QHash<quint64,Udb::OID> > d_levels; // offene Prozesse -> remote OID -> lokale OID
+        QMap<QUuid,Udb::OID> d_targets;   // 'uuid' -> lokale OID
+        QList<AliasFixup> d_aliases;
+        QList<FlowFixup> d_flows;
+        QList<Stream::DataCell> d_strings; // Stringtabelle des aktuellen Blocks (0.2)
+        Stream::DataReader* d_outer;      // Datei bei 0.2, sonst 0
+        bool d_compressed;
 		QString d_error;
+        int d_batchSize;
+        int d_count;
 	};
 }
 
@@ -0,0 +1,435 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkSvgWriter.h"
+#include "EpkObjects.h"
+#include "EpkProcs.h"
+#include <QXmlStreamWriter>
+#include <QFontMetricsF>
+#include <QFontInfo>
+#include <QStringList>
+#include <QLineF>
+using namespace Epk;
+
+static inline QString _num( qreal v )
+{
+    return QString::number( v, 'f', 1 );
+}
+
+static QString _points( const QPolygonF& p )
+{
+    QString res;
+    for( int i = 0; i < p.size(); i++ )
+    {
+        if( i > 0 )
+            res += QLatin1Char( ' ' );
+        res += _num( p[i].x() ) + QLatin1Char( ',' ) + _num( p[i].y() );
+    }
+    return res;
+}
+
+static QPolygonF _eventShape()
+{
+    // Entspricht EpkNode::toPolygon
+    const qreal w = DiagItem::s_boxWidth;
+    const qreal h = DiagItem::s_boxHeight;
+    const qreal i = DiagItem::s_boxInset;
+    QPolygonF p;
+    p << QPointF( 0, h * 0.5 ) << QPointF( i, 0 ) << QPointF( w - i, 0 ) << QPointF( w, h * 0.5 ) <<
+         QPointF( w - i, h ) << QPointF( i, h ) << QPointF( 0, h * 0.5 );
+    p.translate( -w * 0.5, -h * 0.5 );
+    return p;
+}
+
+static QPolygonF _outline( quint32 type )
+{
+    // Umriss fuer das Abschneiden der Flows am Ziel
+    if( type == Event::TID )
+        return _eventShape();
+    if( type == Connector::TID )
+    {
+        const qreal rad = DiagItem::s_circleDiameter / 2.0;
+        const qreal len2 = 0.83 * rad * 0.5;
+        QPolygonF p;
+        p << QPointF( -rad, -len2) << QPointF( -len2, -rad) << QPointF( len2, -rad) << QPointF( rad, -len2) <<
+             QPointF( rad, len2) << QPointF( len2, rad) << QPointF( -len2, rad) << QPointF( -rad, len2) <<
+             QPointF( -rad, -len2);
+        return p;
+    }
+    return QPolygonF( QRectF( -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
+                              DiagItem::s_boxWidth, DiagItem::s_boxHeight ) );
+}
+
+static QStringList _wrap( const QFontMetricsF& fm, const QString& text, qreal width )
+{
+    QStringList res;
+    foreach( const QString& para, text.split( QLatin1Char( '\n' ) ) )
+    {
+        QString line;
+        foreach( const QString& word, para.split( QLatin1Char( ' ' ), QString::SkipEmptyParts ) )
+        {
+            const QString cand = line.isEmpty() ? word : line + QLatin1Char( ' ' ) + word;
+            if( !line.isEmpty() && fm.width( cand ) > width )
+            {
+                res.append( line );
+                line = word;
+            }else
+                line = cand;
+        }
+        res.append( line );
+    }
+    return res;
+}
+
+EpkSvgWriter::EpkSvgWriter(const QFont & f):d_font(f),d_showId(false),d_markAlias(false)
+{
+}
+
+bool EpkSvgWriter::write(QIODevice * dev, const Udb::Obj & diagram)
+{
+    if( diagram.isNull() )
+        return false;
+    // Erster Durchgang: Positionen und Ausdehnung
+    d_nodes.clear();
+    QRectF bound;
+    Udb::Obj sub = diagram.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() != DiagItem::TID )
+            continue;
+        DiagItem item = sub;
+        const Udb::Obj orig = item.getOrigObject();
+        if( orig.isNull( true ) )
+            continue;
+        if( orig.getType() == ConFlow::TID )
+        {
+            const QPolygonF nl = item.getNodeList();
+            if( !nl.isEmpty() )
+                bound |= nl.boundingRect();
+            continue;
+        }
+        Node n;
+        n.d_pos = item.getPos();
+        n.d_type = orig.getType();
+        n.d_alias = !diagram.equals( orig.getParent() );
+        d_nodes[orig.getOid()] = n;
+        if( item.getKind() != DiagItem::Plain )
+            bound |= QRectF( n.d_pos, item.getSize() );
+        else
+            bound |= QRectF( n.d_pos - QPointF( DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 ),
+                             QSizeF( DiagItem::s_boxWidth, DiagItem::s_boxHeight ) );
+    }while( sub.next() );
+    bound.adjust( -DiagItem::s_boxWidth * 0.5, -DiagItem::s_boxHeight * 0.5,
+                  DiagItem::s_boxWidth * 0.5, DiagItem::s_boxHeight * 0.5 );
+
+    QXmlStreamWriter out( dev );
+    out.setAutoFormatting( true );
+    out.setAutoFormattingIndent( 1 );
+    out.writeStartDocument();
+    out.writeStartElement( "svg" );
+    out.writeDefaultNamespace( "http://www.w3.org/2000/svg" );
+    out.writeNamespace( "http://www.w3.org/1999/xlink", "xlink" );
+    out.writeAttribute( "version", "1.1" );
+    out.writeAttribute( "width", _num( bound.width() ) );
+    out.writeAttribute( "height", _num( bound.height() ) );
+    out.writeAttribute( "viewBox", QString( "%1 %2 %3 %4" ).arg( _num( bound.left() ) ).arg( _num( bound.top() ) ).
+                        arg( _num( bound.width() ) ).arg( _num( bound.height() ) ) );
+    out.writeTextElement( "title", diagram.getString( Root::AttrText ) );
+    writeStyle( out );
+    writeDefs( out );
+
+    // Frames zuunterst, dann Flows, dann Nodes; wie die Z-Order in der Szene
+    for( int pass = 0; pass < 3; pass++ )
+    {
+        out.writeStartElement( "g" );
+        sub = diagram.getFirstObj();
+        if( !sub.isNull() ) do
+        {
+            if( sub.getType() != DiagItem::TID )
+                continue;
+            DiagItem item = sub;
+            const Udb::Obj orig = item.getOrigObject();
+            if( orig.isNull( true ) )
+                continue;
+            const bool isFrame = item.getKind() == DiagItem::Frame;
+            const bool isLink = orig.getType() == ConFlow::TID;
+            if( pass == 0 && isFrame )
+                writeNode( out, item, orig, diagram );
+            else if( pass == 1 && isLink )
+                writeLink( out, item, orig );
+            else if( pass == 2 && !isFrame && !isLink )
+                writeNode( out, item, orig, diagram );
+        }while( sub.next() );
+        out.writeEndElement(); // g
+    }
+    out.writeEndElement(); // svg
+    out.writeEndDocument();
+    d_nodes.clear();
+    return !out.hasError();
+}
+
+void EpkSvgWriter::writeStyle(QXmlStreamWriter & out)
+{
+    const QString pen = _num( DiagItem::s_penWidth );
+    const QFontInfo fi( d_font );
+    QString css;
+    css += QString( "text{font-family:'%1';font-size:%2px}\n" ).arg( fi.family() ).arg( fi.pixelSize() );
+    css += QString( ".f{fill:#96ff00;stroke:#47b300;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".p{fill:#ddd09b;stroke:#8c7821;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".e{fill:#ffb207;stroke:#b36205;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".c{fill:#d0d0d0;stroke:#676767;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".cs{fill:#c4f679;stroke:#000;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".cf{fill:#f67979;stroke:#000;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".a{fill:#f0f0f0;stroke:#c0c0c0;stroke-width:%1}\n" ).arg( pen );
+    css += QString( ".l{fill:none;stroke:#000;stroke-width:%1;marker-end:url(#arrow)}\n" ).arg( pen );
+    css += QString( ".la{fill:none;stroke:#808080;stroke-width:%1;marker-end:url(#arrowa)}\n" ).arg( pen );
+    css += ".n{fill:#f0f0f0;stroke:none}\n";
+    css += QString( ".r{fill:#fafafa;stroke:#a0a0a4;stroke-width:%1}\n" ).arg( pen );
+    css += ".ta{fill:#808080}\n";
+    css += ".tc{font-size:8px}\n";
+    css += ".tr{font-weight:bold}\n";
+    css += ".id{fill:#00f;font-weight:bold}\n";
+    out.writeStartElement( "style" );
+    out.writeAttribute( "type", "text/css" );
+    out.writeCharacters( css );
+    out.writeEndElement();
+}
+
+void EpkSvgWriter::writeDefs(QXmlStreamWriter & out)
+{
+    const qreal w = DiagItem::s_boxWidth;
+    const qreal h = DiagItem::s_boxHeight;
+    const qreal r = DiagItem::s_radius;
+    const qreal m = DiagItem::s_textMargin;
+    out.writeStartElement( "defs" );
+
+    out.writeEmptyElement( "rect" );
+    out.writeAttribute( "id", "fn" );
+    out.writeAttribute( "x", _num( -w * 0.5 ) );
+    out.writeAttribute( "y", _num( -h * 0.5 ) );
+    out.writeAttribute( "width", _num( w ) );
+    out.writeAttribute( "height", _num( h ) );
+    out.writeAttribute( "rx", _num( r ) );
+
+    out.writeStartElement( "g" );
+    out.writeAttribute( "id", "proc" );
+    out.writeEmptyElement( "use" );
+    out.writeAttribute( "xlink:href", "#fn" );
+    out.writeEmptyElement( "rect" );
+    out.writeAttribute( "x", _num( -w * 0.5 + m ) );
+    out.writeAttribute( "y", _num( -h * 0.5 + m ) );
+    out.writeAttribute( "width", _num( w - 2.0 * m ) );
+    out.writeAttribute( "height", _num( h - 2.0 * m ) );
+    out.writeAttribute( "rx", _num( r - m ) );
+    out.writeEndElement(); // g
+
+    out.writeEmptyElement( "polygon" );
+    out.writeAttribute( "id", "ev" );
+    out.writeAttribute( "points", _points( _eventShape() ) );
+
+    out.writeEmptyElement( "circle" );
+    out.writeAttribute( "id", "con" );
+    out.writeAttribute( "r", _num( h * 0.25 ) );
+
+    // Pfeilspitze wie LineSegment::paint, Groesse 10 in Szenen-Koordinaten
+    for( int i = 0; i < 2; i++ )
+    {
+        out.writeStartElement( "marker" );
+        out.writeAttribute( "id", ( i == 0 ) ? "arrow" : "arrowa" );
+        out.writeAttribute( "markerUnits", "userSpaceOnUse" );
+        out.writeAttribute( "markerWidth", "10" );
+        out.writeAttribute( "markerHeight", "10" );
+        out.writeAttribute( "viewBox", "0 -5 10 10" );
+        out.writeAttribute( "refX", "10" );
+        out.writeAttribute( "refY", "0" );
+        out.writeAttribute( "orient", "auto" );
+        out.writeEmptyElement( "polygon" );
+        out.writeAttribute( "points", "0,-5 10,0 0,5" );
+        out.writeAttribute( "fill", ( i == 0 ) ? "#000" : "#808080" );
+        out.writeEndElement(); // marker
+    }
+    out.writeEndElement(); // defs
+}
+
+void EpkSvgWriter::writeText(QXmlStreamWriter & out, const QRectF & r, const QString & text,
+                             bool center, const char* cls )
+{
+    if( text.isEmpty() )
+        return;
+    const QFontMetricsF fm( d_font );
+    QStringList lines = _wrap( fm, text, r.width() );
+    const int max = qMax( 1, int( r.height() / fm.lineSpacing() ) );
+    if( lines.size() > max )
+    {
+        lines = lines.mid( 0, max );
+        lines.last() += QLatin1String( "..." );
+    }
+    const qreal height = lines.size() * fm.lineSpacing();
+    qreal y = r.top() + fm.ascent();
+    if( center && height < r.height() )
+        y += ( r.height() - height ) * 0.5;
+    out.writeStartElement( "text" );
+    if( cls )
+        out.writeAttribute( "class", cls );
+    if( center )
+        out.writeAttribute( "text-anchor", "middle" );
+    const QString x = _num( ( center ) ? r.center().x() : r.left() );
+    for( int i = 0; i < lines.size(); i++ )
+    {
+        out.writeStartElement( "tspan" );
+        out.writeAttribute( "x", x );
+        out.writeAttribute( "y", _num( y + i * fm.lineSpacing() ) );
+        out.writeCharacters( lines[i] );
+        out.writeEndElement();
+    }
+    out.writeEndElement(); // text
+}
+
+void EpkSvgWriter::writeNode(QXmlStreamWriter & out, const Udb::Obj & obj, const Udb::Obj & orig,
+                             const Udb::Obj & diagram)
+{
+    DiagItem item = obj;
+    const QPointF pos = item.getPos();
+    const quint32 type = orig.getType();
+    const bool alias = d_markAlias && ( type == Function::TID || type == Event::TID ) &&
+            !diagram.equals( orig.getParent() );
+    const qreal m = DiagItem::s_textMargin;
+    const QString text = orig.getString( Root::AttrText );
+    if( type == DiagItem::TID )
+    {
+        const QRectF r( pos, item.getSize() );
+        const bool frame = item.getKind() == DiagItem::Frame;
+        out.writeEmptyElement( "rect" );
+        out.writeAttribute( "class", ( frame ) ? "r" : "n" );
+        out.writeAttribute( "x", _num( r.x() ) );
+        out.writeAttribute( "y", _num( r.y() ) );
+        out.writeAttribute( "width", _num( r.width() ) );
+        out.writeAttribute( "height", _num( r.height() ) );
+        if( frame )
+        {
+            out.writeAttribute( "rx", _num( DiagItem::s_radius ) );
+            writeText( out, r.adjusted( 2.0 * m, m, -m, -m ), text, false, "tr" );
+        }else
+            writeText( out, r.adjusted( m, m, 0, 0 ), text, false, 0 );
+        return;
+    }
+    const char* href = "#fn";
+    const char* cls = "f";
+    QRectF textRect( pos.x() - DiagItem::s_boxWidth * 0.5 + m, pos.y() - DiagItem::s_boxHeight * 0.5 + m,
+                     DiagItem::s_boxWidth - 2.0 * m, DiagItem::s_boxHeight - 2.0 * m );
+    if( type == Function::TID )
+    {
+        if( orig.getValue( Function::AttrElemCount ).getUInt32() > 0 )
+        {
+            href = "#proc";
+            cls = "p";
+        }
+    }else if( type == Event::TID )
+    {
+        href = "#ev";
+        cls = "e";
+        textRect.adjust( DiagItem::s_boxInset - m, 0, -DiagItem::s_boxInset + m, 0 );
+    }else if( type == Connector::TID )
+    {
+        href = "#con";
+        const quint8 code = orig.getValue( Connector::AttrConnType ).getUInt8();
+        cls = ( code == Connector::Start ) ? "cs" : ( code == Connector::Finish ) ? "cf" : "c";
+    }
+    out.writeEmptyElement( "use" );
+    out.writeAttribute( "xlink:href", href );
+    out.writeAttribute( "class", ( alias ) ? "a" : cls );
+    out.writeAttribute( "x", _num( pos.x() ) );
+    out.writeAttribute( "y", _num( pos.y() ) );
+    if( type == Connector::TID )
+    {
+        QString label;
+        switch( orig.getValue( Connector::AttrConnType ).getUInt8() )
+        {
+        case Connector::And:
+            label = QObject::tr("AND");
+            break;
+        case Connector::Or:
+            label = QObject::tr("OR");
+            break;
+        case Connector::Xor:
+            label = QObject::tr("XOR");
+            break;
+        }
+        if( !label.isEmpty() )
+        {
+            out.writeStartElement( "text" );
+            out.writeAttribute( "class", "tc" );
+            out.writeAttribute( "text-anchor", "middle" );
+            out.writeAttribute( "x", _num( pos.x() ) );
+            out.writeAttribute( "y", _num( pos.y() + 3.0 ) );
+            out.writeCharacters( label );
+            out.writeEndElement();
+        }
+        return;
+    }
+    writeText( out, textRect, text, true, ( alias ) ? "ta" : 0 );
+    if( d_showId )
+    {
+        const QString id = Procs::formatObjectId( orig );
+        if( !id.isEmpty() )
+        {
+            qreal x = pos.x() - DiagItem::s_boxWidth * 0.5;
+            if( type == Event::TID )
+                x += DiagItem::s_boxInset;
+            out.writeStartElement( "text" );
+            out.writeAttribute( "class", "id" );
+            out.writeAttribute( "x", _num( x ) );
+            out.writeAttribute( "y", _num( pos.y() - DiagItem::s_boxHeight * 0.5 - m ) );
+            out.writeCharacters( id );
+            out.writeEndElement();
+        }
+    }
+}
+
+void EpkSvgWriter::writeLink(QXmlStreamWriter & out, const Udb::Obj & obj, const Udb::Obj & orig)
+{
+    const Udb::Obj pred = orig.getValueAsObj( ConFlow::AttrPred );
+    const Udb::Obj succ = orig.getValueAsObj( ConFlow::AttrSucc );
+    if( !d_nodes.contains( pred.getOid() ) || !d_nodes.contains( succ.getOid() ) )
+        return; // Link ist nicht auf diesem Diagramm; siehe OrphanSweeper
+    const Node& from = d_nodes[ pred.getOid() ];
+    const Node& to = d_nodes[ succ.getOid() ];
+    QPolygonF line;
+    line << from.d_pos;
+    line += DiagItem( obj ).getNodeList();
+
+    // Letztes Segment am Umriss des Ziels abschneiden, damit die Pfeilspitze aussen sitzt
+    const QLineF last( line.last(), to.d_pos );
+    QPolygonF shape = _outline( to.d_type );
+    shape.translate( to.d_pos );
+    QPointF end = to.d_pos;
+    for( int i = 1; i < shape.size(); i++ )
+    {
+        QPointF hit;
+        if( QLineF( shape[i-1], shape[i] ).intersect( last, &hit ) == QLineF::BoundedIntersection )
+        {
+            end = hit;
+            break;
+        }
+    }
+    line << end;
+    out.writeEmptyElement( "polyline" );
+    out.writeAttribute( "class", ( d_markAlias && from.d_alias ) ? "la" : "l" );
+    out.writeAttribute( "points", _points( line ) );
+}
@@ -0,0 +1,63 @@
+#ifndef EPKSVGWRITER_H
+#define EPKSVGWRITER_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QFont>
+#include <QHash>
+#include <QPolygonF>
+#include <Udb/Obj.h>
+
+class QXmlStreamWriter;
+class QIODevice;
+
+namespace Epk
+{
+    class EpkSvgWriter
+    {
+        // Schreibt ein Diagramm direkt aus der Datenbank als SVG, ohne QSvgGenerator. Jede Form
+        // (Function, Process, Event, Connector, Pfeilspitze) steht genau einmal in <defs> und wird mit
+        // <use> referenziert; Farben und Strichstaerken stehen als CSS-Klassen im <style>.
+        // Die Flows sind Polylines ueber die Node-Liste der DiagItems.
+    public:
+        EpkSvgWriter( const QFont& chartFont );
+        void setShowId( bool on ) { d_showId = on; }
+        void setMarkAlias( bool on ) { d_markAlias = on; }
+        bool write( QIODevice*, const Udb::Obj& diagram );
+    private:
+        struct Node
+        {
+            QPointF d_pos;
+            quint32 d_type;
+            bool d_alias;
+        };
+        void writeStyle( QXmlStreamWriter& );
+        void writeDefs( QXmlStreamWriter& );
+        void writeNode( QXmlStreamWriter&, const Udb::Obj& item, const Udb::Obj& orig, const Udb::Obj& diagram );
+        void writeLink( QXmlStreamWriter&, const Udb::Obj& item, const Udb::Obj& orig );
+        void writeText( QXmlStreamWriter&, const QRectF&, const QString&, bool center, const char* cls );
+        QFont d_font;
+        QHash<Udb::OID,Node> d_nodes; // Orig -> Position und Typ auf dem Diagramm
+        bool d_showId;
+        bool d_markAlias;
+    };
+}
+
+#endif // EPKSVGWRITER_H
@@ -0,0 +1,218 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkSweeper.h"
+#include "EpkObjects.h"
+#include "EpkProcs.h"
+#include <Udb/Transaction.h>
+#include <Udb/Idx.h>
+#include <QSet>
+#include <QHash>
+using namespace Epk;
+
+static const int s_batchSize = 50;      // Objekte pro Commit
+static const int s_interval = 250;      // ms zwischen den Portionen
+static const int s_scanBatch = 500;     // Index-Eintraege pro Tick beim Suchen
+static QHash<Udb::Database*,int> s_suspended; // nur im GUI-Thread
+
+OrphanSweeper::Suspend::Suspend(Udb::Database * db):d_db(db)
+{
+    s_suspended[d_db]++;
+}
+
+OrphanSweeper::Suspend::~Suspend()
+{
+    if( --s_suspended[d_db] <= 0 )
+        s_suspended.remove( d_db );
+}
+
+bool OrphanSweeper::isSuspended(Udb::Database * db)
+{
+    return s_suspended.contains( db );
+}
+
+OrphanSweeper::OrphanSweeper(Udb::Transaction * txn, QObject *parent):
+    QObject(parent),d_txn(txn),d_erased(0),d_phase(0),d_resumeKey(0),d_resumeOid(0),d_scanned(false)
+{
+    Q_ASSERT( txn != 0 );
+    connect( &d_timer, SIGNAL(timeout()), this, SLOT(onTick()) );
+}
+
+void OrphanSweeper::start(int delayMs)
+{
+    if( isRunning() )
+        return;
+    d_erased = 0;
+    d_scanned = false;
+    d_phase = 0;
+    d_resumeKey = 0;
+    d_resumeOid = 0;
+    d_found.clear();
+    d_timer.setSingleShot( true );
+    d_timer.start( delayMs );
+}
+
+static bool _hasItemOn( const Udb::Obj& orig, const Udb::Obj& diagram )
+{
+    Index::ensure( orig.getTxn(), Index::OrigObject );
+    Udb::Idx idx( orig.getTxn(), Index::OrigObject );
+    if( idx.seek( orig ) ) do
+    {
+        if( orig.getObject( idx.getOid() ).getParent().equals( diagram ) )
+            return true;
+    }while( idx.nextKey() );
+    return false;
+}
+
+bool OrphanSweeper::isOrphanItem(const Udb::Obj & diagItem)
+{
+    if( diagItem.isNull( true, true ) || diagItem.getType() != DiagItem::TID )
+        return false;
+    const Udb::Obj orig = diagItem.getValueAsObj( DiagItem::AttrOrigObject );
+    if( orig.isNull( true ) )
+        return true;
+    if( orig.getType() == ConFlow::TID )
+    {
+        // Der Link existiert zwar, aber nicht beide Enden auf diesem Diagramm
+        const Udb::Obj diagram = diagItem.getParent();
+        return !_hasItemOn( orig.getValueAsObj( ConFlow::AttrPred ), diagram ) ||
+            !_hasItemOn( orig.getValueAsObj( ConFlow::AttrSucc ), diagram );
+    }
+    return false;
+}
+
+bool OrphanSweeper::isDanglingFlow(const Udb::Obj & conFlow)
+{
+    if( conFlow.isNull( true, true ) || conFlow.getType() != ConFlow::TID )
+        return false;
+    return conFlow.getValueAsObj( ConFlow::AttrPred ).isNull( true ) ||
+        conFlow.getValueAsObj( ConFlow::AttrSucc ).isNull( true );
+}
+
+static const int s_phaseCount = 3;
+
+static const char* _phaseIndex( int phase, quint32& attr )
+{
+    switch( phase )
+    {
+    case 0:
+        attr = ConFlow::AttrPred;
+        return Index::Pred;
+    case 1:
+        attr = ConFlow::AttrSucc;
+        return Index::Succ;
+    default:
+        attr = DiagItem::AttrOrigObject;
+        return Index::OrigObject;
+    }
+}
+
+bool OrphanSweeper::scanSome()
+{
+    // Nur lesen, hoechstens s_scanBatch Index-Eintraege pro Tick. Ein Cursor ueberlebt keinen Commit;
+    // deshalb wird mit dem letzten Schluessel (alle drei Indizes sind OID-Schluessel) und der letzten OID
+    // neu positioniert und das schon Gesehene uebersprungen.
+    int n = 0;
+    while( d_phase < s_phaseCount )
+    {
+        quint32 attr;
+        const char* name = _phaseIndex( d_phase, attr );
+        Index::ensure( d_txn, name );
+        Udb::Idx idx( d_txn, name );
+        bool ok = ( d_resumeKey == 0 ) ? idx.first() :
+                                         idx.lowerBound( Stream::DataCell().setOid( d_resumeKey ) );
+        while( ok )
+        {
+            const Udb::Obj o = d_txn->getObject( idx.getOid() );
+            const Udb::OID key = o.getValue( attr ).getOid();
+            if( key != d_resumeKey || o.getOid() > d_resumeOid )
+            {
+                if( n >= s_scanBatch )
+                    return false; // beim naechsten Tick ab hier weiter
+                n++;
+                d_resumeKey = key;
+                d_resumeOid = o.getOid();
+                if( !d_found.contains( o.getOid() ) &&
+                        ( ( attr == DiagItem::AttrOrigObject ) ? isOrphanItem( o ) : isDanglingFlow( o ) ) )
+                {
+                    d_found.insert( o.getOid() );
+                    d_candidates.append( o.getOid() );
+                }
+            }
+            ok = idx.next();
+        }
+        d_phase++;
+        d_resumeKey = 0;
+        d_resumeOid = 0;
+    }
+    d_found.clear();
+    return true;
+}
+
+void OrphanSweeper::onTick()
+{
+    if( isSuspended( d_txn->getDb() ) )
+    {
+        // Eine andere Operation haelt die Transaction; nicht dazwischen loeschen oder committen
+        d_timer.setSingleShot( true );
+        d_timer.start( 10 * s_interval );
+        return;
+    }
+    if( !d_scanned && !Index::getPending( d_txn->getDb() ).isEmpty() )
+    {
+        // Nicht ueber Index::ensure selber bauen, was der IndexBuilder ohnehin gleich erledigt
+        d_timer.setSingleShot( true );
+        d_timer.start( 10 * s_interval );
+        return;
+    }
+    if( !d_scanned )
+    {
+        d_scanned = scanSome();
+        if( !d_scanned )
+        {
+            d_timer.setSingleShot( true );
+            d_timer.start( s_interval );
+            return;
+        }
+    }
+    int n = 0;
+    while( !d_candidates.isEmpty() && n < s_batchSize )
+    {
+        Udb::Obj o = d_txn->getObject( d_candidates.takeFirst() );
+        // Erneut pruefen, da sich seit dem Scan etwas geaendert haben kann
+        if( isDanglingFlow( o ) || isOrphanItem( o ) )
+        {
+            Procs::erase( o );
+            n++;
+        }
+    }
+    if( n > 0 )
+    {
+        Procs::deferCommit( d_txn ); // zusammen mit den interaktiven Aenderungen
+        d_erased += n;
+    }
+    if( d_candidates.isEmpty() )
+    {
+        emit signalDone( d_erased );
+    }else
+    {
+        d_timer.setSingleShot( true );
+        d_timer.start( s_interval );
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef EPKSWEEPER_H
+#define EPKSWEEPER_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+#include <Udb/Obj.h>
+
+namespace Udb
+{
+    class Transaction;
+    class Database;
+}
+
+namespace Epk
+{
+    class OrphanSweeper : public QObject
+    {
+        // Raeumt im Hintergrund verwaiste DiagItems (OrigObject geloescht bzw. Flow nicht auf dem
+        // Diagramm) und haengende ConFlows (Pred oder Succ geloescht) auf. Frueher erledigte das
+        // EpkItemMdl::setDiagram beim Oeffnen; das Oeffnen eines Diagramms schreibt nun nichts mehr.
+        // Die Kandidaten werden ueber die Indizes Pred, Succ und OrigObject portionenweise gesucht und
+        // danach in kleinen Portionen geloescht; der Commit laeuft ueber Procs::deferCommit.
+        // Lange Operationen auf der gemeinsamen Transaction (Importe mit Fortschrittsdialog, welche die
+        // Event-Loop laufen lassen) klammern sich mit Suspend; solange ruht der Sweeper.
+        Q_OBJECT
+    public:
+        class Suspend
+        {
+        public:
+            Suspend( Udb::Database* );
+            ~Suspend();
+        private:
+            Udb::Database* d_db;
+        };
+
+        OrphanSweeper( Udb::Transaction*, QObject* parent );
+        void start( int delayMs = 0 ); // ignoriert, falls bereits am Laufen
+        bool isRunning() const { return d_timer.isActive() || !d_candidates.isEmpty(); }
+        int getErased() const { return d_erased; }
+
+        static bool isOrphanItem( const Udb::Obj& diagItem );
+        static bool isDanglingFlow( const Udb::Obj& conFlow );
+        static bool isSuspended( Udb::Database* );
+    signals:
+        void signalDone( int erased );
+    protected slots:
+        void onTick();
+    private:
+        bool scanSome(); // true..Scan fertig
+        Udb::Transaction* d_txn;
+        QList<Udb::OID> d_candidates;
+        QTimer d_timer;
+        QSet<Udb::OID> d_found;
+        int d_erased;
+        int d_phase; // Index, der gerade durchsucht wird
+        Udb::OID d_resumeKey;
+        Udb::OID d_resumeOid;
+        bool d_scanned;
+    };
+}
+
+#endif // EPKSWEEPER_H
@@ -0,0 +1,337 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkThumbnails.h"
+#include "EpkObjects.h"
+#include "EpkProcs.h"
+#include "EpkSnapshot.h"
+#include <Udb/Transaction.h>
+#include <Udb/Database.h>
+#include <Udb/DatabaseException.h>
+#include <QDesktopServices>
+#include <QTextDocument>
+#include <QImage>
+#include <QPainter>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+using namespace Epk;
+
+struct _ThumbShape
+{
+    QRectF d_rect;
+    quint32 d_type;
+    quint8 d_code; // Connector-Typ, Process oder DiagItem::Kind
+};
+
+struct _ThumbJob
+{
+    QString d_dbPath; // keine Udb::Database*, der Job kann die Datenbank ueberleben
+    quint64 d_oid;
+    QString d_path;
+    QString d_stamp; // Stempel im GUI-Thread; der Snapshot muss denselben Stand sehen
+    QRectF d_bound;
+    QList<_ThumbShape> d_shapes;
+    QList<QPolygonF> d_links;
+    int d_size;
+};
+
+struct _ThumbDone
+{
+    quint64 d_oid;
+    bool d_saved;
+    _ThumbDone( quint64 oid = 0, bool saved = false ):d_oid(oid),d_saved(saved){}
+};
+
+static const int s_snapRetries = 3;
+
+static inline void _latest( QDateTime& res, const Udb::Obj& o )
+{
+    const QDateTime t = o.getValue( Root::AttrModifiedOn ).getDateTime();
+    if( t.isValid() && ( !res.isValid() || t > res ) )
+        res = t;
+}
+
+static QString _stamp( const Udb::Obj& diagram )
+{
+    // Juengster AttrModifiedOn von Diagramm, DiagItems und deren Originalen (z.B. Connector-Typ),
+    // dazu die Anzahl Items, da Loeschen keinen der uebrigen Stempel aendert
+    QDateTime res = diagram.getValue( Root::AttrModifiedOn ).getDateTime();
+    int count = 0;
+    Udb::Obj sub = diagram.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() == DiagItem::TID )
+        {
+            count++;
+            _latest( res, sub );
+            _latest( res, sub.getValueAsObj( DiagItem::AttrOrigObject ) );
+        }
+    }while( sub.next() );
+    return QString( "%1_%2" ).arg( res.toString( "yyyyMMddhhmmsszzz" ) ).arg( count );
+}
+
+static bool _snap( const Udb::Obj& diagram, _ThumbJob& job )
+{
+    QMap<Udb::OID,QPointF> pos;
+    QList<DiagItem> flows;
+    Udb::Obj sub = diagram.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() != DiagItem::TID )
+            continue;
+        DiagItem item = sub;
+        const Udb::Obj orig = item.getOrigObject();
+        if( orig.isNull( true ) )
+            continue;
+        _ThumbShape s;
+        s.d_type = orig.getType();
+        s.d_code = 0;
+        const QPointF p = item.getPos();
+        if( s.d_type == ConFlow::TID )
+        {
+            flows.append( item );
+            continue;
+        }else if( s.d_type == Connector::TID )
+        {
+            const qreal r = DiagItem::s_boxHeight * 0.25;
+            s.d_rect = QRectF( p.x() - r, p.y() - r, 2.0 * r, 2.0 * r );
+            s.d_code = orig.getValue( Connector::AttrConnType ).getUInt8();
+        }else if( s.d_type == Function::TID || s.d_type == Event::TID )
+        {
+            s.d_rect = QRectF( p.x() - DiagItem::s_boxWidth * 0.5, p.y() - DiagItem::s_boxHeight * 0.5,
+                               DiagItem::s_boxWidth, DiagItem::s_boxHeight );
+            if( s.d_type == Function::TID )
+                s.d_code = orig.getValue( Function::AttrElemCount ).getUInt32() > 0;
+        }else if( item.getKind() != DiagItem::Plain )
+        {
+            s.d_rect = QRectF( p, item.getSize() );
+            s.d_code = item.getKind();
+        }else
+            continue;
+        pos[orig.getOid()] = p;
+        job.d_bound |= s.d_rect;
+        if( s.d_code == DiagItem::Frame && s.d_type == DiagItem::TID )
+            job.d_shapes.prepend( s ); // Frames zuunterst
+        else
+            job.d_shapes.append( s );
+    }while( sub.next() );
+    foreach( const DiagItem& f, flows )
+    {
+        const Udb::Obj orig = f.getOrigObject();
+        const Udb::OID pred = orig.getValue( ConFlow::AttrPred ).getOid();
+        const Udb::OID succ = orig.getValue( ConFlow::AttrSucc ).getOid();
+        if( !pos.contains( pred ) || !pos.contains( succ ) )
+            continue;
+        QPolygonF l;
+        l << pos[pred];
+        l += f.getNodeList();
+        l << pos[succ];
+        job.d_links.append( l );
+    }
+    if( job.d_bound.isEmpty() )
+        return false;
+    job.d_bound.adjust( -DiagItem::s_boxWidth * 0.25, -DiagItem::s_boxHeight * 0.25,
+                        DiagItem::s_boxWidth * 0.25, DiagItem::s_boxHeight * 0.25 );
+    return true;
+}
+
+static _ThumbDone _render( _ThumbJob job )
+{
+    // Laeuft im Worker; liest ueber einen eigenen Snapshot, zeichnet nur mit QImage und QPainter, keine Fonts.
+    // Sieht der Snapshot einen anderen Stand als der Stempel (nicht committete Aenderungen der GUI oder ein
+    // Commit waehrend des Lesens), wird wiederholt und zuletzt verworfen, statt ein falsches Bild abzulegen.
+    // Exceptions duerfen den Worker nicht verlassen, sonst wirft sie QFutureWatcher::result() im GUI-Thread.
+    bool ok = false;
+    for( int i = 0; i < s_snapRetries && !ok; i++ )
+    {
+        job.d_bound = QRectF();
+        job.d_shapes.clear();
+        job.d_links.clear();
+        try
+        {
+            Snapshot snap( job.d_dbPath );
+            if( !snap.isOpen() )
+                return _ThumbDone( job.d_oid );
+            const Udb::Obj diagram = snap.getObject( job.d_oid );
+            if( diagram.isNull( true ) || _stamp( diagram ) != job.d_stamp )
+                continue;
+            if( !_snap( diagram, job ) )
+                return _ThumbDone( job.d_oid );
+            ok = !snap.isStale();
+        }catch( Udb::DatabaseException& )
+        {
+            return _ThumbDone( job.d_oid );
+        }
+    }
+    if( !ok )
+        return _ThumbDone( job.d_oid );
+    const qreal scale = qMin( job.d_size / job.d_bound.width(), job.d_size / job.d_bound.height() );
+    const QSize size = ( job.d_bound.size() * scale ).toSize().expandedTo( QSize( 1, 1 ) );
+    QImage img( size, QImage::Format_RGB32 );
+    img.fill( QColor( Qt::white ).rgb() );
+    QPainter p( &img );
+    p.setRenderHint( QPainter::Antialiasing );
+    p.scale( scale, scale );
+    p.translate( -job.d_bound.topLeft() );
+    p.setPen( QPen( Qt::gray, 0 ) );
+    foreach( const QPolygonF& l, job.d_links )
+        p.drawPolyline( l );
+    foreach( const _ThumbShape& s, job.d_shapes )
+    {
+        if( s.d_type == Event::TID )
+        {
+            p.setPen( QPen( QColor( 179, 98, 5 ), 0 ) );
+            p.setBrush( QColor( 255, 178, 7 ) );
+            const qreal i = DiagItem::s_boxInset;
+            const QRectF& r = s.d_rect;
+            QPolygonF poly;
+            poly << QPointF( r.left(), r.center().y() ) << QPointF( r.left() + i, r.top() ) <<
+                    QPointF( r.right() - i, r.top() ) << QPointF( r.right(), r.center().y() ) <<
+                    QPointF( r.right() - i, r.bottom() ) << QPointF( r.left() + i, r.bottom() );
+            p.drawPolygon( poly );
+        }else if( s.d_type == Connector::TID )
+        {
+            p.setPen( QPen( QColor( 103, 103, 103 ), 0 ) );
+            if( s.d_code == Connector::Start )
+                p.setBrush( QColor( 196, 246, 121 ) );
+            else if( s.d_code == Connector::Finish )
+                p.setBrush( QColor( 246, 121, 121 ) );
+            else
+                p.setBrush( QColor( 208, 208, 208 ) );
+            p.drawEllipse( s.d_rect );
+        }else if( s.d_type == Function::TID )
+        {
+            if( s.d_code )
+            {
+                p.setPen( QPen( QColor( 140, 120, 33 ), 0 ) );
+                p.setBrush( QColor( 221, 208, 155 ) );
+            }else
+            {
+                p.setPen( QPen( QColor( 71, 179, 0 ), 0 ) );
+                p.setBrush( QColor( 150, 255, 0 ) );
+            }
+            p.drawRoundedRect( s.d_rect, DiagItem::s_radius, DiagItem::s_radius );
+        }else if( s.d_code == DiagItem::Frame )
+        {
+            p.setPen( QPen( Qt::gray, 0 ) );
+            p.setBrush( Qt::NoBrush );
+            p.drawRoundedRect( s.d_rect, DiagItem::s_radius, DiagItem::s_radius );
+        }else
+        {
+            p.setPen( Qt::NoPen );
+            p.setBrush( QColor( 240, 240, 240 ) );
+            p.drawRect( s.d_rect );
+        }
+    }
+    p.end();
+    return _ThumbDone( job.d_oid, img.save( job.d_path, "PNG" ) );
+}
+
+ThumbnailService::ThumbnailService(Udb::Transaction * txn, QObject *parent):
+    QObject(parent),d_txn(txn),d_size(160)
+{
+    Q_ASSERT( txn != 0 );
+    d_dir = QDir( QDesktopServices::storageLocation( QDesktopServices::DataLocation ) );
+    const QString sub = QString( "thumbs/%1" ).arg( d_txn->getDb()->getDbUuid().toString() );
+    d_dir.mkpath( sub );
+    d_dir.cd( sub );
+}
+
+ThumbnailService::~ThumbnailService()
+{
+    // Laufende Jobs abwarten; QtConcurrent::run laesst sich nicht abbrechen, noch nicht gestartete schon
+    foreach( QFutureWatcherBase* w, d_watchers )
+    {
+        w->disconnect( this );
+        w->cancel();
+        w->waitForFinished();
+    }
+}
+
+bool ThumbnailService::isDiagram(const Udb::Obj & o)
+{
+    if( o.isNull() )
+        return false;
+    if( o.getType() == Diagram::TID )
+        return true;
+    if( o.getType() != Function::TID )
+        return false;
+    Udb::Obj sub = o.getFirstObj();
+    if( !sub.isNull() ) do
+    {
+        if( sub.getType() == DiagItem::TID )
+            return true;
+    }while( sub.next() );
+    return false;
+}
+
+QString ThumbnailService::getThumbnail(const Udb::Obj & diagram)
+{
+    if( !isDiagram( diagram ) )
+        return QString();
+    const quint64 oid = diagram.getOid();
+    const QString stamp = _stamp( diagram );
+    const QString name = QString( "%1_%2.png" ).arg( oid ).arg( stamp );
+    if( d_dir.exists( name ) )
+        return d_dir.filePath( name );
+    if( d_pending.contains( oid ) )
+        return QString();
+
+    // Veraltete Bilder dieses Diagramms entfernen
+    foreach( const QString& old, d_dir.entryList( QStringList() << QString( "%1_*.png" ).arg( oid ), QDir::Files ) )
+        d_dir.remove( old );
+
+    _ThumbJob job;
+    job.d_dbPath = d_txn->getDb()->getFilePath();
+    job.d_oid = oid;
+    job.d_path = d_dir.filePath( name );
+    job.d_stamp = stamp;
+    job.d_size = d_size;
+    d_pending.insert( oid );
+    QFutureWatcher<_ThumbDone>* w = new QFutureWatcher<_ThumbDone>( this );
+    connect( w, SIGNAL(finished()), this, SLOT(onFinished()) );
+    d_watchers.append( w );
+    w->setFuture( QtConcurrent::run( _render, job ) );
+    return QString();
+}
+
+QString ThumbnailService::getToolTip(const Udb::Obj & diagram)
+{
+    const QString path = getThumbnail( diagram );
+    if( path.isEmpty() )
+        return QString();
+    return QString( "<html><b>%1</b><br><img src=\"%2\"></html>" ).
+            arg( Qt::escape( Procs::formatObjectTitle( diagram ) ) ).arg( path );
+}
+
+void ThumbnailService::onFinished()
+{
+    QFutureWatcher<_ThumbDone>* w = dynamic_cast<QFutureWatcher<_ThumbDone>*>( sender() );
+    if( w == 0 )
+        return;
+    d_watchers.removeAll( w );
+    w->deleteLater();
+    if( w->isCanceled() )
+        return;
+    const _ThumbDone res = w->result();
+    d_pending.remove( res.d_oid );
+    // Ohne Bild kein Signal, sonst fordert die View sofort wieder an
+    if( res.d_saved )
+        emit signalReady( res.d_oid );
+}
@@ -0,0 +1,63 @@
+#ifndef EPKTHUMBNAILS_H
+#define EPKTHUMBNAILS_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QDir>
+#include <QSet>
+#include <Udb/Obj.h>
+
+class QFutureWatcherBase;
+
+namespace Epk
+{
+    class ThumbnailService : public QObject
+    {
+        // Kleine Vorschaubilder von Diagrammen fuer die Baeume. Die Geometrie wird in Worker-Threads
+        // (QtConcurrent) ueber einen Snapshot aus den DiagItems gelesen (ohne QGraphicsScene), gezeichnet
+        // und als PNG gespeichert. Text wird nicht gezeichnet, da Fonts in Qt 4 nur im GUI-Thread sicher sind.
+        // Die PNGs liegen pro Datenbank in <DataLocation>/thumbs/<dbuuid>/<oid>_<stamp>.png; stamp ist
+        // der juengste AttrModifiedOn des Diagramms, seiner DiagItems und deren Originale samt Anzahl Items.
+        // Passt der Snapshot nicht zum Stempel oder ist er stale, wird kein Bild abgelegt.
+        Q_OBJECT
+    public:
+        ThumbnailService( Udb::Transaction*, QObject* parent );
+        ~ThumbnailService();
+        void setSize( int s ) { d_size = s; }
+        // Gibt den Pfad zurueck, falls aktuell vorhanden; sonst wird das Rendern angestossen
+        QString getThumbnail( const Udb::Obj& diagram );
+        // Rich-Text-Tooltip mit Titel und Bild, sobald dieses vorhanden ist
+        QString getToolTip( const Udb::Obj& diagram );
+        static bool isDiagram( const Udb::Obj& );
+    signals:
+        void signalReady( quint64 oid );
+    protected slots:
+        void onFinished();
+    private:
+        Udb::Transaction* d_txn;
+        QDir d_dir;
+        QSet<quint64> d_pending;
+        QList<QFutureWatcherBase*> d_watchers; // laufende Jobs, im Destruktor abgewartet
+        int d_size;
+    };
+}
+
+#endif // EPKTHUMBNAILS_H
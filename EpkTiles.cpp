@@ -0,0 +1,248 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "EpkTiles.h"
+#include <QGraphicsScene>
+#include <QPainter>
+#include <QImage>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QtEndian>
+#include <QtConcurrentRun>
+#include <QFuture>
+#include <math.h>
+#include <string.h>
+#include <zlib.h>
+using namespace Epk;
+
+class _PngWriter
+{
+    // Minimaler PNG-Writer: RGB, 8 Bit, kein Interlace, Filter 0. Die Zeilen werden laufend
+    // deflated; jeder volle Ausgabepuffer wird als eigener IDAT-Chunk geschrieben.
+public:
+    _PngWriter():d_ok(false),d_open(false) { d_buf.resize( 64 * 1024 ); }
+    ~_PngWriter() { if( d_open ) ::deflateEnd( &d_z ); }
+    bool begin( const QString& path, int w, int h )
+    {
+        d_file.setFileName( path );
+        if( !d_file.open( QIODevice::WriteOnly ) )
+            return false;
+        static const char s_sig[] = { char(137), 'P', 'N', 'G', 13, 10, 26, 10 };
+        d_file.write( s_sig, sizeof(s_sig) );
+        QByteArray ihdr( 13, 0 );
+        qToBigEndian<quint32>( w, (uchar*)ihdr.data() );
+        qToBigEndian<quint32>( h, (uchar*)ihdr.data() + 4 );
+        ihdr[8] = 8; // Bit depth
+        ihdr[9] = 2; // RGB
+        writeChunk( "IHDR", ihdr.constData(), ihdr.size() );
+        ::memset( &d_z, 0, sizeof(d_z) );
+        if( ::deflateInit( &d_z, Z_DEFAULT_COMPRESSION ) != Z_OK )
+            return false;
+        d_open = true;
+        d_ok = true;
+        return true;
+    }
+    void addBand( const QImage& img )
+    {
+        // img ist Format_RGB32; pro Zeile ein Filter-Byte und danach R,G,B
+        QByteArray row( 1 + img.width() * 3, 0 );
+        for( int y = 0; y < img.height() && d_ok; y++ )
+        {
+            const QRgb* src = reinterpret_cast<const QRgb*>( img.scanLine( y ) );
+            uchar* dst = reinterpret_cast<uchar*>( row.data() ) + 1;
+            for( int x = 0; x < img.width(); x++ )
+            {
+                *dst++ = qRed( src[x] );
+                *dst++ = qGreen( src[x] );
+                *dst++ = qBlue( src[x] );
+            }
+            deflate( row.constData(), row.size(), Z_NO_FLUSH );
+        }
+    }
+    bool finish()
+    {
+        if( !d_open )
+            return false;
+        deflate( 0, 0, Z_FINISH );
+        ::deflateEnd( &d_z );
+        d_open = false;
+        writeChunk( "IEND", 0, 0 );
+        d_file.close();
+        return d_ok && d_file.error() == QFile::NoError;
+    }
+private:
+    void deflate( const char* data, int len, int flush )
+    {
+        d_z.next_in = (Bytef*)data;
+        d_z.avail_in = len;
+        int res;
+        do
+        {
+            d_z.next_out = (Bytef*)d_buf.data();
+            d_z.avail_out = d_buf.size();
+            res = ::deflate( &d_z, flush );
+            if( res == Z_STREAM_ERROR )
+            {
+                d_ok = false;
+                return;
+            }
+            const int have = d_buf.size() - d_z.avail_out;
+            if( have > 0 )
+                writeChunk( "IDAT", d_buf.constData(), have );
+        }while( d_z.avail_out == 0 || ( flush == Z_FINISH && res != Z_STREAM_END ) );
+    }
+    void writeChunk( const char* type, const char* data, int len )
+    {
+        uchar len4[4];
+        qToBigEndian<quint32>( len, len4 );
+        d_file.write( (const char*)len4, 4 );
+        d_file.write( type, 4 );
+        if( len > 0 )
+            d_file.write( data, len );
+        uLong crc = ::crc32( 0, (const Bytef*)type, 4 );
+        if( len > 0 )
+            crc = ::crc32( crc, (const Bytef*)data, len );
+        uchar crc4[4];
+        qToBigEndian<quint32>( crc, crc4 );
+        if( d_file.write( (const char*)crc4, 4 ) != 4 )
+            d_ok = false;
+    }
+    QFile d_file;
+    z_stream d_z;
+    QByteArray d_buf;
+    bool d_ok;
+    bool d_open;
+};
+
+static void _compress( _PngWriter* w, QImage img )
+{
+    w->addBand( img );
+}
+
+TiledRenderer::TiledRenderer(QGraphicsScene * s, const QRectF & source):
+    d_scene(s),d_source(source),d_tileSize(256),d_threaded(true)
+{
+    Q_ASSERT( s != 0 );
+}
+
+static void _render( QGraphicsScene* s, QImage& img, const QRectF& source )
+{
+    img.fill( QColor( Qt::white ).rgb() );
+    QPainter p( &img );
+    p.setRenderHints( QPainter::Antialiasing | QPainter::TextAntialiasing );
+    s->render( &p, QRectF( 0, 0, img.width(), img.height() ), source, Qt::IgnoreAspectRatio );
+}
+
+bool TiledRenderer::writePng(const QString & path, qreal scale)
+{
+    const int w = int( ::ceil( d_source.width() * scale ) );
+    const int h = int( ::ceil( d_source.height() * scale ) );
+    if( w <= 0 || h <= 0 )
+    {
+        d_error = QObject::tr("Nothing to export");
+        return false;
+    }
+    _PngWriter png;
+    if( !png.begin( path, w, h ) )
+    {
+        d_error = QObject::tr("Cannot open file for writing: %1").arg( path );
+        return false;
+    }
+    d_scene->clearSelection();
+    QFuture<void> pending;
+    for( int y = 0; y < h; y += d_tileSize )
+    {
+        const int bh = qMin( d_tileSize, h - y );
+        // Jedes Band bekommt ein eigenes Image, da der Worker das vorige noch liest
+        QImage band( w, bh, QImage::Format_RGB32 );
+        _render( d_scene, band, QRectF( d_source.left(), d_source.top() + y / scale,
+                                        d_source.width(), bh / scale ) );
+        pending.waitForFinished();
+        if( d_threaded )
+            pending = QtConcurrent::run( _compress, &png, band );
+        else
+            png.addBand( band );
+    }
+    pending.waitForFinished();
+    if( !png.finish() )
+    {
+        d_error = QObject::tr("Error writing file: %1").arg( path );
+        return false;
+    }
+    return true;
+}
+
+int TiledRenderer::writePyramid(const QString & path)
+{
+    const qreal extent = qMax( d_source.width(), d_source.height() );
+    if( extent <= 0 )
+    {
+        d_error = QObject::tr("Nothing to export");
+        return -1;
+    }
+    QDir dir( path );
+    // Hoechste Stufe hat Massstab 1, jede tiefere halbiert
+    const int maxZoom = qMax( 0, int( ::ceil( ::log( extent / d_tileSize ) / ::log( 2.0 ) ) ) );
+    d_scene->clearSelection();
+    QImage tile( d_tileSize, d_tileSize, QImage::Format_RGB32 );
+    for( int z = 0; z <= maxZoom; z++ )
+    {
+        const qreal scale = ::pow( 2.0, z - maxZoom );
+        const qreal step = d_tileSize / scale; // Kachelgroesse in Szenen-Koordinaten
+        const int nx = qMax( 1, int( ::ceil( d_source.width() / step ) ) );
+        const int ny = qMax( 1, int( ::ceil( d_source.height() / step ) ) );
+        const QString sub = QString::number( z );
+        if( !dir.mkpath( sub ) )
+        {
+            d_error = QObject::tr("Cannot create directory: %1").arg( dir.filePath( sub ) );
+            return -1;
+        }
+        for( int x = 0; x < nx; x++ )
+        {
+            for( int y = 0; y < ny; y++ )
+            {
+                _render( d_scene, tile, QRectF( d_source.left() + x * step, d_source.top() + y * step,
+                                                step, step ) );
+                const QString file = dir.filePath( QString( "%1/%2_%3.png" ).arg( z ).arg( x ).arg( y ) );
+                if( !tile.save( file, "PNG" ) )
+                {
+                    d_error = QObject::tr("Error writing file: %1").arg( file );
+                    return -1;
+                }
+            }
+        }
+    }
+    QFile f( dir.filePath( "tiles.json" ) );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        d_error = QObject::tr("Cannot open file for writing: %1").arg( f.fileName() );
+        return -1;
+    }
+    QTextStream out( &f );
+    out << "{" << endl;
+    out << "  \"tileSize\": " << d_tileSize << "," << endl;
+    out << "  \"minZoom\": 0," << endl;
+    out << "  \"maxZoom\": " << maxZoom << "," << endl;
+    out << "  \"width\": " << int( ::ceil( d_source.width() ) ) << "," << endl;
+    out << "  \"height\": " << int( ::ceil( d_source.height() ) ) << "," << endl;
+    out << "  \"pattern\": \"{z}/{x}_{y}.png\"" << endl;
+    out << "}" << endl;
+    return maxZoom + 1;
+}
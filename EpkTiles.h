@@ -0,0 +1,54 @@
+#ifndef EPKTILES_H
+#define EPKTILES_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QRectF>
+#include <QString>
+
+class QGraphicsScene;
+
+namespace Epk
+{
+    class TiledRenderer
+    {
+        // Rendert eine Szene in Kacheln fester Groesse, statt in ein einziges QImage. writePng haelt
+        // nur ein Band von tileSize Zeilen im Speicher und schreibt die Zeilen laufend in den Deflate-Stream
+        // des PNG. QGraphicsScene ist nicht thread-safe; deshalb wird im GUI-Thread gerendert und mit
+        // threaded=true das Komprimieren des vorigen Bandes parallel in einem Worker erledigt.
+        // writePyramid erzeugt Kacheln fuer Web-Viewer (Verzeichnisse <zoom>/<x>_<y>.png, Zoom 0 ist
+        // eine einzige Kachel mit dem ganzen Diagramm) sowie eine Beschreibung tiles.json.
+    public:
+        TiledRenderer( QGraphicsScene*, const QRectF& source );
+        void setTileSize( int s ) { d_tileSize = s; }
+        void setThreaded( bool on ) { d_threaded = on; }
+        bool writePng( const QString& path, qreal scale = 1.0 );
+        int writePyramid( const QString& dir ); // gibt die Anzahl Zoom-Stufen zurueck oder -1
+        const QString& getError() const { return d_error; }
+    private:
+        QGraphicsScene* d_scene;
+        QRectF d_source;
+        QString d_error;
+        int d_tileSize;
+        bool d_threaded;
+    };
+}
+
+#endif // EPKTILES_H
@@ -20,7 +20,7 @@ void EpkView::mousePressEvent ( QMouseEvent * e )
 {
     if( e->button() == Qt::LeftButton )
     {
-        if( scene() && scene()->itemAt( mapToScene( e->pos() ) ) == 0 )
+        if( getMdl() && getMdl()->hitItem( mapToScene( e->pos() ) ) == 0 )
         {
             // Click ins Leere
             d_rubberRect = QRect( e->pos(), QSize( 1, 1 ) );
@@ -99,12 +99,9 @@ void EpkView::mouseReleaseEvent ( QMouseEvent * e )
 {
     if( d_mode == Selecting || d_mode == Extending )
     {
-        QPainterPath selectionArea;
         QRect r = d_rubberRect.normalized();
-        selectionArea.addPolygon( mapToScene( r ) );
-        selectionArea.closeSubpath();
-        if( scene() )
-            scene()->setSelectionArea( selectionArea, Qt::ContainsItemShape );
+        if( getMdl() )
+            getMdl()->selectItemsIn( mapToScene( r ).boundingRect() );
         viewport()->update( r );
     }else if( d_mode == Scrolling )
     {
@@ -121,7 +118,7 @@ void EpkView::mouseReleaseEvent ( QMouseEvent * e )
 void EpkView::paintEvent ( QPaintEvent * e )
 {
     Q_ASSERT( scene() );
-    const bool big = scene()->items().size() > 1000;
+    const bool big = getMdl() && getMdl()->indexedCount() > 1000;
     setRenderHint( QPainter::Antialiasing, !big );
     setRenderHint( QPainter::TextAntialiasing, !big );
 
@@ -0,0 +1,272 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "FlnCacheTuner.h"
+#include "EpkSnapshot.h"
+#include <Udb/Database.h>
+#include <QSettings>
+#include <QFileInfo>
+#include <QFile>
+#include <QTimerEvent>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+using namespace Fln;
+
+const int CacheTuner::s_pageSize = 1024;
+const int CacheTuner::s_minPages = 10000; // bisheriger fester Wert
+static const int s_interval = 30 * 1000; // ms
+static const int s_quietIntervals = 10;  // so lange ruhig, bevor verkleinert wird
+static int s_instances = 0; // offene Repositories; der Prozess-I/O ist nur bei einem zuordenbar
+
+quint64 CacheTuner::physicalMemory()
+{
+#ifdef _WIN32
+    MEMORYSTATUSEX ms;
+    ms.dwLength = sizeof(ms);
+    if( ::GlobalMemoryStatusEx( &ms ) )
+        return ms.ullTotalPhys;
+    return 0;
+#else
+    const long pages = ::sysconf( _SC_PHYS_PAGES );
+    const long size = ::sysconf( _SC_PAGE_SIZE );
+    if( pages > 0 && size > 0 )
+        return quint64( pages ) * quint64( size );
+    return 0;
+#endif
+}
+
+bool CacheTuner::processIo(quint64 &read, quint64 &written)
+{
+#ifdef _WIN32
+    IO_COUNTERS io;
+    if( !::GetProcessIoCounters( ::GetCurrentProcess(), &io ) )
+        return false;
+    read = io.ReadTransferCount;
+    written = io.WriteTransferCount;
+    return true;
+#else
+    QFile f( "/proc/self/io" );
+    if( !f.open( QIODevice::ReadOnly ) )
+        return false;
+    bool r = false, w = false;
+    // rchar/wchar zaehlen auch Zugriffe, die der OS-Cache bedient; genau das, was dem Udb-Cache fehlt
+    foreach( const QByteArray& line, f.readAll().split( '\n' ) )
+    {
+        if( line.startsWith( "rchar:" ) )
+            read = line.mid( 6 ).trimmed().toULongLong( &r );
+        else if( line.startsWith( "wchar:" ) )
+            written = line.mid( 6 ).trimmed().toULongLong( &w );
+    }
+    return r && w;
+#endif
+}
+
+CacheTuner::CacheTuner(Udb::Database * db):QObject(db),d_db(db),d_read0(0),d_written0(0),d_lastRead(0),
+    d_adjustments(0),d_quiet(0),d_foreign(0),d_snapshots(0),d_timer(0),d_fixed(false)
+{
+    Q_ASSERT( db != 0 );
+    s_instances++;
+    d_openedOn = QDateTime::currentDateTime();
+    const quint64 ram = physicalMemory();
+    d_maxPages = ( ram > 0 ) ? int( qMin( ram / 8 / s_pageSize, quint64( 0x7fffffff ) ) ) : s_minPages * 10;
+    d_maxPages = qMax( d_maxPages, s_minPages );
+
+    QSettings set;
+    const int fixed = set.value( settingsKey( "Size" ), 0 ).toInt();
+    int pages;
+    if( fixed > 0 )
+    {
+        d_fixed = true;
+        pages = fixed;
+    }else
+    {
+        pages = set.value( settingsKey( "Learned" ), 0 ).toInt();
+        if( pages <= 0 )
+        {
+            // Erster Start: ein Viertel der Datei, falls das RAM reicht
+            const quint64 file = QFileInfo( d_db->getFilePath() ).size();
+            pages = int( qMin( file / 4 / s_pageSize, quint64( d_maxPages ) ) );
+        }
+        pages = qBound( s_minPages, pages, d_maxPages );
+    }
+    apply( pages );
+    processIo( d_read0, d_written0 );
+    d_lastRead = d_read0;
+    d_snapshots = Epk::Snapshot::getActivity();
+    if( !d_fixed )
+        d_timer = startTimer( s_interval );
+}
+
+CacheTuner::~CacheTuner()
+{
+    s_instances--;
+}
+
+CacheTuner *CacheTuner::find(Udb::Database * db)
+{
+    if( db == 0 )
+        return 0;
+    return db->findChild<CacheTuner*>();
+}
+
+QString CacheTuner::settingsKey(const char * name) const
+{
+    return QString( "Cache/%1/%2" ).arg( name ).arg( d_db->getDbUuid().toString() );
+}
+
+void CacheTuner::apply(int pages)
+{
+    d_pages = pages;
+    d_db->setCacheSize( pages );
+}
+
+void CacheTuner::learn(int pages)
+{
+    apply( pages );
+    d_adjustments++;
+    d_quiet = 0;
+    QSettings set;
+    set.setValue( settingsKey( "Learned" ), pages );
+}
+
+void CacheTuner::beginForeignIo()
+{
+    d_foreign++;
+}
+
+void CacheTuner::endForeignIo()
+{
+    Q_ASSERT( d_foreign > 0 );
+    d_foreign--;
+    quint64 r = 0, w = 0;
+    if( d_foreign == 0 && processIo( r, w ) )
+        d_lastRead = r; // was bis hierher gelesen wurde, gilt nicht als Miss
+}
+
+CacheTuner::ForeignIo::ForeignIo(Udb::Database * db):d_tuner( CacheTuner::find( db ) )
+{
+    if( d_tuner )
+        d_tuner->beginForeignIo();
+}
+
+CacheTuner::ForeignIo::~ForeignIo()
+{
+    if( d_tuner )
+        d_tuner->endForeignIo();
+}
+
+void CacheTuner::setFixedSize(int pages)
+{
+    QSettings set;
+    if( pages > 0 )
+    {
+        set.setValue( settingsKey( "Size" ), pages );
+        d_fixed = true;
+        if( d_timer )
+            killTimer( d_timer );
+        d_timer = 0;
+        apply( pages );
+    }else
+    {
+        set.remove( settingsKey( "Size" ) );
+        d_fixed = false;
+        if( d_timer == 0 )
+            d_timer = startTimer( s_interval );
+    }
+}
+
+quint64 CacheTuner::getBytesRead() const
+{
+    quint64 r = 0, w = 0;
+    if( processIo( r, w ) )
+        return r - d_read0;
+    return 0;
+}
+
+quint64 CacheTuner::getBytesWritten() const
+{
+    quint64 r = 0, w = 0;
+    if( processIo( r, w ) )
+        return w - d_written0;
+    return 0;
+}
+
+void CacheTuner::timerEvent(QTimerEvent * e)
+{
+    if( e->timerId() != d_timer )
+    {
+        QObject::timerEvent( e );
+        return;
+    }
+    quint64 r = 0, w = 0;
+    if( !processIo( r, w ) )
+        return;
+    const quint64 delta = r - d_lastRead;
+    d_lastRead = r;
+    if( d_foreign > 0 )
+        return; // Import oder Export liest gerade andere Dateien
+    if( s_instances > 1 )
+        return; // Gelesenes koennte ebenso von einem anderen Repository stammen
+    const int snapshots = Epk::Snapshot::getActivity();
+    const bool snapped = snapshots != d_snapshots || Epk::Snapshot::getOpenCount() > 0;
+    d_snapshots = snapshots;
+    if( snapped )
+        return; // Worker haben ueber eigene Verbindungen gelesen
+    const quint64 cacheBytes = quint64( d_pages ) * s_pageSize;
+    if( delta > cacheBytes / 10 )
+    {
+        // Mehr als ein Zehntel des Caches nachgelesen: zu klein fuer das aktuelle Arbeitsset
+        d_quiet = 0;
+        if( d_pages < d_maxPages )
+            learn( qMin( d_maxPages, d_pages + d_pages / 2 ) );
+    }else if( delta < cacheBytes / 100 )
+    {
+        // Arbeitsset passt laengst; nach einer Weile um ein Viertel verkleinern
+        if( ++d_quiet >= s_quietIntervals && d_pages > s_minPages )
+            learn( qMax( s_minPages, d_pages - d_pages / 4 ) );
+    }else
+        d_quiet = 0;
+}
+
+static QString _kb( quint64 bytes )
+{
+    return QString( "%1 KB" ).arg( ( bytes + 1023 ) / 1024 );
+}
+
+QString CacheTuner::formatStatistics() const
+{
+    const int secs = d_openedOn.secsTo( QDateTime::currentDateTime() );
+    QString res;
+    res += tr("Cache size: %1 pages (%2)%3\n").arg( d_pages ).arg( _kb( quint64( d_pages ) * s_pageSize ) ).
+            arg( ( d_fixed ) ? tr(", fixed") : tr(", automatic") );
+    res += tr("Maximum: %1 pages (1/8 of %2 RAM)\n").arg( d_maxPages ).arg( _kb( physicalMemory() ) );
+    res += tr("Repository file: %1\n").arg( _kb( QFileInfo( d_db->getFilePath() ).size() ) );
+    res += tr("Open since: %1 (%2 s)\n").arg( d_openedOn.toString( Qt::ISODate ) ).arg( secs );
+    const quint64 read = getBytesRead();
+    res += tr("Read by process since open: %1 (~%2 pages of assumed %3 bytes)\n").arg( _kb( read ) ).
+            arg( read / s_pageSize ).arg( s_pageSize );
+    res += tr("Written by process since open: %1\n").arg( _kb( getBytesWritten() ) );
+    if( !d_fixed && s_instances > 1 )
+        res += tr("Automatic adjustment paused: %1 repositories open\n").arg( s_instances );
+    res += tr("Cache adjustments: %1").arg( d_adjustments );
+    return res;
+}
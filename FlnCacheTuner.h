@@ -0,0 +1,103 @@
+#ifndef FLNCACHETUNER_H
+#define FLNCACHETUNER_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QDateTime>
+
+namespace Udb
+{
+    class Database;
+}
+
+namespace Fln
+{
+    class CacheTuner : public QObject
+    {
+        // Bestimmt die Cache-Groesse (in Seiten) pro Repository. Fest eingestellt ueber "Cache/Size/<dbuuid>",
+        // sonst aus Dateigroesse und physischem RAM geschaetzt und danach periodisch angepasst: Udb hat keine
+        // Zaehler fuer Hits und Misses; als Mass fuer Misses dient das vom Prozess tatsaechlich gelesene
+        // Datenvolumen (/proc/self/io bzw. GetProcessIoCounters). Liest der Prozess pro Intervall mehr als
+        // einen Bruchteil des Caches nach, wird dieser vergroessert, hoechstens auf 1/8 des RAM; bleibt es
+        // ueber mehrere Intervalle ruhig, wird er schrittweise wieder verkleinert. Datei-I/O neben der
+        // Datenbank (Importe, Exporte) wird mit ForeignIo geklammert und nicht gezaehlt.
+        // Grenzen der Messung: der Zaehler gilt fuer den ganzen Prozess und laesst sich nicht einer Datenbank
+        // zuordnen. Deshalb wird nur angepasst, solange genau ein Repository offen ist, und Intervalle, in
+        // denen Snapshots (eigene Verbindungen der Worker) offen waren, werden verworfen. Nicht erfasst sind
+        // kleinere Lesezugriffe wie das Laden der Vorschaubilder fuer Tooltips; sie koennen den Cache
+        // hoechstens etwas zu gross werden lassen. Die Seitengroesse s_pageSize ist eine Annahme, Udb
+        // legt sie nicht offen; Bytes und Seiten sind deshalb nur naeherungsweise umrechenbar.
+        // Die gelernte Groesse wird unter "Cache/Learned/<dbuuid>" fuer den naechsten Start gespeichert.
+        Q_OBJECT
+    public:
+        static const int s_pageSize; // Annahme fuer die Umrechnung Seiten <-> Bytes
+        static const int s_minPages;
+
+        class ForeignIo
+        {
+            // Solange eine Instanz lebt, passt der CacheTuner der Datenbank nichts an
+        public:
+            ForeignIo( Udb::Database* );
+            ~ForeignIo();
+        private:
+            CacheTuner* d_tuner;
+        };
+
+        CacheTuner( Udb::Database* );
+        ~CacheTuner();
+        int getCacheSize() const { return d_pages; }
+        int getMaxSize() const { return d_maxPages; }
+        bool isFixed() const { return d_fixed; }
+        int getAdjustments() const { return d_adjustments; }
+        quint64 getBytesRead() const;
+        quint64 getBytesWritten() const;
+        const QDateTime& getOpenedOn() const { return d_openedOn; }
+        QString formatStatistics() const;
+        void setFixedSize( int pages ); // 0..automatisch
+
+        static quint64 physicalMemory();
+        static bool processIo( quint64& read, quint64& written );
+        static CacheTuner* find( Udb::Database* );
+    protected:
+        void timerEvent( QTimerEvent* );
+        QString settingsKey( const char* ) const;
+    private:
+        void apply( int pages );
+        void learn( int pages );
+        void beginForeignIo();
+        void endForeignIo();
+        Udb::Database* d_db;
+        QDateTime d_openedOn;
+        quint64 d_read0;
+        quint64 d_written0;
+        quint64 d_lastRead;
+        int d_pages;
+        int d_maxPages;
+        int d_adjustments;
+        int d_quiet;   // Intervalle in Folge mit wenig Nachlesen
+        int d_foreign; // Anzahl offener ForeignIo
+        int d_snapshots; // Snapshot::getActivity() beim letzten Intervall
+        int d_timer;
+        bool d_fixed;
+    };
+}
+
+#endif // FLNCACHETUNER_H
@@ -20,6 +20,7 @@
 #include "FlnFolderCtrl.h"
 #include <QtGui/QTreeView>
 #include "EpkObjects.h"
+#include "EpkThumbnails.h"
 using namespace Fln;
 
 FolderCtrl::FolderCtrl(QTreeView *tree, Wt::GenericMdl *mdl) :
@@ -27,7 +28,7 @@ FolderCtrl::FolderCtrl(QTreeView *tree, Wt::GenericMdl *mdl) :
 {
 }
 
-FolderCtrl *FolderCtrl::create(QWidget *parent, const Udb::Obj &root)
+FolderCtrl *FolderCtrl::create(QWidget *parent, const Udb::Obj &root, Epk::ThumbnailService* thumbs)
 {
     QTreeView* tree = new QTreeView( parent );
     tree->setHeaderHidden( true );
@@ -41,6 +42,7 @@ FolderCtrl *FolderCtrl::create(QWidget *parent, const Udb::Obj &root)
 	tree->setExpandsOnDoubleClick( false );
 
     FolderMdl* mdl = new FolderMdl( tree );
+    mdl->setThumbnails( thumbs );
     tree->setModel( mdl );
 
     FolderCtrl* ctrl = new FolderCtrl(tree, mdl);
@@ -99,10 +101,38 @@ void FolderCtrl::onAddScript()
 	add( Udb::ScriptSource::TID );
 }
 
-FolderMdl::FolderMdl(QObject *parent):GenericMdl(parent)
+FolderMdl::FolderMdl(QObject *parent):GenericMdl(parent),d_thumbs(0)
 {
 }
 
+void FolderMdl::setThumbnails(Epk::ThumbnailService * t)
+{
+    if( d_thumbs )
+        disconnect( d_thumbs, 0, this, 0 );
+    d_thumbs = t;
+    if( d_thumbs )
+        connect( d_thumbs, SIGNAL(signalReady(quint64)), this, SLOT(onThumbnailReady(quint64)) );
+}
+
+void FolderMdl::onThumbnailReady(quint64 oid)
+{
+    // Damit ein offener Tooltip das Bild zeigt, sobald es gerendert ist
+    const QModelIndex i = getIndex( oid );
+    if( i.isValid() )
+        emit dataChanged( i, i );
+}
+
+QVariant FolderMdl::data(const QModelIndex &index, int role) const
+{
+    if( role == Qt::ToolTipRole && d_thumbs != 0 )
+    {
+        const QString tip = d_thumbs->getToolTip( getObject( index ) );
+        if( !tip.isEmpty() )
+            return tip;
+    }
+    return GenericMdl::data( index, role );
+}
+
 bool FolderMdl::isSupportedType(quint32 type)
 {
 	return type == Udb::Folder::TID || type == Udb::ScriptSource::TID ||
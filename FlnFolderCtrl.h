@@ -23,6 +23,11 @@
 #include <WorkTree/GenericCtrl.h>
 #include <WorkTree/GenericMdl.h>
 
+namespace Epk
+{
+    class ThumbnailService;
+}
+
 namespace Fln
 {
     class FolderCtrl : public Wt::GenericCtrl
@@ -30,7 +35,7 @@ namespace Fln
         Q_OBJECT
     public:
         explicit FolderCtrl(QTreeView *tree, Wt::GenericMdl* mdl );
-        static FolderCtrl* create(QWidget* parent, const Udb::Obj& root );
+        static FolderCtrl* create(QWidget* parent, const Udb::Obj& root, Epk::ThumbnailService* = 0 );
         void addCommands( Gui2::AutoMenu* );
     public slots:
         void onAddFolder();
@@ -41,10 +46,17 @@ namespace Fln
 
     class FolderMdl : public Wt::GenericMdl
     {
+        Q_OBJECT
     public:
         explicit FolderMdl(QObject *parent = 0);
+        void setThumbnails( Epk::ThumbnailService* );
+        QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const;
+    protected slots:
+        void onThumbnailReady( quint64 oid );
     protected:
         virtual bool isSupportedType( quint32 );
+    private:
+        Epk::ThumbnailService* d_thumbs;
     };
 }
 
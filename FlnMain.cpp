@@ -20,6 +20,7 @@
 #include <QtApp/QtSingleApplication>
 #include "FlnMainWindow.h"
 #include "FlowLine2App.h"
+#include <QApplication>
 #include <QIcon>
 #include <QSettings>
 #include <QFileDialog>
@@ -28,8 +29,52 @@
 #include <Udb/DatabaseException.h>
 using namespace Fln;
 
+static bool _isBatch( int argc, char *argv[] )
+{
+    for( int i = 1; i < argc; i++ )
+        if( qstrncmp( argv[i], "-export:", 8 ) == 0 )
+            return true;
+    return false;
+}
+
+static int _runBatch( int argc, char *argv[] )
+{
+    // Ohne QtSingleApplication: kein Instanz-Lock und keine Weitergabe an ein laufendes FlowLine.
+    // Das Rendern braucht Fonts und damit unter X11 trotzdem ein Display; auf Servern ohne X z.B.
+    // mit "xvfb-run FlowLine2 ...". Meldungen gehen nur nach stderr, nie in eine MessageBox.
+    QApplication app( argc, argv );
+    FlowLine2App ctx;
+    QString path;
+    QString oidArg;
+    QString exportArg;
+    bool details = false;
+    const QStringList args = QCoreApplication::arguments();
+    for( int i = 1; i < args.size(); i++ )
+    {
+        if( !args[ i ].startsWith( '-' ) )
+            path = args[ i ];
+        else if( args[ i ].startsWith( "-oid:") )
+            oidArg = args[ i ];
+        else if( args[ i ].startsWith( "-export:") )
+            exportArg = args[ i ].mid( 8 );
+        else if( args[ i ] == "-details" )
+            details = true;
+    }
+    if( path.isEmpty() || oidArg.isEmpty() || exportArg.isEmpty() )
+    {
+        qWarning() << "usage: FlowLine2 <repository> -oid:<diagram> -export:<file.pdf|file.png> [-details]";
+        return -1;
+    }
+    if( !path.toLower().endsWith( QLatin1String( FlowLine2App::s_extension ) ) )
+        path += QLatin1String( FlowLine2App::s_extension );
+    return FlowLine2App::exportHeadless( path, oidArg.mid( 5 ).toULongLong(), exportArg, details );
+}
+
 int main(int argc, char *argv[])
 {
+    if( _isBatch( argc, argv ) )
+        return _runBatch( argc, argv );
+
     QtSingleApplication app( FlowLine2App::s_appName, argc, argv);
 
     QIcon icon;
@@ -29,6 +29,13 @@
 #include "SysTree.h"
 #include "AllocViewCtrl.h"
 #include "EpkLuaBinding.h"
+#include "EpkSweeper.h"
+#include "EpkDelta.h"
+#include "EpkHash.h"
+#include "EpkThumbnails.h"
+#include "EpkIndexBuilder.h"
+#include "FlnRefUpdater.h"
+#include "FlnCacheTuner.h"
 #include <CrossLine/DocTabWidget.h>
 #include <Gui2/AutoShortcut.h>
 #include <Oln2/OutlineUdbCtrl.h>
@@ -47,6 +54,14 @@
 #include <QDockWidget>
 #include <QDesktopServices>
 #include <QTreeView>
+#include <QTimer>
+#include <QInputDialog>
+#include <QFileDialog>
+#include <QFile>
+#include <QListWidget>
+#include <QLabel>
+#include <QtDebug>
+#include <QStatusBar>
 #include <Script/CodeEditor.h>
 #include <Script/Terminal2.h>
 using namespace Fln;
@@ -79,8 +94,11 @@ static inline QDockWidget* createDock( QMainWindow* parent, const QString& title
 }
 
 MainWindow::MainWindow(Udb::Transaction *txn)
-    : QMainWindow(0), d_txn(txn),d_fullScreen(false),d_selectLock(false),d_pushBackLock(false)
+    : QMainWindow(0), d_txn(txn),d_fullScreen(false),d_selectLock(false),d_pushBackLock(false),
+      d_sys(0),d_sv(0),d_stage(0)
 {
+    d_startup.start();
+    Epk::Procs::s_commitWindow = QSettings().value( "Commit/Window", Epk::Procs::s_commitWindow ).toInt();
     setAttribute( Qt::WA_DeleteOnClose );
     Q_ASSERT( txn != 0 );
 
@@ -97,6 +115,7 @@ MainWindow::MainWindow(Udb::Transaction *txn)
     setCorner( Qt::TopRightCorner, Qt::RightDockWidgetArea );
 	setCorner( Qt::TopLeftCorner, Qt::LeftDockWidgetArea );
 
+    d_thumbs = new Epk::ThumbnailService( d_txn, this );
     setupAttrView();
     setupTextView();
     setupLinkView();
@@ -104,10 +123,15 @@ MainWindow::MainWindow(Udb::Transaction *txn)
     setupFolders();
     setupAllocView();
     setupOverview();
-    setupSearchView();
-    setupSysTree();
-	setupTerminal();
 	setupItemRefView();
+    // Inhalt folgt in onStartupStage()
+    d_searchDock = createPlaceholder( tr("Search" ), Qt::RightDockWidgetArea, false );
+    d_sysDock = createPlaceholder( tr("System Tree"), Qt::RightDockWidgetArea, true );
+    d_termDock = createPlaceholder( tr("Lua Terminal"), Qt::BottomDockWidgetArea, false );
+    qDebug() << "Startup: core docks" << d_startup.elapsed() << "ms";
+
+	d_sweeper = new Epk::OrphanSweeper( d_txn, this );
+	d_hash = new Epk::ContentHash( d_txn, this );
 
     QSettings set;
     QVariant state = set.value( "MainFrame/State/" + d_txn->getDb()->getDbUuid().toString() ); // Da DB-individuelle Docks
@@ -149,7 +173,88 @@ MainWindow::MainWindow(Udb::Transaction *txn)
     new Gui2::AutoShortcut( tr("ALT+DOWN"), this,  this, SLOT(onShowSubTask()) );
     new Gui2::AutoShortcut( tr("ALT+HOME"), this,  this, SLOT(onFollowAlias()) );
 
-	onFollowObject( Epk::Index::getRoot(d_txn).getValueAsObj(Epk::Root::AttrAutoOpen) );
+	QTimer* hibernator = new QTimer( this );
+	connect( hibernator, SIGNAL(timeout()), this, SLOT(onHibernateTabs()) );
+	hibernator->start( 30000 );
+
+	if( Epk::IndexBuilder* ib = Epk::IndexBuilder::find( d_txn->getDb() ) )
+	{
+		connect( ib, SIGNAL(signalProgress(QString,int,int)), this, SLOT(onIndexProgress(QString,int,int)) );
+		ib->start( true ); // baut im GUI-Thread, deshalb erst wenn der Benutzer nichts tut
+	}
+	if( RefUpdater* ru = RefUpdater::find( d_txn->getDb() ) )
+	{
+		connect( ru, SIGNAL(signalDone(bool)), this, SLOT(onRefDone(bool)) );
+	}
+	QTimer::singleShot( 0, this, SLOT(onStartupStage()) );
+}
+
+QDockWidget* MainWindow::createPlaceholder(const QString &title, Qt::DockWidgetArea area, bool visi)
+{
+    QDockWidget* dock = createDock( this, title, 0, visi );
+    QLabel* l = new QLabel( tr("Loading..."), dock );
+    l->setAlignment( Qt::AlignCenter );
+    l->setEnabled( false );
+    dock->setWidget( l );
+    addDockWidget( area, dock );
+    return dock;
+}
+
+void MainWindow::onStartupStage()
+{
+    // Eine Stufe pro Durchlauf der Event-Loop, damit das Fenster dazwischen gezeichnet und bedienbar ist
+    QTime t;
+    t.start();
+    const char* what = 0;
+    switch( d_stage++ )
+    {
+    case 0:
+        setupSysTree();
+        what = "system tree";
+        break;
+    case 1:
+        setupSearchView();
+        what = "search view";
+        break;
+    case 2:
+        setupTerminal();
+        what = "terminal";
+        break;
+    case 3:
+        if( d_tab->count() == 0 ) // nicht, wenn showOid bereits etwas geoeffnet hat
+            onFollowObject( Epk::Index::getRoot(d_txn).getValueAsObj(Epk::Root::AttrAutoOpen) );
+        what = "auto open";
+        break;
+    default:
+        {
+            QSettings set;
+            const QString key = "Delta/UuidsAssigned/" + d_txn->getDb()->getDbUuid().toString();
+            if( set.value( key ).toInt() < 2 ) // 2..auch unter RootFolder
+            {
+                // Einmalig fuer Repositories aus der Zeit, als Uuids erst beim Export vergeben wurden
+                if( Epk::EpkDelta::assignUuids( d_txn ) > 0 )
+                    d_txn->commit();
+                set.setValue( key, 2 );
+            }
+            // Tombstones bleiben fuer alle Kopien, die irgendwann ab einem frueheren Datum abgleichen,
+            // bis zum Ablauf der Frist; 0..nie entfernen
+            const int days = set.value( "Delta/TombstoneDays", 365 ).toInt();
+            if( days > 0 && Epk::EpkDelta::purgeTombstones( d_txn,
+                                                            QDateTime::currentDateTime().addDays( -days ) ) > 0 )
+                d_txn->commit();
+        }
+        d_sweeper->start( 10000 ); // erst wenn der Start abgeschlossen ist
+        if( RefUpdater* ru = RefUpdater::find( d_txn->getDb() ) )
+        {
+            // Nicht selber starten, der Neuaufbau blockiert; nur darauf hinweisen
+            if( ru->getState() != RefUpdater::Clean )
+                statusBar()->showMessage( tr("References need an update, see Configuration/Update Indices") );
+        }
+        qDebug() << "Startup: complete after" << d_startup.elapsed() << "ms";
+        return;
+    }
+    qDebug() << "Startup:" << what << t.elapsed() << "ms";
+    QTimer::singleShot( 0, this, SLOT(onStartupStage()) );
 }
 
 MainWindow::~MainWindow()
@@ -175,6 +280,7 @@ void MainWindow::onTabChanged(int i)
     {
         if( Epk::EpkView* v = dynamic_cast<Epk::EpkView*>( d_tab->widget( i ) ) )
         {
+            v->getCtrl()->wakeUp();
             d_ov->setObserved( v );
             d_lv->setObserved( v );
             Udb::Obj o = v->getCtrl()->getSingleSelection();
@@ -209,6 +315,7 @@ void MainWindow::toFullScreen(QMainWindow * w)
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+    Epk::Procs::flushCommits( d_txn );
     QSettings set;
     set.setValue("MainFrame/State/" + d_txn->getDb()->getDbUuid().toString(), saveState() );
     QMainWindow::closeEvent( event );
@@ -298,6 +405,17 @@ void MainWindow::addTopCommands(Gui2::AutoMenu * pop)
 	sub->addCommand( "Set Script Font...", this, SLOT(onSetScriptFont()) );
 	sub->addCommand( tr("Full Screen"), this, SLOT(onFullScreen()), tr("F11") )->setCheckable(true);
 	sub->addCommand( tr("Update Indices..."), this, SLOT(onRebuildIndices()) );
+	sub->addCommand( tr("Build Missing Indices"), this, SLOT(onBuildIndices()) );
+	sub->addCommand( tr("Verify Indices..."), this, SLOT(onVerifyIndices()) );
+	sub->addCommand( tr("Set Tab Hibernation..."), this, SLOT(onSetHibernation()) );
+	sub->addCommand( tr("Remove Orphans"), this, SLOT(onSweepOrphans()) );
+	sub->addCommand( tr("Set Cache Size..."), this, SLOT(onSetCacheSize()) );
+	sub->addCommand( tr("Cache Statistics..."), this, SLOT(onCacheStatistics()) );
+	sub->addCommand( tr("Set Commit Delay..."), this, SLOT(onSetCommitWindow()) );
+	sub = new Gui2::AutoMenu( tr("Synchronize" ), pop );
+	pop->addMenu( sub );
+	sub->addCommand( tr("Export Changes..."), this, SLOT(onExportDelta()) );
+	sub->addCommand( tr("Import Changes..."), this, SLOT(onImportDelta()) );
 
 	pop->addCommand( tr("About FlowLine..."), this, SLOT(onAbout()) );
     pop->addSeparator();
@@ -365,9 +483,10 @@ void MainWindow::setupFunctions()
     Epk::FuncDomain root = Epk::FuncDomain::getOrCreateRoot( d_txn );
     root.setText( root.formatObjectTitle() );
     d_txn->commit();
-    d_ft = FuncTreeCtrl::create( dock, root );
+    d_ft = FuncTreeCtrl::create( dock, root, d_thumbs );
     Gui2::AutoMenu* pop = new Gui2::AutoMenu( d_ft->getTree(), true );
     pop->addCommand( tr("Open Diagram"), this, SLOT(onOpenEpkDiagram()) );
+    pop->addCommand( tr("Compare With..."), this, SLOT(onCompare()) );
     pop->addSeparator();
     d_ft->addCommands( pop );
     addTopCommands( pop );
@@ -384,7 +503,7 @@ void MainWindow::setupFolders()
     Udb::RootFolder root = Udb::RootFolder::getOrCreate( d_txn );
     root.setText( Epk::Procs::formatObjectTitle(root) );
     d_txn->commit();
-    d_fldr = FolderCtrl::create( dock, root );
+    d_fldr = FolderCtrl::create( dock, root, d_thumbs );
     Gui2::AutoMenu* pop = new Gui2::AutoMenu( d_fldr->getTree(), true );
     pop->addCommand( tr("Open Document"), this, SLOT(onOpenDocument()) );
     pop->addSeparator();
@@ -398,7 +517,8 @@ void MainWindow::setupFolders()
 
 void MainWindow::setupSysTree()
 {
-    QDockWidget* dock = createDock( this, tr("System Tree"), 0, true );
+    QDockWidget* dock = d_sysDock;
+    delete dock->widget();
 
     Epk::SystemElement root = Epk::SystemElement::getOrCreateRoot( d_txn );
     root.setText( Epk::Procs::formatObjectTitle(root) );
@@ -409,15 +529,14 @@ void MainWindow::setupSysTree()
     addTopCommands( pop );
     connect( d_sys, SIGNAL(signalSelected(Udb::Obj)), this, SLOT(onSysSelected(Udb::Obj)) );
     dock->setWidget( d_sys->getTree() );
-    addDockWidget( Qt::RightDockWidgetArea, dock );
 }
 
 void MainWindow::setupSearchView()
 {
+    QDockWidget* dock = d_searchDock;
+    delete dock->widget();
     d_sv = new Wt::SearchView( this, d_txn );
-    QDockWidget* dock = createDock( this, tr("Search" ), 0, false );
     dock->setWidget( d_sv );
-    addDockWidget( Qt::RightDockWidgetArea, dock );
 
     connect( d_sv, SIGNAL(signalShowItem(Udb::Obj)), this, SLOT(onSearchSelected(Udb::Obj) ) );
     connect( d_sv, SIGNAL(signalOpenItem(Udb::Obj) ), this, SLOT(onFollowObject(Udb::Obj) ) );
@@ -435,10 +554,10 @@ void MainWindow::setupSearchView()
 
 void MainWindow::setupTerminal()
 {
-	QDockWidget* dock = createDock( this, tr("Lua Terminal"), 0, false );
+	QDockWidget* dock = d_termDock;
+	delete dock->widget();
 	Lua::Terminal2* term = new Lua::Terminal2( dock );
 	dock->setWidget( term );
-	addDockWidget( Qt::BottomDockWidgetArea, dock );
 }
 
 static QString _formatTitle(const Udb::Obj & o )
@@ -623,6 +742,7 @@ void MainWindow::openEpkDiagram(const Udb::Obj & doc, const Udb::Obj &select)
     ctrl->addCommands( pop );
     addTopCommands( pop );
     connect( ctrl, SIGNAL(signalSelectionChanged()), this, SLOT(onPdmSelection()) );
+    connect( ctrl, SIGNAL(signalDiagramErased()), this, SLOT(onDiagramErased()), Qt::QueuedConnection );
 
     d_tab->addDoc( ctrl->getView(), doc, Epk::Procs::formatObjectTitle( doc ) );
     ctrl->focusOn( select );
@@ -768,6 +888,7 @@ void MainWindow::handleExecute()
 {
 	Lua::CodeEditor* e = dynamic_cast<Lua::CodeEditor*>( d_tab->currentWidget() );
 	ENABLED_IF( !Lua::Engine2::getInst()->isExecuting() && e != 0 );
+	Epk::Procs::flushCommits( d_txn ); // Skripte koennen rollback aufrufen
 	Lua::Engine2::getInst()->executeCmd( e->text().toLatin1(), ( e->getName().isEmpty() ) ?
 											 QByteArray("#Editor") : e->getName().toLatin1() );
 }
@@ -817,15 +938,78 @@ void MainWindow::onItemActivated(quint64 id)
 
 void MainWindow::onRebuildIndices()
 {
-	ENABLED_IF(true);
-	if( QMessageBox::warning( this, tr("Update Indices - FlowLine"),
-		tr("This operation can take some Time. Do you want to continue?" ),
-		QMessageBox::Yes | QMessageBox::No, QMessageBox::No ) == QMessageBox::No )
+	RefUpdater* ru = RefUpdater::find( d_txn->getDb() );
+	ENABLED_IF( ru != 0 && !ru->isRunning() );
+
+	const QString msg = ( ru->getState() == RefUpdater::Clean ) ?
+		tr("References are maintained on each commit and are up to date. "
+		   "Do you want to rebuild them anyway? FlowLine is blocked until this is done.") :
+		tr("References need an update. Do you want to rebuild them now? "
+		   "FlowLine is blocked until this is done.");
+	if( QMessageBox::question( this, tr("Update Indices - FlowLine"), msg,
+		QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes ) == QMessageBox::No )
 		return;
+	d_txn->commit(); // die eigene Transaction des RefUpdater sieht nur Committetes
+	if( ru->start() )
+		statusBar()->showMessage( ru->formatReport() );
+}
+
+void MainWindow::onRefDone(bool ok)
+{
+	RefUpdater* ru = RefUpdater::find( d_txn->getDb() );
+	if( ru == 0 )
+		return;
+	statusBar()->showMessage( ru->formatReport(), 10000 );
+	if( !ok )
+		QMessageBox::warning( this, tr("Update Indices - FlowLine"), ru->formatReport() );
+}
 
+void MainWindow::onIndexProgress(const QString &index, int done, int total)
+{
+	if( index.isEmpty() )
+		statusBar()->clearMessage();
+	else
+		statusBar()->showMessage( tr("Building index %1 (%2 of %3)...").arg( index ).arg( done + 1 ).arg( total ) );
+}
+
+void MainWindow::onBuildIndices()
+{
+	Epk::IndexBuilder* ib = Epk::IndexBuilder::find( d_txn->getDb() );
+	ENABLED_IF( ib != 0 && ( !ib->isRunning() || ib->isWaiting() ) &&
+				!Epk::Index::getPending( d_txn->getDb() ).isEmpty() );
+
+	ib->start( false );
+}
+
+void MainWindow::onVerifyIndices()
+{
+	Epk::IndexBuilder* ib = Epk::IndexBuilder::find( d_txn->getDb() );
+	ENABLED_IF( ib != 0 );
+
+	// Die Wurzeln werden hier bestimmt (im Konstruktor ohnehin angelegt); die Worker legen nichts an
+	QList<Udb::OID> roots;
+	roots << Epk::FuncDomain::getOrCreateRoot( d_txn ).getOid() <<
+			 Epk::SystemElement::getOrCreateRoot( d_txn ).getOid() <<
+			 Udb::RootFolder::getOrCreate( d_txn ).getOid();
+	d_txn->commit(); // die Snapshots sehen nur Committetes
 	QApplication::setOverrideCursor( Qt::WaitCursor );
-	Oln::OutlineItem::updateAllRefs( d_txn );
+	const QList<Epk::IndexBuilder::Check> res = ib->verify( roots );
 	QApplication::restoreOverrideCursor();
+	QString msg;
+	foreach( const Epk::IndexBuilder::Check& c, res )
+	{
+		if( c.d_pending )
+			msg += tr("%1: not yet built\n").arg( c.d_name.data() );
+		else if( c.d_stale < 0 )
+			msg += tr("%1: error while reading\n").arg( c.d_name.data() );
+		else
+			msg += tr("%1: %2 entries, %3 stale, %4 under wrong key; %5 of %6 objects missing\n").
+				arg( c.d_name.data() ).arg( c.d_entries ).arg( c.d_stale ).arg( c.d_mismatch ).
+				arg( c.d_missing ).arg( c.d_objects );
+		if( c.d_inconsistent )
+			msg += tr("%1: database changed during verification, numbers may be off\n").arg( c.d_name.data() );
+	}
+	QMessageBox::information( this, tr("Verify Indices - FlowLine"), msg );
 }
 
 void MainWindow::onAutoStart()
@@ -985,11 +1169,273 @@ void MainWindow::onUrlActivated(const QUrl & url)
 
 void MainWindow::onSearch()
 {
-    ENABLED_IF( true );
+    ENABLED_IF( d_sv != 0 ); // Suche wird erst in onStartupStage() aufgebaut
 
     d_sv->parentWidget()->show();
     d_sv->parentWidget()->raise();
     d_sv->onNew();
 }
 
+static bool _lessIdle( Epk::EpkCtrl* lhs, Epk::EpkCtrl* rhs )
+{
+	return lhs->idleSecs() < rhs->idleSecs();
+}
+
+void MainWindow::onHibernateTabs()
+{
+	// Diagramme im Hintergrund geben nach einer Leerlaufzeit ihre Scene frei. Zusaetzlich bleiben
+	// hoechstens MaxAwakeTabs Diagramme wach, damit der Speicher unabhaengig von der Anzahl Tabs begrenzt ist.
+	QSettings set;
+	const int idleMin = set.value( "Diagram/HibernateAfter", 10 ).toInt(); // Minuten, 0..nie
+	const int maxAwake = set.value( "Diagram/MaxAwakeTabs", 8 ).toInt();
+	if( idleMin <= 0 )
+		return;
+	QList<Epk::EpkCtrl*> awake;
+	for( int i = 0; i < d_tab->count(); i++ )
+	{
+		Epk::EpkView* v = dynamic_cast<Epk::EpkView*>( d_tab->widget(i) );
+		if( v == 0 || v->getCtrl() == 0 )
+			continue;
+		Epk::EpkCtrl* c = v->getCtrl();
+		if( i == d_tab->currentIndex() )
+			c->touch(); // das aktuelle Diagramm ist nie im Leerlauf
+		else if( !c->isHibernated() )
+		{
+			if( c->idleSecs() >= idleMin * 60 )
+				c->hibernate();
+			else
+				awake.append( c );
+		}
+	}
+	if( maxAwake > 0 && awake.size() >= maxAwake )
+	{
+		qSort( awake.begin(), awake.end(), _lessIdle );
+		for( int i = maxAwake - 1; i < awake.size(); i++ ) // -1 fuer das aktuelle
+			awake[i]->hibernate();
+	}
+}
+
+void MainWindow::onDiagramErased()
+{
+	// Ein schlafender Tab hat sein Diagramm verloren; gleich schliessen wie mit "Close Tab"
+	Epk::EpkCtrl* c = dynamic_cast<Epk::EpkCtrl*>( sender() );
+	if( c == 0 )
+		return;
+	const int pos = d_tab->indexOf( c->getView() );
+	if( pos == -1 )
+		return;
+	QWidget* cur = d_tab->currentWidget();
+	d_tab->setCurrentIndex( pos );
+	QMetaObject::invokeMethod( d_tab, "onCloseDoc" );
+	if( cur != c->getView() )
+	{
+		const int old = d_tab->indexOf( cur );
+		if( old != -1 )
+			d_tab->setCurrentIndex( old );
+	}
+}
+
+void MainWindow::onSetHibernation()
+{
+	ENABLED_IF( true );
+	QSettings set;
+	bool ok;
+	const int res = QInputDialog::getInteger( this, tr("Set Tab Hibernation - FlowLine"),
+		tr("Release background diagrams after idle minutes (0..never):"),
+		set.value( "Diagram/HibernateAfter", 10 ).toInt(), 0, 24 * 60, 1, &ok );
+	if( !ok )
+		return;
+	set.setValue( "Diagram/HibernateAfter", res );
+	onHibernateTabs();
+}
 
+void MainWindow::onSetCacheSize()
+{
+	CacheTuner* t = CacheTuner::find( d_txn->getDb() );
+	ENABLED_IF( t != 0 );
+	bool ok;
+	const int res = QInputDialog::getInteger( this, tr("Set Cache Size - FlowLine"),
+		tr("Cache size of this repository in pages of %1 bytes (0..automatic):").arg( CacheTuner::s_pageSize ),
+		( t->isFixed() ) ? t->getCacheSize() : 0, 0, t->getMaxSize(), 1000, &ok );
+	if( !ok )
+		return;
+	t->setFixedSize( res );
+}
+
+void MainWindow::onSetCommitWindow()
+{
+	ENABLED_IF( true );
+	bool ok;
+	const int ms = QInputDialog::getInteger( this, tr("Set Commit Delay - FlowLine"),
+		tr("Milliseconds to collect interactive changes into one commit (0 = commit immediately):"),
+		Epk::Procs::s_commitWindow, 0, 5000, 50, &ok );
+	if( !ok )
+		return;
+	Epk::Procs::flushCommits( d_txn );
+	Epk::Procs::s_commitWindow = ms;
+	QSettings set;
+	set.setValue( "Commit/Window", ms );
+}
+
+void MainWindow::onCacheStatistics()
+{
+	CacheTuner* t = CacheTuner::find( d_txn->getDb() );
+	ENABLED_IF( t != 0 );
+	QMessageBox::information( this, tr("Cache Statistics - FlowLine"), t->formatStatistics() );
+}
+
+void MainWindow::onSweepOrphans()
+{
+	ENABLED_IF( !d_sweeper->isRunning() );
+	d_sweeper->start();
+}
+
+void MainWindow::onExportDelta()
+{
+	ENABLED_IF( true );
+	QSettings set;
+	const QString key = "Delta/LastExport/" + d_txn->getDb()->getDbUuid().toString();
+	bool ok;
+	const QString since = QInputDialog::getText( this, tr("Export Changes - FlowLine"),
+		tr("Export changes since (yyyy-MM-dd hh:mm):"), QLineEdit::Normal,
+		set.value( key, QDateTime( QDate( 2000, 1, 1 ) ) ).toDateTime().toString( "yyyy-MM-dd hh:mm" ), &ok );
+	if( !ok )
+		return;
+	const QDateTime t = QDateTime::fromString( since, "yyyy-MM-dd hh:mm" );
+	if( !t.isValid() )
+	{
+		QMessageBox::critical( this, tr("Export Changes - FlowLine"), tr("Invalid date: %1").arg( since ) );
+		return;
+	}
+	const QString path = QFileDialog::getSaveFileName( this, tr("Export Changes - FlowLine"),
+		QString(), tr("*.flnd") );
+	if( path.isEmpty() )
+		return;
+	QFile f( path );
+	if( !f.open( QIODevice::WriteOnly ) )
+	{
+		QMessageBox::critical( this, tr("Export Changes - FlowLine"),
+			tr("Cannot open file for writing: %1").arg( path ) );
+		return;
+	}
+	const QDateTime now = QDateTime::currentDateTime();
+	QApplication::setOverrideCursor( Qt::WaitCursor );
+	const int n = Epk::EpkDelta::exportDelta( &f, d_txn, t );
+	d_txn->commit(); // wegen neu vergebener Uuids
+	QApplication::restoreOverrideCursor();
+	if( n < 0 )
+	{
+		QMessageBox::critical( this, tr("Export Changes - FlowLine"), tr("Error writing file") );
+		return;
+	}
+	set.setValue( key, now );
+	QMessageBox::information( this, tr("Export Changes - FlowLine"), tr("%1 changes exported").arg( n ) );
+}
+
+void MainWindow::onImportDelta()
+{
+	ENABLED_IF( true );
+	const QString path = QFileDialog::getOpenFileName( this, tr("Import Changes - FlowLine"),
+		QString(), tr("*.flnd") );
+	if( path.isEmpty() )
+		return;
+	QFile f( path );
+	if( !f.open( QIODevice::ReadOnly ) )
+	{
+		QMessageBox::critical( this, tr("Import Changes - FlowLine"),
+			tr("Cannot open file for reading: %1").arg( path ) );
+		return;
+	}
+	Epk::EpkDelta delta;
+	QApplication::setOverrideCursor( Qt::WaitCursor );
+	Epk::Procs::flushCommits( d_txn );
+	CacheTuner::ForeignIo io( d_txn->getDb() );
+	Epk::OrphanSweeper::Suspend sweep( d_txn->getDb() );
+	const int n = delta.importDelta( &f, d_txn );
+	if( n < 0 )
+		d_txn->rollback();
+	else
+	{
+		d_txn->commit();
+		if( RefUpdater* ru = RefUpdater::find( d_txn->getDb() ) )
+			ru->markDirty(); // Texte wurden an Oln vorbei geschrieben
+	}
+	QApplication::restoreOverrideCursor();
+	if( n < 0 )
+		QMessageBox::critical( this, tr("Import Changes - FlowLine"), delta.getError() );
+	else
+		QMessageBox::information( this, tr("Import Changes - FlowLine"), tr("%1 changes applied").arg( n ) );
+}
+
+void MainWindow::onCompare()
+{
+	Udb::Obj doc = d_ft->getSelectedObject();
+	ENABLED_IF( doc.getType() == Epk::Function::TID || doc.getType() == Epk::FuncDomain::TID );
+
+	// Gegenstueck im selben oder einem anderen offenen Repository ueber den Schluessel suchen
+	const QList<MainWindow*>& docs = FlowLine2App::inst()->getDocs();
+	QStringList repos;
+	foreach( MainWindow* w, docs )
+		repos << QFileInfo( w->getTxn()->getDb()->getFilePath() ).fileName();
+	bool ok;
+	const QString sel = QInputDialog::getItem( this, tr("Compare - FlowLine"), tr("Compare with repository:"),
+		repos, docs.indexOf( this ), false, &ok );
+	if( !ok )
+		return;
+	MainWindow* other = docs.value( repos.indexOf( sel ) );
+	if( other == 0 )
+		return;
+	QString key = Epk::ContentHash::keyOf( doc );
+	if( other == this || doc.getParent().isNull() )
+	{
+		key = QInputDialog::getText( this, tr("Compare - FlowLine"), tr("Compare with function or domain (ID):"),
+			QLineEdit::Normal, ( other == this ) ? QString() : key, &ok );
+		if( !ok )
+			return;
+	}
+	Udb::Obj right = Epk::ContentHash::findByKey( other->getTxn(), key );
+	if( right.isNull() && doc.equals( Epk::FuncDomain::getOrCreateRoot( d_txn ) ) )
+		right = Epk::FuncDomain::getOrCreateRoot( other->getTxn() );
+	if( right.isNull() )
+	{
+		QMessageBox::information( this, tr("Compare - FlowLine"), tr("No counterpart found for '%1'").arg( key ) );
+		return;
+	}
+	QSettings set;
+	const bool layout = set.value( "Compare/WithLayout", false ).toBool();
+	d_hash->setWithLayout( layout );
+	other->getContentHash()->setWithLayout( layout );
+	QApplication::setOverrideCursor( Qt::WaitCursor );
+	const QList<Epk::ContentHash::Diff> diffs = Epk::ContentHash::compare( *d_hash, doc,
+		*other->getContentHash(), right );
+	QApplication::restoreOverrideCursor();
+	if( diffs.isEmpty() )
+	{
+		QMessageBox::information( this, tr("Compare - FlowLine"), tr("No differences found") );
+		return;
+	}
+	QListWidget* list = new QListWidget( this );
+	list->setWindowFlags( Qt::Tool );
+	list->setAttribute( Qt::WA_DeleteOnClose );
+	list->setWindowTitle( tr("Differences to %1 - FlowLine").arg( sel ) );
+	foreach( const Epk::ContentHash::Diff& d, diffs )
+	{
+		QListWidgetItem* i = new QListWidgetItem( list );
+		if( d.d_right.isNull() )
+			i->setText( tr("only here: %1").arg( Epk::Procs::formatObjectTitle( d.d_left ) ) );
+		else if( d.d_left.isNull() )
+			i->setText( tr("only there: %1").arg( Epk::Procs::formatObjectTitle( d.d_right ) ) );
+		else
+			i->setText( tr("changed: %1").arg( Epk::Procs::formatObjectTitle( d.d_left ) ) );
+		i->setData( Qt::UserRole, d.d_left.getOid() );
+	}
+	connect( list, SIGNAL(itemDoubleClicked(QListWidgetItem*)), this, SLOT(onCompareActivated(QListWidgetItem*)) );
+	list->show();
+}
+
+void MainWindow::onCompareActivated(QListWidgetItem * i)
+{
+	const quint64 oid = i->data( Qt::UserRole ).toULongLong();
+	if( oid != 0 )
+		onFollowObject( d_txn->getObject( oid ) );
+}
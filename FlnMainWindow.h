@@ -21,6 +21,7 @@
 */
 
 #include <QMainWindow>
+#include <QTime>
 #include <Udb/Transaction.h>
 #include <Gui2/AutoMenu.h>
 
@@ -39,7 +40,12 @@ namespace Wt
 namespace Epk
 {
     class EpkLinkViewCtrl;
+    class OrphanSweeper;
+    class ContentHash;
+    class ThumbnailService;
 }
+class QListWidgetItem;
+class QDockWidget;
 namespace Fln
 {
     class FuncTreeCtrl;
@@ -58,6 +64,7 @@ namespace Fln
         MainWindow(Udb::Transaction* txn);
         ~MainWindow();
         Udb::Transaction* getTxn() const { return d_txn; }
+        Epk::ContentHash* getContentHash() const { return d_hash; }
 		void showOid(quint64 oid);
     signals:
         void closing();
@@ -93,6 +100,22 @@ namespace Fln
 		void onItemActivated(quint64);
 		void onRebuildIndices();
 		void onAutoStart();
+		void onHibernateTabs();
+		void onDiagramErased();
+		void onStartupStage();
+		void onIndexProgress( const QString& index, int done, int total );
+		void onBuildIndices();
+		void onVerifyIndices();
+		void onRefDone( bool ok );
+		void onSetHibernation();
+		void onSweepOrphans();
+		void onSetCacheSize();
+		void onCacheStatistics();
+		void onSetCommitWindow();
+		void onExportDelta();
+		void onImportDelta();
+		void onCompare();
+		void onCompareActivated( QListWidgetItem* );
 	protected:
         void setCaption();
         void addTopCommands( Gui2::AutoMenu* );
@@ -106,6 +129,7 @@ namespace Fln
         void setupSysTree();
         void setupSearchView();
 		void setupTerminal();
+		QDockWidget* createPlaceholder( const QString& title, Qt::DockWidgetArea, bool visi );
 		void setupItemRefView();
 		void pushBack(const Udb::Obj & o); // TODO: Db-Callback und gelschte Objekte aus History entfernen
         void showInEpkDiagram( const Udb::Obj& select, bool checkAllOpenDiagrams );
@@ -124,6 +148,9 @@ namespace Fln
         SysTreeCtrl* d_sys;
 		Wt::RefByViewCtrl* d_rbv;
 		AllocViewCtrl* d_alloc;
+		Epk::OrphanSweeper* d_sweeper;
+		Epk::ContentHash* d_hash;
+		Epk::ThumbnailService* d_thumbs;
         Wt::SceneOverview* d_ov;
         Wt::SearchView* d_sv;
         Udb::Transaction* d_txn;
@@ -133,6 +160,13 @@ namespace Fln
         bool d_pushBackLock;
         bool d_fullScreen;
         bool d_selectLock;
+        // Gestaffelter Start: diese Docks existieren ab Konstruktor als Platzhalter (fuer restoreState)
+        // und werden in onStartupStage() nacheinander gefuellt
+        QDockWidget* d_searchDock;
+        QDockWidget* d_sysDock;
+        QDockWidget* d_termDock;
+        QTime d_startup;
+        int d_stage;
     };
 }
 
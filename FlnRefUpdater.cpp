@@ -0,0 +1,122 @@
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include "FlnRefUpdater.h"
+#include <Udb/Database.h>
+#include <Udb/DatabaseException.h>
+#include <Udb/Transaction.h>
+#include <Oln2/OutlineItem.h>
+#include <QApplication>
+#include <QSettings>
+#include <QTimer>
+using namespace Fln;
+
+static QString _update( Udb::Database* db )
+{
+    // Im GUI-Thread mit eigener Transaction; Udb verkraftet keine Schreiber aus anderen Threads
+    try
+    {
+        Udb::Transaction txn( db, 0 );
+        Oln::OutlineItem::updateAllRefs( &txn );
+        txn.commit();
+        return QString();
+    }catch( Udb::DatabaseException& e )
+    {
+        return QString( "%1: %2" ).arg( e.getCodeString() ).arg( e.getMsg() );
+    }
+}
+
+RefUpdater::RefUpdater(Udb::Database * db):QObject(db),d_db(db),d_lastMs(-1),d_running(false)
+{
+    Q_ASSERT( db != 0 );
+}
+
+RefUpdater *RefUpdater::find(Udb::Database * db)
+{
+    if( db == 0 )
+        return 0;
+    return db->findChild<RefUpdater*>();
+}
+
+QString RefUpdater::settingsKey() const
+{
+    return QString( "Refs/State/%1" ).arg( d_db->getDbUuid().toString() );
+}
+
+RefUpdater::State RefUpdater::getState() const
+{
+    if( d_running )
+        return Running;
+    QSettings set;
+    const State s = State( set.value( settingsKey(), int(Clean) ).toInt() );
+    // Ein gespeichertes Running stammt von einem abgebrochenen Lauf
+    return ( s == Clean ) ? Clean : Dirty;
+}
+
+void RefUpdater::setState(RefUpdater::State s)
+{
+    QSettings set;
+    if( s == Clean )
+        set.remove( settingsKey() );
+    else
+        set.setValue( settingsKey(), int(s) );
+}
+
+void RefUpdater::markDirty()
+{
+    if( !d_running )
+        setState( Dirty );
+}
+
+bool RefUpdater::start()
+{
+    if( d_running )
+        return false;
+    d_running = true;
+    d_error.clear();
+    setState( Running );
+    // Erst im naechsten Durchgang, damit die Statuszeile des Aufrufers vorher gezeichnet wird
+    QTimer::singleShot( 0, this, SLOT(onRun()) );
+    return true;
+}
+
+void RefUpdater::onRun()
+{
+    // updateAllRefs laesst sich weder in Teilen ausfuehren noch abbrechen; die GUI ist solange blockiert
+    QApplication::setOverrideCursor( Qt::WaitCursor );
+    d_time.start();
+    d_error = _update( d_db );
+    d_lastMs = d_time.elapsed();
+    d_running = false;
+    QApplication::restoreOverrideCursor();
+    // Nach einem Fehler bleibt das Repository als dirty markiert
+    setState( ( d_error.isEmpty() ) ? Clean : Dirty );
+    emit signalDone( d_error.isEmpty() );
+}
+
+QString RefUpdater::formatReport() const
+{
+    if( d_running )
+        return tr("Updating references...");
+    if( d_lastMs < 0 )
+        return ( getState() == Clean ) ? tr("References are up to date") : tr("References need an update");
+    if( !d_error.isEmpty() )
+        return tr("Update of references failed after %1 s: %2").arg( d_lastMs / 1000.0, 0, 'f', 1 ).arg( d_error );
+    return tr("References updated in %1 s").arg( d_lastMs / 1000.0, 0, 'f', 1 );
+}
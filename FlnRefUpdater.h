@@ -0,0 +1,69 @@
+#ifndef FLNREFUPDATER_H
+#define FLNREFUPDATER_H
+
+/*
+* Copyright 2010-2018 Rochus Keller <mailto:me@rochus-keller.info>
+*
+* This file is part of the FlowLine2 application.
+*
+* The following is the license that applies to this copy of the
+* application. For a license to use the application under conditions
+* other than those described here, please email to me@rochus-keller.info.
+*
+* GNU General Public License Usage
+* This file may be used under the terms of the GNU General Public
+* License (GPL) versions 2.0 or 3.0 as published by the Free Software
+* Foundation and appearing in the file LICENSE.GPL included in
+* the packaging of this file. Please review the following information
+* to ensure GNU General Public Licensing requirements will be met:
+* http://www.fsf.org/licensing/licenses/info/GPLv2.html and
+* http://www.gnu.org/copyleft/gpl.html.
+*/
+
+#include <QObject>
+#include <QTime>
+
+namespace Udb
+{
+    class Database;
+}
+
+namespace Fln
+{
+    class RefUpdater : public QObject
+    {
+        // Verwaltet den Neuaufbau der Referenzen zwischen Outline-Items (Oln::OutlineItem::updateAllRefs).
+        // Im Normalbetrieb pflegt Oln die Referenzen bei jedem Commit selber (doBackRef); ein Neuaufbau
+        // ist nur noetig, wenn Daten an Oln vorbei geschrieben wurden (Import von Aenderungen, Skripte).
+        // Solche Stellen rufen markDirty(). Der Neuaufbau laeuft mit eigener Transaction im GUI-Thread
+        // und blockiert diesen, da Udb keine Schreiber aus anderen Threads verkraftet; updateAllRefs laesst
+        // sich weder in Teilen ausfuehren noch abbrechen, es gibt deshalb keinen Fortschritt.
+        // Der Zustand steht pro Repository in "Refs/State/<dbuuid>"; wird die Anwendung waehrend des Laufs
+        // beendet, steht dort noch "running", was beim naechsten Oeffnen als Dirty gilt. Gestartet wird
+        // nur auf Verlangen des Benutzers.
+        Q_OBJECT
+    public:
+        enum State { Clean, Dirty, Running };
+        RefUpdater( Udb::Database* ); // Child der Datenbank
+        State getState() const;
+        bool isRunning() const { return d_running; }
+        void markDirty();
+        bool start(); // blockiert die GUI im naechsten Durchgang der Event-Loop bis zum Ende
+        QString formatReport() const;
+        static RefUpdater* find( Udb::Database* );
+    signals:
+        void signalDone( bool ok );
+    protected slots:
+        void onRun();
+    private:
+        void setState( State );
+        QString settingsKey() const;
+        Udb::Database* d_db;
+        QTime d_time;
+        QString d_error;
+        int d_lastMs;
+        bool d_running;
+    };
+}
+
+#endif // FLNREFUPDATER_H
@@ -25,7 +25,7 @@ TEMPLATE = app
 INCLUDEPATH += ../NAF ./.. ../../Libraries
 
 win32 {
-	INCLUDEPATH += $$[QT_INSTALL_PREFIX]/include/Qt
+	INCLUDEPATH += $$[QT_INSTALL_PREFIX]/include/Qt $$[QT_INSTALL_PREFIX]/src/3rdparty/zlib
 	RC_FILE = FlowLine2.rc
 	DEFINES -= UNICODE
 	LIBS += -lQtCLucene
@@ -42,7 +42,7 @@ win32 {
 	MOC_DIR = ./moc
 	QMAKE_CXXFLAGS += -Wno-reorder -Wno-unused-parameter
 	INCLUDEPATH += /home/me/Programme/Qt-4.4.3/include/Qt
-	LIBS += -lQtCLucene
+	LIBS += -lQtCLucene -lz
 	DEFINES += LUA_USE_LINUX
  }
 
@@ -75,6 +75,20 @@ SOURCES += FlnMain.cpp\
     SysTree.cpp \
     AllocViewCtrl.cpp \
 	EpkLuaBinding.cpp \
+    EpkSnapshot.cpp \
+    FlnRefUpdater.cpp \
+    EpkIndexBuilder.cpp \
+    FlnCacheTuner.cpp \
+    EpkThumbnails.cpp \
+    EpkHtmlSite.cpp \
+    EpkSvgWriter.cpp \
+    EpkTiles.cpp \
+    EpkBpmn.cpp \
+    EpkHash.cpp \
+    EpkDelta.cpp \
+    EpkArchive.cpp \
+    EpkSweeper.cpp \
+    EpkSpatialIndex.cpp \
     ../WorkTree/RefByViewCtrl.cpp
 
 HEADERS  += \
@@ -105,6 +119,20 @@ HEADERS  += \
     SysTree.h \
     AllocViewCtrl.h \
 	EpkLuaBinding.h \
+    EpkSnapshot.h \
+    FlnRefUpdater.h \
+    EpkIndexBuilder.h \
+    FlnCacheTuner.h \
+    EpkThumbnails.h \
+    EpkHtmlSite.h \
+    EpkSvgWriter.h \
+    EpkTiles.h \
+    EpkBpmn.h \
+    EpkHash.h \
+    EpkDelta.h \
+    EpkArchive.h \
+    EpkSweeper.h \
+    EpkSpatialIndex.h \
     ../WorkTree/RefByViewCtrl.h
 
 
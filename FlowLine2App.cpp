@@ -21,14 +21,27 @@
 #include "FlnMainWindow.h"
 #include "EpkObjects.h"
 #include "FuncsImp.h"
+#include "EpkItemMdl.h"
+#include "FlnCacheTuner.h"
+#include "EpkIndexBuilder.h"
+#include "FlnRefUpdater.h"
+#include "EpkSnapshot.h"
 #include <Oln2/LuaBinding.h>
 #include "EpkLuaBinding.h"
 #include <QApplication>
 #include <QPlastiqueStyle>
 #include <QMessageBox>
 #include <QDesktopServices>
+#include <QtDebug>
+#include <QTime>
+#include <QEventLoop>
+#include <QProgressDialog>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
 #include <Udb/Database.h>
 #include <Udb/DatabaseException.h>
+#include <Udb/Transaction.h>
 #include <Oln2/OutlineUdbMdl.h>
 #include <Oln2/OutlineItem.h>
 #include <Qtl2/Objects.h>
@@ -160,6 +173,58 @@ quint64 parseOid(const QString & cmdLine)
 	return 0;
 }
 
+int FlowLine2App::exportHeadless(const QString &path, quint64 oid, const QString &out, bool withDetails)
+{
+	try
+	{
+		Udb::Database db( 0 );
+		db.open( path );
+		new CacheTuner( &db );
+		Udb::Transaction txn( &db, 0 );
+		Epk::Index::init( db );
+		txn.commit();
+		Udb::Obj doc = txn.getObject( oid );
+		if( doc.isNull() || doc.getType() != Epk::Function::TID )
+		{
+			qWarning() << "export: no diagram with oid" << oid;
+			return -1;
+		}
+		Epk::EpkItemMdl mdl( 0 );
+		mdl.setReadOnly( true );
+		mdl.setDiagram( doc );
+		bool ok = false;
+		if( out.toLower().endsWith( QLatin1String( ".png" ) ) )
+			ok = mdl.exportPng( out );
+		else
+			ok = mdl.exportPdf( out, withDetails );
+		mdl.setDiagram( Udb::Obj() );
+		if( !ok )
+		{
+			qWarning() << "export: cannot write" << out;
+			return -1;
+		}
+		return 0;
+	}catch( Udb::DatabaseException& e )
+	{
+		qWarning() << "export: database error" << e.getCodeString() << e.getMsg();
+		return -1;
+	}
+}
+
+static QString _openDb( Udb::Database* db, QString path )
+{
+	// Laeuft im Worker; db wird von der GUI erst nach Abschluss wieder angefasst
+	try
+	{
+		db->open( path );
+		Epk::Index::init( *db, true ); // fehlende Indizes baut danach der IndexBuilder
+		return QString();
+	}catch( Udb::DatabaseException& e )
+	{
+		return FlowLine2App::tr("Error <%1>: %2").arg( e.getCodeString() ).arg( e.getMsg() );
+	}
+}
+
 class _SplashDialog : public QDialog
 {
 public:
@@ -189,19 +254,51 @@ bool FlowLine2App::open(const QString & cmdLine)
 			return true;
         }
     }
+    if( d_opening.contains( path ) )
+        return true; // die verschachtelte Event-Loop unten hat open() erneut aufgerufen; laeuft bereits
+    QTime total;
+    total.start();
+    QTime t;
+    t.start();
     Udb::Transaction* txn = 0;
     try
     {
         Udb::Database* db = new Udb::Database( this );
-        db->open( path );
-        db->setCacheSize( 10000 ); // RISK
+        // Oeffnen und Indizes anlegen im Worker, damit bereits offene Fenster bedienbar bleiben
+        QFutureWatcher<QString> watcher;
+        QEventLoop loop;
+        connect( &watcher, SIGNAL(finished()), &loop, SLOT(quit()) );
+        d_opening.append( path );
+        watcher.setFuture( QtConcurrent::run( _openDb, db, path ) );
+        if( !watcher.isFinished() )
+        {
+            // Sofort ein Fenster zeigen; das MainWindow selber braucht die offene Datenbank
+            QProgressDialog busy( tr("Opening %1...").arg( QFileInfo( path ).fileName() ), QString(), 0, 0 );
+            busy.setWindowTitle( tr("FlowLine") );
+            busy.setCancelButton( 0 );
+            busy.show();
+            loop.exec( QEventLoop::ExcludeUserInputEvents );
+        }
+        d_opening.removeAll( path );
+        const QString err = watcher.result();
+        if( !err.isEmpty() )
+        {
+            delete db;
+            QMessageBox::critical( 0, tr("Create/Open Repository"), err );
+            return d_docs.isEmpty();
+        }
+        qDebug() << "Startup: open database" << t.restart() << "ms";
+        new CacheTuner( db ); // setzt die Cache-Groesse pro Repository und passt sie an
         txn = new Udb::Transaction( db, this );
-        Epk::Index::init( *db );
         txn->commit();
 		txn->setIndividualNotify(false); // RISK
 		Oln::OutlineItem::doBackRef();
 		txn->addCallback( Oln::OutlineItem::itemErasedCallback );
 		db->registerDatabase();
+		new Epk::IndexBuilder( db ); // gestartet vom MainWindow
+		new RefUpdater( db );
+		new Epk::SnapshotTracker( db ); // Generation fuer Snapshots in Worker-Threads
+		qDebug() << "Startup: register database" << t.restart() << "ms";
 	}catch( Udb::DatabaseException& e )
     {
         QMessageBox::critical( 0, tr("Create/Open Repository"),
@@ -212,7 +309,8 @@ bool FlowLine2App::open(const QString & cmdLine)
     }
     Q_ASSERT( txn != 0 );
 	Epk::LuaBinding::setRepository( Lua::Engine2::getInst()->getCtx(), txn );
-    MainWindow* w = new MainWindow( txn );
+    MainWindow* w = new MainWindow( txn ); // restliche Docks werden danach schrittweise gefuellt
+    qDebug() << "Startup: main window" << t.restart() << "ms, total until visible" << total.elapsed() << "ms";
     connect( w, SIGNAL(closing()), this, SLOT(onClose()) );
 	w->showOid( oid );
 	if( d_docs.isEmpty() )
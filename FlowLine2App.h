@@ -22,6 +22,7 @@
 
 #include <QObject>
 #include <QUuid>
+#include <QStringList>
 #include <Txt/Styles.h>
 
 namespace Fln
@@ -43,6 +44,9 @@ namespace Fln
         ~FlowLine2App();
         static FlowLine2App* inst();
 		bool open(const QString& cmdLine);
+		// Batch-Modus ohne Fenster: exportiert das Diagramm oid nach out (*.pdf oder *.png); 0..ok.
+		// Braucht eine QApplication (Fonts), unter X11 also ein Display, z.B. von Xvfb.
+		static int exportHeadless( const QString& path, quint64 oid, const QString& out, bool withDetails );
         const QList<MainWindow*>& getDocs() const { return d_docs; }
         void setAppFont( const QFont& f );
     public slots:
@@ -51,6 +55,7 @@ namespace Fln
 		void onHandleXoid(const QUrl & url);
     private:
         QList<MainWindow*> d_docs;
+        QStringList d_opening; // Pfade, deren Datenbank gerade im Worker geoeffnet wird
         Txt::Styles* d_styles;
     };
 }
@@ -21,14 +21,25 @@
 #include "EpkObjects.h"
 #include "EpkProcs.h"
 #include "EpkStream.h"
+#include "EpkArchive.h"
+#include "EpkBpmn.h"
+#include "EpkHtmlSite.h"
+#include "EpkThumbnails.h"
 #include "EpkCtrl.h"
+#include "EpkSweeper.h"
+#include "FlnCacheTuner.h"
+#include "FlnRefUpdater.h"
 #include <Oln2/OutlineStream.h>
 #include <QtGui/QTreeView>
 #include <QFileDialog>
+#include <QFile>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QApplication>
 #include <QClipboard>
+#include <QProgressDialog>
+#include <QSettings>
+#include <QInputDialog>
 using namespace Fln;
 
 const char* FuncTreeCtrl::s_mimeFuncTree = "application/flowline/functree-data";
@@ -38,7 +49,7 @@ FuncTreeCtrl::FuncTreeCtrl(QTreeView *tree, Wt::GenericMdl *mdl):
 {
 }
 
-FuncTreeCtrl *FuncTreeCtrl::create(QWidget *parent, const Udb::Obj &root)
+FuncTreeCtrl *FuncTreeCtrl::create(QWidget *parent, const Udb::Obj &root, Epk::ThumbnailService* thumbs)
 {
     QTreeView* tree = new QTreeView( parent );
     tree->setHeaderHidden( true );
@@ -52,6 +63,7 @@ FuncTreeCtrl *FuncTreeCtrl::create(QWidget *parent, const Udb::Obj &root)
     tree->setExpandsOnDoubleClick( false );
 
     FuncTreeMdl* mdl = new FuncTreeMdl( tree );
+    mdl->setThumbnails( thumbs );
     tree->setModel( mdl );
 
     FuncTreeCtrl* ctrl = new FuncTreeCtrl(tree, mdl);
@@ -82,6 +94,10 @@ void FuncTreeCtrl::addCommands(Gui2::AutoMenu * pop)
     pop->addCommand( tr("New Domain"), this, SLOT(onAddDomain()), tr("CTRL+SHIFT+R"), true );
     pop->addCommand( tr("New Sibling"), this, SLOT(onAddNext()), tr("CTRL+N"), true );
     pop->addCommand( tr("Import..."), this, SLOT(onImport()) );
+    pop->addCommand( tr("Export..."), this, SLOT(onExport()) );
+    pop->addCommand( tr("Import BPMN..."), this, SLOT(onImportBpmn()) );
+    pop->addCommand( tr("Export BPMN..."), this, SLOT(onExportBpmn()) );
+    pop->addCommand( tr("Publish HTML Site..."), this, SLOT(onPublishHtml()) );
     pop->addSeparator();
     pop->addCommand( tr("Copy"), this, SLOT( onCopy() ), tr("CTRL+C"), true );
     pop->addCommand( tr("Paste"), this, SLOT( onPaste() ), tr("CTRL+V"), true );
@@ -122,9 +138,31 @@ void FuncTreeCtrl::onToggleType()
         Epk::Procs::retypeObject( doc, Epk::FuncDomain::TID );
     else
         Epk::Procs::retypeObject( doc, Epk::Function::TID );
-    doc.commit();
+    Epk::Procs::deferCommit( doc.getTxn() );
 }
 
+static void _markRefsDirty( Udb::Database* db )
+{
+    // Importe umgehen die Pflege der Referenzen beim Commit
+    RefUpdater* ru = RefUpdater::find( db );
+    if( ru )
+        ru->markDirty();
+}
+
+class _ImportStream : public Epk::EpkStream
+{
+public:
+    QProgressDialog* d_dlg;
+    QIODevice* d_file;
+    _ImportStream( QProgressDialog* dlg, QIODevice* f ):d_dlg(dlg),d_file(f) {}
+    bool progress( int count )
+    {
+        d_dlg->setLabelText( FuncTreeCtrl::tr("%1 objects imported").arg( count ) );
+        d_dlg->setValue( d_file->pos() / 1024 );
+        return !d_dlg->wasCanceled();
+    }
+};
+
 void FuncTreeCtrl::onImport()
 {
     ENABLED_IF( true );
@@ -134,33 +172,289 @@ void FuncTreeCtrl::onImport()
     if( path.isEmpty() )
         return;
 
-    QFile f( path );
-    if( !f.open( QIODevice::ReadOnly ) )
+    Epk::EpkArchive ar;
+    if( !ar.open( path ) )
     {
         QMessageBox::critical( getTree(), tr("Import Function - FlowLine"),
-            tr("Cannot open file for reading!") );
+            tr("Cannot read file: %1").arg( ar.getError() ) );
+        return;
+    }
+    int entry = 0;
+    if( ar.getEntries().size() > 1 )
+    {
+        // Die Datei hat ein Verzeichnis; einzelne Sub-Prozesse koennen ohne den Rest importiert werden
+        QStringList items;
+        for( int i = 0; i < ar.getEntries().size(); i++ )
+        {
+            const Epk::EpkArchive::Entry& e = ar.getEntries()[i];
+            if( ar.isArchive() )
+                items << tr("%1: %2/%3 %4").arg( i ).arg( e.d_path ).arg( e.d_id ).arg( e.d_text );
+            else if( i == 0 )
+                items << tr("%1: whole process %2 %3").arg( i ).arg( e.d_id ).arg( e.d_text );
+            else
+                items << tr("%1: %2 %3").arg( i ).arg( e.d_id ).arg( e.d_text );
+        }
+        if( ar.isArchive() )
+            items << tr("all processes");
+        bool ok;
+        const QString sel = QInputDialog::getItem( getTree(), tr("Import Function - FlowLine"),
+                                                   tr("Select process:"), items, 0, false, &ok );
+        if( !ok )
+            return;
+        entry = items.indexOf( sel );
+    }
+    if( ar.isArchive() && entry == ar.getEntries().size() )
+    {
+        importAll( ar );
         return;
     }
+    Epk::Procs::flushCommits( getMdl()->getRoot().getTxn() ); // ein Fehler rollt sonst Vorgemerktes mit zurueck
     Udb::Obj doc = getSelectedObject();
     if( doc.isNull() )
         doc = Epk::FuncDomain::getOrCreateRoot(getMdl()->getRoot().getTxn());
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    Stream::DataReader in( &f );
-    Epk::EpkStream stream;
-    Udb::Obj o = stream.importProc( in, doc );
+    QProgressDialog dlg( tr("Importing..."), tr("Cancel"), 0, ar.getSize() / 1024, getTree() );
+    dlg.setWindowTitle( tr("Import Function - FlowLine") );
+    dlg.setWindowModality( Qt::WindowModal );
+    dlg.setMinimumDuration( 500 );
+    _ImportStream stream( &dlg, ar.getDevice() );
+    CacheTuner::ForeignIo io( doc.getDb() );
+    Epk::OrphanSweeper::Suspend sweep( doc.getDb() ); // der Dialog laesst die Event-Loop laufen
+    QSettings set;
+    const bool single = entry > 0 || ar.isArchive();
+    if( !single ) // ein einzelner Block wird am Stueck committed bzw. zurueckgerollt
+        stream.setBatchSize( set.value( "Import/BatchSize", 1000 ).toInt() );
+    Udb::Obj o = ar.importEntry( entry, doc, stream );
+    _markRefsDirty( doc.getDb() ); // auch nach Fehler; mit Batches ist schon Teilweises committed
+    const bool canceled = dlg.wasCanceled();
+    dlg.reset();
+    if( single )
+    {
+        // importBlock committed nicht selber
+        if( o.isNull() )
+            doc.getTxn()->rollback();
+        else
+            o.commit();
+    }
     if( o.isNull() )
     {
-        doc.getTxn()->rollback();
-        QApplication::restoreOverrideCursor();
+        if( canceled )
+            return;
         QMessageBox::critical( getTree(), tr("Import Process - FlowLine"), stream.getError() );
         return;
     }
-    o.commit();
+    focusOn( o, true );
+}
+
+void FuncTreeCtrl::importAll(Epk::EpkArchive & ar)
+{
+    // Jeder Prozess des Archivs mit eigenem Commit; die Domain-Struktur wird nicht nachgebildet
+    Epk::Procs::flushCommits( getMdl()->getRoot().getTxn() ); // ein Fehler rollt sonst Vorgemerktes mit zurueck
+    Udb::Obj doc = getSelectedObject();
+    if( doc.isNull() )
+        doc = Epk::FuncDomain::getOrCreateRoot(getMdl()->getRoot().getTxn());
+    QProgressDialog dlg( tr("Importing..."), tr("Cancel"), 0, ar.getSize() / 1024, getTree() );
+    dlg.setWindowTitle( tr("Import Function - FlowLine") );
+    dlg.setWindowModality( Qt::WindowModal );
+    dlg.setMinimumDuration( 500 );
+    CacheTuner::ForeignIo io( doc.getDb() );
+    Epk::OrphanSweeper::Suspend sweep( doc.getDb() ); // der Dialog laesst die Event-Loop laufen
+    Udb::Obj last;
+    for( int i = 0; i < ar.getEntries().size(); i++ )
+    {
+        _ImportStream stream( &dlg, ar.getDevice() );
+        Udb::Obj o = ar.importEntry( i, doc, stream );
+        if( o.isNull() )
+        {
+            doc.getTxn()->rollback();
+            const bool canceled = dlg.wasCanceled();
+            dlg.reset();
+            if( !canceled )
+                QMessageBox::critical( getTree(), tr("Import Process - FlowLine"), stream.getError() );
+            break;
+        }
+        o.commit();
+        last = o;
+    }
+    if( !last.isNull() )
+        _markRefsDirty( doc.getDb() );
+    dlg.reset();
+    if( !last.isNull() )
+        focusOn( last, true );
+}
+
+void FuncTreeCtrl::onExport()
+{
+    Udb::Obj doc = getSelectedObject();
+    ENABLED_IF( doc.getType() == Epk::Function::TID || doc.getType() == Epk::FuncDomain::TID );
+
+    const QString path = QFileDialog::getSaveFileName( getTree(), tr("Export Archive - FlowLine"),
+                                                       doc.getString( Epk::Root::AttrText ), tr("*.flnx") );
+    if( path.isEmpty() )
+        return;
+    QFile f( path );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        QMessageBox::critical( getTree(), tr("Export Archive - FlowLine"),
+            tr("Cannot open file for writing: %1").arg( path ) );
+        return;
+    }
+    QApplication::setOverrideCursor( Qt::WaitCursor ); // die Datenbank wird im GUI-Thread gelesen
+    QSettings set;
+    const int n = Epk::EpkStream::exportArchive( &f, doc, set.value( "Export/Compress", true ).toBool() );
+    doc.commit(); // getUuid kann neue Uuids vergeben haben
+    QApplication::restoreOverrideCursor();
+    if( n < 0 )
+        QMessageBox::critical( getTree(), tr("Export Archive - FlowLine"), tr("Error writing file") );
+    else if( n == 0 )
+        QMessageBox::information( getTree(), tr("Export Archive - FlowLine"), tr("No processes to export") );
+}
+
+class _BpmnImportStream : public Epk::BpmnStream
+{
+public:
+    QProgressDialog* d_dlg;
+    QIODevice* d_file;
+    _BpmnImportStream( QProgressDialog* dlg, QIODevice* f ):d_dlg(dlg),d_file(f) {}
+    bool progress( int count )
+    {
+        d_dlg->setLabelText( FuncTreeCtrl::tr("%1 objects imported").arg( count ) );
+        d_dlg->setValue( d_file->pos() / 1024 );
+        return !d_dlg->wasCanceled();
+    }
+};
+
+void FuncTreeCtrl::onImportBpmn()
+{
+    ENABLED_IF( true );
+
+    const QString path = QFileDialog::getOpenFileName( getTree(), tr("Import BPMN - FlowLine"),
+                                                       QString(), tr("*.bpmn *.xml") );
+    if( path.isEmpty() )
+        return;
+    QFile f( path );
+    if( !f.open( QIODevice::ReadOnly ) )
+    {
+        QMessageBox::critical( getTree(), tr("Import BPMN - FlowLine"),
+            tr("Cannot open file for reading: %1").arg( path ) );
+        return;
+    }
+    Udb::Obj doc = getSelectedObject();
+    if( doc.isNull() )
+        doc = Epk::FuncDomain::getOrCreateRoot(getMdl()->getRoot().getTxn());
+    QProgressDialog dlg( tr("Importing..."), tr("Cancel"), 0, f.size() / 1024, getTree() );
+    dlg.setWindowTitle( tr("Import BPMN - FlowLine") );
+    dlg.setWindowModality( Qt::WindowModal );
+    dlg.setMinimumDuration( 500 );
+    _BpmnImportStream stream( &dlg, &f );
+    CacheTuner::ForeignIo io( doc.getDb() );
+    Epk::OrphanSweeper::Suspend sweep( doc.getDb() ); // der Dialog laesst die Event-Loop laufen
+    QSettings set;
+    stream.setBatchSize( set.value( "Import/BatchSize", 1000 ).toInt() );
+    Udb::Obj o = stream.importProcs( &f, doc );
+    _markRefsDirty( doc.getDb() ); // auch nach Fehler; mit Batches ist schon Teilweises committed
+    const bool canceled = dlg.wasCanceled();
+    dlg.reset();
+    if( o.isNull() )
+    {
+        if( !canceled )
+            QMessageBox::critical( getTree(), tr("Import BPMN - FlowLine"), stream.getError() );
+        return;
+    }
+    focusOn( o, true );
+}
+
+void FuncTreeCtrl::onExportBpmn()
+{
+    Udb::Obj doc = getSelectedObject();
+    ENABLED_IF( doc.getType() == Epk::Function::TID );
+
+    const QString path = QFileDialog::getSaveFileName( getTree(), tr("Export BPMN - FlowLine"),
+                                                       doc.getString( Epk::Root::AttrText ), tr("*.bpmn") );
+    if( path.isEmpty() )
+        return;
+    QFile f( path );
+    if( !f.open( QIODevice::WriteOnly ) )
+    {
+        QMessageBox::critical( getTree(), tr("Export BPMN - FlowLine"),
+            tr("Cannot open file for writing: %1").arg( path ) );
+        return;
+    }
+    QApplication::setOverrideCursor( Qt::WaitCursor );
+    const bool ok = Epk::BpmnStream::exportProc( &f, doc );
     QApplication::restoreOverrideCursor();
+    if( !ok )
+        QMessageBox::critical( getTree(), tr("Export BPMN - FlowLine"), tr("Error writing file") );
 }
 
-FuncTreeMdl::FuncTreeMdl(QObject *parent):GenericMdl(parent)
+class _HtmlSiteProgress : public Epk::HtmlSite
 {
+public:
+    QProgressDialog* d_dlg;
+    int d_count;
+    _HtmlSiteProgress( QProgressDialog* dlg ):d_dlg(dlg),d_count(0) {}
+    bool progress( const Udb::Obj& diagram )
+    {
+        d_dlg->setLabelText( Epk::Procs::formatObjectTitle( diagram ) );
+        d_dlg->setValue( d_count++ );
+        return !d_dlg->wasCanceled();
+    }
+};
+
+void FuncTreeCtrl::onPublishHtml()
+{
+    Udb::Obj doc = getSelectedObject();
+    ENABLED_IF( doc.getType() == Epk::Function::TID || doc.getType() == Epk::FuncDomain::TID );
+
+    QSettings set;
+    const QString dir = QFileDialog::getExistingDirectory( getTree(), tr("Publish HTML Site - FlowLine"),
+                                                           set.value( "HtmlSite/Dir" ).toString() );
+    if( dir.isEmpty() )
+        return;
+    set.setValue( "HtmlSite/Dir", dir );
+    QProgressDialog dlg( tr("Publishing..."), tr("Cancel"), 0, 0, getTree() );
+    dlg.setWindowTitle( tr("Publish HTML Site - FlowLine") );
+    dlg.setMinimumDuration( 500 );
+    _HtmlSiteProgress site( &dlg );
+    Epk::OrphanSweeper::Suspend sweep( doc.getDb() );
+    const int n = site.publish( doc, dir );
+    dlg.close();
+    if( n < 0 )
+        QMessageBox::critical( getTree(), tr("Publish HTML Site - FlowLine"), site.getError() );
+    else
+        QMessageBox::information( getTree(), tr("Publish HTML Site - FlowLine"),
+                                  tr("%1 pages written, %2 unchanged").arg( n ).arg( site.getSkipped() ) );
+}
+
+FuncTreeMdl::FuncTreeMdl(QObject *parent):GenericMdl(parent),d_thumbs(0)
+{
+}
+
+void FuncTreeMdl::setThumbnails(Epk::ThumbnailService * t)
+{
+    if( d_thumbs )
+        disconnect( d_thumbs, 0, this, 0 );
+    d_thumbs = t;
+    if( d_thumbs )
+        connect( d_thumbs, SIGNAL(signalReady(quint64)), this, SLOT(onThumbnailReady(quint64)) );
+}
+
+void FuncTreeMdl::onThumbnailReady(quint64 oid)
+{
+    // Damit ein offener Tooltip das Bild zeigt, sobald es gerendert ist
+    const QModelIndex i = getIndex( oid );
+    if( i.isValid() )
+        emit dataChanged( i, i );
+}
+
+QVariant FuncTreeMdl::data(const QModelIndex &index, int role) const
+{
+    if( role == Qt::ToolTipRole && d_thumbs != 0 )
+    {
+        const QString tip = d_thumbs->getToolTip( getObject( index ) );
+        if( !tip.isEmpty() )
+            return tip;
+    }
+    return GenericMdl::data( index, role );
 }
 
 bool FuncTreeMdl::isSupportedType(quint32 type)
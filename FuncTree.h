@@ -23,6 +23,12 @@
 #include <WorkTree/GenericCtrl.h>
 #include <WorkTree/GenericMdl.h>
 
+namespace Epk
+{
+    class EpkArchive;
+    class ThumbnailService;
+}
+
 namespace Fln
 {
     class FuncTreeCtrl : public Wt::GenericCtrl
@@ -31,7 +37,7 @@ namespace Fln
     public:
         static const char* s_mimeFuncTree;
         explicit FuncTreeCtrl(QTreeView *tree, Wt::GenericMdl* mdl );
-        static FuncTreeCtrl* create(QWidget* parent, const Udb::Obj& root );
+        static FuncTreeCtrl* create(QWidget* parent, const Udb::Obj& root, Epk::ThumbnailService* = 0 );
         void addCommands( Gui2::AutoMenu* );
         void writeMime( QMimeData *data, const QList<Udb::Obj>& );
         QList<Udb::Obj> readMime(const QMimeData *data, Udb::Obj& parent );
@@ -41,20 +47,32 @@ namespace Fln
         void onAddNext();
         void onToggleType();
         void onImport();
+        void onExport();
+        void onImportBpmn();
+        void onExportBpmn();
+        void onPublishHtml();
         void onCopy();
         void onPaste();
         void onEditAttrs();
     protected:
+        void importAll( Epk::EpkArchive& );
         void writeTo(const Udb::Obj & o, Stream::DataWriter &out) const;
         Udb::Obj readFrom(Stream::DataReader & in, Udb::Obj &parent );
     };
 
     class FuncTreeMdl : public Wt::GenericMdl
     {
+        Q_OBJECT
     public:
         explicit FuncTreeMdl(QObject *parent = 0);
+        void setThumbnails( Epk::ThumbnailService* );
+        QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const;
+    protected slots:
+        void onThumbnailReady( quint64 oid );
     protected:
         virtual bool isSupportedType( quint32 );
+    private:
+        Epk::ThumbnailService* d_thumbs;
     };
 }
 